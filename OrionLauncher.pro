@@ -24,6 +24,7 @@ SOURCES += main.cpp\
 HEADERS  += orionlauncherwindow.h \
     serverlistitem.h \
     proxylistitem.h \
+    updateinfolistitem.h \
     qzipreader_p.h \
     changelogform.h
 
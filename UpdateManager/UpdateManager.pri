@@ -1,10 +1,38 @@
 CONFIG   += c++11
 
-LIBS = libshell32 libwininet libversion
+QT       += network
+
+LIBS = libshell32 libwininet
 
 SOURCES +=
 
 HEADERS  += \
 	$$PWD/qzipreader_p.h \
     $$PWD/updatemanager.hpp \
-    $$PWD/updateinfo.hpp
+    $$PWD/updateinfo.hpp \
+    $$PWD/manifestparser.hpp \
+    $$PWD/manifestmodel.hpp \
+    $$PWD/cpufeatures.hpp \
+    $$PWD/sha256.hpp \
+    $$PWD/blake3.hpp \
+    $$PWD/hashcalculator.hpp \
+    $$PWD/peversionreader.hpp \
+    $$PWD/installverifier.hpp \
+    $$PWD/merkletree.hpp \
+    $$PWD/backgroundpriority.hpp \
+    $$PWD/updateplanner.hpp \
+    $$PWD/manifestcache.hpp \
+    $$PWD/lastknownmanifest.hpp \
+    $$PWD/binarypatch.hpp \
+    $$PWD/blocksync.hpp \
+    $$PWD/packagecache.hpp \
+    $$PWD/updatenotifier.hpp \
+    $$PWD/installdedup.hpp \
+    $$PWD/installsnapshot.hpp \
+    $$PWD/selfupdate.hpp \
+    $$PWD/lancache.hpp \
+    $$PWD/changelogcache.hpp \
+    $$PWD/changelogarchive.hpp \
+    $$PWD/operation.hpp \
+    $$PWD/progressqueue.hpp \
+    $$PWD/updateengine.h
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Update engine without the launcher interface
+# (console tools, benchmarks): CUpdateEngine
+#
+# OrionLauncher.pro does not link this library: the
+# launcher compiles the engine headers directly through
+# UpdateManager.pri. No project in this tree links it yet.
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent
+
+include("$$PWD/UpdateManager.pri")
+
+TARGET = UpdateEngine
+TEMPLATE = lib
+CONFIG += staticlib
+
+SOURCES += $$PWD/updateengine.cpp
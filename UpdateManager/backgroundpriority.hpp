@@ -0,0 +1,215 @@
+/**
+@file BackgroundPriority.hpp
+
+@brief Фоновый приоритет ввода-вывода и процессора для служебных задач обновления
+**/
+//----------------------------------------------------------------------------------
+#ifndef BACKGROUNDPRIORITY_H
+#define BACKGROUNDPRIORITY_H
+//----------------------------------------------------------------------------------
+#include <QtGlobal>
+#include <QThread>
+#include <QThreadPool>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CBackgroundPriority class
+ * Перевод текущего потока в фоновый режим на время жизни объекта:
+ * Windows - THREAD_MODE_BACKGROUND_BEGIN (низкий приоритет процессора, диска и памяти),
+ * Linux - класс ввода-вывода IOPRIO_CLASS_IDLE и nice 19.
+ * Приоритет действует только на текущий поток, поэтому вычисления, которые обычно раздаются
+ * в общий пул потоков (хэширование больших файлов), в фоновом потоке выполняются в нем самом (IsActive).
+ */
+class CBackgroundPriority
+{
+private:
+	//! Количество объектов в текущем потоке
+	static int &Depth()
+	{
+		static thread_local int depth = 0;
+
+		return depth;
+	}
+
+#if defined(Q_OS_WIN)
+	//! Поток был переведен в фоновый режим
+	bool m_Entered{ false };
+#elif defined(Q_OS_LINUX)
+	enum
+	{
+		IOPRIO_WHO_PROCESS = 1,
+		IOPRIO_CLASS_SHIFT = 13,
+		IOPRIO_CLASS_IDLE = 3,
+		BACKGROUND_NICE = 19
+	};
+
+	//! Идентификатор потока
+	pid_t m_ThreadId{ 0 };
+
+	//! Предыдущий приоритет ввода-вывода (-1 если не изменялся)
+	int m_OldIoPriority{ -1 };
+
+	//! Предыдущее значение nice
+	int m_OldNice{ 0 };
+
+	//! nice был изменен
+	bool m_NiceChanged{ false };
+#endif
+
+public:
+	CBackgroundPriority()
+	{
+		Depth()++;
+
+#if defined(Q_OS_WIN)
+		m_Entered = (SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) != FALSE);
+#elif defined(Q_OS_LINUX)
+		m_ThreadId = (pid_t)syscall(SYS_gettid);
+
+		int ioPriority = (int)syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, m_ThreadId);
+
+		if (ioPriority != -1 && !syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, m_ThreadId, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT))
+			m_OldIoPriority = ioPriority;
+
+		errno = 0;
+		int nice = getpriority(PRIO_PROCESS, (id_t)m_ThreadId);
+
+		if (!errno && nice < BACKGROUND_NICE && !setpriority(PRIO_PROCESS, (id_t)m_ThreadId, BACKGROUND_NICE))
+		{
+			m_OldNice = nice;
+			m_NiceChanged = true;
+		}
+#endif
+	}
+
+	//----------------------------------------------------------------------------------
+	~CBackgroundPriority()
+	{
+#if defined(Q_OS_WIN)
+		if (m_Entered)
+			SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+#elif defined(Q_OS_LINUX)
+		if (m_OldIoPriority != -1)
+			syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, m_ThreadId, m_OldIoPriority);
+
+		//! Без CAP_SYS_NICE вернуть nice назад нельзя, поэтому фоновые задачи идут через отдельный пул
+		if (m_NiceChanged)
+			setpriority(PRIO_PROCESS, (id_t)m_ThreadId, m_OldNice);
+#endif
+
+		Depth()--;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Текущий поток работает в фоновом режиме (общий пул потоков ему использовать нельзя)
+	static bool IsActive()
+	{
+		return (Depth() > 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Pool Отдельный пул для фоновых задач (таймерные проверки, обслуживание кэша, предзагрузка)
+	 * Один поток: фоновые задачи не должны конкурировать между собой за диск.
+	 * Пул не удаляется, чтобы выход из программы не ждал завершения фоновой задачи.
+	 * @return Пул потоков
+	 */
+	static QThreadPool *Pool()
+	{
+		static QThreadPool *pool = CreatePool();
+
+		return pool;
+	}
+
+private:
+	static QThreadPool *CreatePool()
+	{
+		QThreadPool *pool = new QThreadPool();
+		pool->setMaxThreadCount(1);
+
+		return pool;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CIoThrottle class
+ * Адаптивное ограничение фонового чтения.
+ * Время чтения порции сравнивается с минимальным (базовым) временем: если диск занят
+ * (клиент подгружает карты или арт), задержка между порциями удваивается, иначе уменьшается.
+ */
+class CIoThrottle
+{
+private:
+	enum
+	{
+		//! Максимальная пауза между порциями, мс
+		MAX_DELAY_MS = 500,
+
+		//! Первая пауза при обнаружении нагрузки, мс
+		MIN_DELAY_MS = 10,
+
+		//! Во сколько раз задержка должна превысить базовую, чтобы считаться нагрузкой
+		BUSY_FACTOR = 3
+	};
+
+	//! Минимальное наблюдаемое время чтения мегабайта, мкс
+	double m_Baseline{ 0.0 };
+
+	//! Сглаженное время чтения мегабайта, мкс
+	double m_Average{ 0.0 };
+
+	//! Текущая пауза, мс
+	int m_DelayMs{ 0 };
+
+public:
+	CIoThrottle() {}
+	~CIoThrottle() {}
+
+	//! Текущая пауза, мс
+	int Delay() const { return m_DelayMs; }
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Pace Учесть прочитанную порцию и при необходимости выдержать паузу
+	 * @param bytes Размер порции
+	 * @param elapsedNs Время чтения порции, нс
+	 */
+	void Pace(const qint64 &bytes, const qint64 &elapsedNs)
+	{
+		if (bytes <= 0)
+			return;
+
+		double latency = ((double)elapsedNs / 1000.0) * (1048576.0 / (double)bytes);
+
+		if (m_Baseline <= 0.0)
+		{
+			m_Baseline = latency;
+			m_Average = latency;
+		}
+		else
+		{
+			//! База медленно ползет вверх, чтобы случайный быстрый замер (кэш ОС) не держал ее вечно
+			m_Baseline = qMin(m_Baseline * 1.05, latency);
+			m_Average = m_Average * 0.75 + latency * 0.25;
+		}
+
+		if (m_Average > m_Baseline * BUSY_FACTOR)
+			m_DelayMs = qMin((int)MAX_DELAY_MS, qMax((int)MIN_DELAY_MS, m_DelayMs * 2));
+		else
+			m_DelayMs /= 2;
+
+		if (m_DelayMs)
+			QThread::msleep((unsigned long)m_DelayMs);
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // BACKGROUNDPRIORITY_H
+//----------------------------------------------------------------------------------
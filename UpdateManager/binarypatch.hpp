@@ -0,0 +1,232 @@
+/**
+@file BinaryPatch.hpp
+
+@brief Применение бинарных патчей (схема bsdiff, блоки сжаты zlib)
+
+Формат патча:
+@code
+"ORPATCH1"            8 байт
+длина блока control   8 байт
+длина блока diff      8 байт
+размер нового файла   8 байт
+control, diff, extra  сжаты qCompress
+@endcode
+Числа - как в bsdiff (младший байт первым, знак в старшем бите). Control - тройки (x, y, z):
+x байт нового файла = diff + исходный файл, затем y байт из extra, затем смещение в исходном файле на z.
+Патчи для сервера обновлений строит tools/makepatch.py (он же выводит элемент <patch> манифеста).
+
+Блоки разворачиваются в память целиком (qUncompress), их объем близок к размеру нового файла,
+поэтому он ограничен MAX_EXPANDED_SIZE. Больший патч отвергается до разворачивания, и файл
+обновляется архивом; для больших файлов предназначена поблочная синхронизация (BlockSync.hpp).
+**/
+//----------------------------------------------------------------------------------
+#ifndef BINARYPATCH_H
+#define BINARYPATCH_H
+//----------------------------------------------------------------------------------
+#include <climits>
+#include <cstring>
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CBinaryPatch class
+ * Построение нового файла из исходного и патча. Исходный файл и патч отображаются в память,
+ * результат пишется порциями; в памяти лаунчера - только развернутые блоки патча.
+ */
+class CBinaryPatch
+{
+private:
+	//! Размер заголовка
+	enum { HEADER_SIZE = 32 };
+
+	//! Размер порции записи результата
+	enum { CHUNK_SIZE = 0x10000 };
+
+	//! Наибольший суммарный размер развернутых блоков патча
+	enum { MAX_EXPANDED_SIZE = 128 * 1024 * 1024 };
+
+	//----------------------------------------------------------------------------------
+	static qint64 ReadOffset(const uchar *data)
+	{
+		qint64 value = data[7] & 0x7F;
+
+		for (int i = 6; i >= 0; i--)
+			value = (value << 8) | data[i];
+
+		return ((data[7] & 0x80) ? -value : value);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ReadBlock Развернуть блок патча
+	 * @param patch Патч
+	 * @param position Смещение блока (сдвигается за блок)
+	 * @param size Размер сжатого блока
+	 * @param budget Сколько еще можно развернуть, байт (уменьшается)
+	 * @param block Развернутый блок
+	 * @return false если блок поврежден или не помещается в ограничение
+	 */
+	static bool ReadBlock(const QByteArray &patch, qint64 &position, const qint64 &size, qint64 &budget, QByteArray &block)
+	{
+		if (size < 0 || size > patch.size() - position)
+			return false;
+
+		if (!size)
+		{
+			block.clear();
+			return true;
+		}
+
+		//! qCompress записывает размер развернутых данных первыми 4 байтами (старший первым)
+		const uchar *data = (const uchar *)patch.constData() + position;
+
+		if (size < 4)
+			return false;
+
+		qint64 expanded = ((qint64)data[0] << 24) | ((qint64)data[1] << 16) | ((qint64)data[2] << 8) | (qint64)data[3];
+
+		if (expanded > budget)
+			return false;
+
+		block = qUncompress(data, (int)size);
+		position += size;
+		budget -= block.size();
+
+		//! Пустой блок (патч без extra или без diff) qCompress записывает одним заголовком
+		return (!block.isEmpty() || !expanded);
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Apply Применить патч
+	 * @param source Исходный файл
+	 * @param sourceSize Размер исходного файла
+	 * @param patch Патч
+	 * @param output Новый файл
+	 * @return true если патч корректен, помещается в ограничение памяти и результат записан полностью
+	 */
+	static bool Apply(const uchar *source, const qint64 &sourceSize, const QByteArray &patch, QIODevice &output)
+	{
+		const uchar *header = (const uchar *)patch.constData();
+
+		if (patch.size() < HEADER_SIZE || memcmp(header, "ORPATCH1", 8))
+			return false;
+
+		qint64 newSize = ReadOffset(header + 24);
+		qint64 position = HEADER_SIZE;
+		qint64 budget = MAX_EXPANDED_SIZE;
+		QByteArray control;
+		QByteArray diff;
+		QByteArray extra;
+
+		if (newSize < 0 || !ReadBlock(patch, position, ReadOffset(header + 8), budget, control) || !ReadBlock(patch, position, ReadOffset(header + 16), budget, diff) || !ReadBlock(patch, position, patch.size() - position, budget, extra))
+			return false;
+
+		const uchar *controlData = (const uchar *)control.constData();
+		const uchar *diffData = (const uchar *)diff.constData();
+		qint64 controlPosition = 0;
+		qint64 diffPosition = 0;
+		qint64 extraPosition = 0;
+		qint64 newPosition = 0;
+		qint64 oldPosition = 0;
+		QByteArray chunk;
+
+		while (newPosition < newSize)
+		{
+			if (controlPosition + 24 > control.size())
+				return false;
+
+			qint64 x = ReadOffset(controlData + controlPosition);
+			qint64 y = ReadOffset(controlData + controlPosition + 8);
+			qint64 z = ReadOffset(controlData + controlPosition + 16);
+			controlPosition += 24;
+
+			if (x < 0 || y < 0 || x > newSize - newPosition || y > newSize - newPosition - x || x > diff.size() - diffPosition || y > extra.size() - extraPosition)
+				return false;
+
+			for (qint64 done = 0; done < x; )
+			{
+				int count = (int)qMin((qint64)CHUNK_SIZE, x - done);
+				chunk.resize(count);
+				uchar *out = (uchar *)chunk.data();
+
+				for (int i = 0; i < count; i++)
+				{
+					qint64 oldIndex = oldPosition + done + i;
+					out[i] = diffData[diffPosition + done + i];
+
+					if (oldIndex >= 0 && oldIndex < sourceSize)
+						out[i] += source[oldIndex];
+				}
+
+				if (output.write(chunk) != count)
+					return false;
+
+				done += count;
+			}
+
+			diffPosition += x;
+			newPosition += x;
+			oldPosition += x;
+
+			if (y && output.write(extra.constData() + extraPosition, y) != y)
+				return false;
+
+			extraPosition += y;
+			newPosition += y;
+			oldPosition += z;
+		}
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ApplyFile Применить патч к файлу
+	 * @param sourcePath Исходный файл
+	 * @param patchPath Патч
+	 * @param outputPath Новый файл (при ошибке удаляется)
+	 * @return true если новый файл построен
+	 */
+	static bool ApplyFile(const QString &sourcePath, const QString &patchPath, const QString &outputPath)
+	{
+		QFile sourceFile(sourcePath);
+		QFile patchFile(patchPath);
+		QFile outputFile(outputPath);
+
+		if (!sourceFile.open(QIODevice::ReadOnly) || !patchFile.open(QIODevice::ReadOnly) || !outputFile.open(QIODevice::WriteOnly))
+			return false;
+
+		qint64 sourceSize = sourceFile.size();
+		uchar *source = (sourceSize > 0 ? sourceFile.map(0, sourceSize) : nullptr);
+		qint64 patchSize = patchFile.size();
+		uchar *patch = (patchSize > 0 && patchSize <= INT_MAX ? patchFile.map(0, patchSize) : nullptr);
+		bool result = false;
+
+		if ((source != nullptr || !sourceSize) && patch != nullptr)
+		{
+			//! Патч не копируется: массив ссылается на отображение файла
+			result = Apply(source, sourceSize, QByteArray::fromRawData((const char *)patch, (int)patchSize), outputFile);
+		}
+
+		if (source != nullptr)
+			sourceFile.unmap(source);
+
+		if (patch != nullptr)
+			patchFile.unmap(patch);
+
+		outputFile.close();
+		patchFile.close();
+		sourceFile.close();
+
+		if (!result)
+			QFile::remove(outputPath);
+
+		return result;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // BINARYPATCH_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,595 @@
+/**
+@file Blake3.hpp
+
+@brief BLAKE3 с 4-полосной SSE4.1 обработкой блоков и многопоточным хэшированием дерева
+**/
+//----------------------------------------------------------------------------------
+#ifndef BLAKE3_H
+#define BLAKE3_H
+//----------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QVector>
+#include <QtConcurrent>
+#include <string.h>
+#include "cpufeatures.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CBlake3 class
+ * Потоковое вычисление BLAKE3 (режим hash, 32 байта результата)
+ */
+class CBlake3
+{
+public:
+	enum
+	{
+		//! Размер блока компрессии
+		BLOCK_LEN = 64,
+
+		//! Размер чанка (листа дерева)
+		CHUNK_LEN = 1024,
+
+		//! Количество чанков в поддереве, обрабатываемом одним потоком (1 МБ)
+		SUBTREE_CHUNKS = 1024
+	};
+
+private:
+	//! Флаги доменов
+	enum
+	{
+		CHUNK_START = 1,
+		CHUNK_END = 2,
+		PARENT = 4,
+		ROOT = 8
+	};
+
+	//! Цепочечное значение
+	struct CV
+	{
+		quint32 Words[8];
+	};
+
+	//! Цепочечное значение текущего чанка
+	quint32 m_ChunkCv[8];
+
+	//! Номер текущего чанка
+	quint64 m_ChunkCounter{ 0 };
+
+	//! Неполный блок текущего чанка
+	uchar m_Block[BLOCK_LEN];
+
+	//! Заполнение блока
+	int m_BlockLen{ 0 };
+
+	//! Количество сжатых блоков в текущем чанке
+	int m_BlocksCompressed{ 0 };
+
+	//! Стек цепочечных значений поддеревьев (по одному на бит счетчика чанков)
+	CV m_Stack[54];
+
+	//! Глубина стека
+	int m_StackSize{ 0 };
+
+	//----------------------------------------------------------------------------------
+	static const quint32 *IV()
+	{
+		static const quint32 iv[8] =
+		{
+			0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+		};
+
+		return iv;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Порядок слов сообщения для каждого из 7 раундов
+	static const quint8 (*Schedule())[16]
+	{
+		static const quint8 schedule[7][16] =
+		{
+			{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+			{ 2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8 },
+			{ 3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1 },
+			{ 10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6 },
+			{ 12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4 },
+			{ 9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7 },
+			{ 11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13 }
+		};
+
+		return schedule;
+	}
+
+	//----------------------------------------------------------------------------------
+	static inline quint32 Rotr(const quint32 &value, const int &bits)
+	{
+		return (value >> bits) | (value << (32 - bits));
+	}
+
+	//----------------------------------------------------------------------------------
+	static inline void G(quint32 *v, const int &a, const int &b, const int &c, const int &d, const quint32 &x, const quint32 &y)
+	{
+		v[a] = v[a] + v[b] + x;
+		v[d] = Rotr(v[d] ^ v[a], 16);
+		v[c] = v[c] + v[d];
+		v[b] = Rotr(v[b] ^ v[c], 12);
+		v[a] = v[a] + v[b] + y;
+		v[d] = Rotr(v[d] ^ v[a], 8);
+		v[c] = v[c] + v[d];
+		v[b] = Rotr(v[b] ^ v[c], 7);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Compress Функция компрессии одного блока
+	 * @param cv Входное цепочечное значение
+	 * @param block Блок (64 байта)
+	 * @param blockLen Длина данных в блоке
+	 * @param counter Счетчик
+	 * @param flags Флаги
+	 * @param out Результат (8 слов)
+	 */
+	static void Compress(const quint32 cv[8], const uchar *block, const quint32 &blockLen, const quint64 &counter, const quint32 &flags, quint32 out[8])
+	{
+		quint32 m[16];
+
+		for (int i = 0; i < 16; i++)
+			m[i] = (quint32)block[i * 4] | ((quint32)block[i * 4 + 1] << 8) | ((quint32)block[i * 4 + 2] << 16) | ((quint32)block[i * 4 + 3] << 24);
+
+		const quint32 *iv = IV();
+
+		quint32 v[16] =
+		{
+			cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+			iv[0], iv[1], iv[2], iv[3], (quint32)counter, (quint32)(counter >> 32), blockLen, flags
+		};
+
+		for (int r = 0; r < 7; r++)
+		{
+			const quint8 *s = Schedule()[r];
+
+			G(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+			G(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+			G(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+			G(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+			G(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+			G(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+			G(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+			G(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+		}
+
+		for (int i = 0; i < 8; i++)
+			out[i] = v[i] ^ v[i + 8];
+	}
+
+	//----------------------------------------------------------------------------------
+	static void ParentCv(const CV &left, const CV &right, const quint32 &flags, quint32 out[8])
+	{
+		uchar block[BLOCK_LEN];
+
+		for (int i = 0; i < 8; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				block[i * 4 + j] = (uchar)(left.Words[i] >> (j * 8));
+				block[32 + i * 4 + j] = (uchar)(right.Words[i] >> (j * 8));
+			}
+		}
+
+		Compress(IV(), block, BLOCK_LEN, 0, PARENT | flags, out);
+	}
+
+	//----------------------------------------------------------------------------------
+	static void ChunkCvPortable(const uchar *chunk, const quint64 &counter, quint32 out[8])
+	{
+		memcpy(out, IV(), 32);
+
+		for (int i = 0; i < 16; i++)
+		{
+			quint32 flags = (i == 0 ? CHUNK_START : 0) | (i == 15 ? CHUNK_END : 0);
+			Compress(out, chunk + i * BLOCK_LEN, BLOCK_LEN, counter, flags, out);
+		}
+	}
+
+#if defined(ORION_CPU_X86)
+	//----------------------------------------------------------------------------------
+	ORION_TARGET("sse4.1,ssse3")
+	static inline __m128i Rot16(const __m128i &x)
+	{
+		return _mm_shuffle_epi8(x, _mm_set_epi8(13, 12, 15, 14, 9, 8, 11, 10, 5, 4, 7, 6, 1, 0, 3, 2));
+	}
+
+	ORION_TARGET("sse4.1,ssse3")
+	static inline __m128i Rot8(const __m128i &x)
+	{
+		return _mm_shuffle_epi8(x, _mm_set_epi8(12, 15, 14, 13, 8, 11, 10, 9, 4, 7, 6, 5, 0, 3, 2, 1));
+	}
+
+	ORION_TARGET("sse4.1,ssse3")
+	static inline __m128i Rot12(const __m128i &x)
+	{
+		return _mm_or_si128(_mm_srli_epi32(x, 12), _mm_slli_epi32(x, 20));
+	}
+
+	ORION_TARGET("sse4.1,ssse3")
+	static inline __m128i Rot7(const __m128i &x)
+	{
+		return _mm_or_si128(_mm_srli_epi32(x, 7), _mm_slli_epi32(x, 25));
+	}
+
+	//----------------------------------------------------------------------------------
+	ORION_TARGET("sse4.1,ssse3")
+	static inline void G4(__m128i *v, const int &a, const int &b, const int &c, const int &d, const __m128i &x, const __m128i &y)
+	{
+		v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), x);
+		v[d] = Rot16(_mm_xor_si128(v[d], v[a]));
+		v[c] = _mm_add_epi32(v[c], v[d]);
+		v[b] = Rot12(_mm_xor_si128(v[b], v[c]));
+		v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), y);
+		v[d] = Rot8(_mm_xor_si128(v[d], v[a]));
+		v[c] = _mm_add_epi32(v[c], v[d]);
+		v[b] = Rot7(_mm_xor_si128(v[b], v[c]));
+	}
+
+	//----------------------------------------------------------------------------------
+	ORION_TARGET("sse4.1,ssse3")
+	static inline void Transpose4(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+	{
+		__m128i ab01 = _mm_unpacklo_epi32(a, b);
+		__m128i ab23 = _mm_unpackhi_epi32(a, b);
+		__m128i cd01 = _mm_unpacklo_epi32(c, d);
+		__m128i cd23 = _mm_unpackhi_epi32(c, d);
+
+		a = _mm_unpacklo_epi64(ab01, cd01);
+		b = _mm_unpackhi_epi64(ab01, cd01);
+		c = _mm_unpacklo_epi64(ab23, cd23);
+		d = _mm_unpackhi_epi64(ab23, cd23);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ChunkCv4Sse41 Цепочечные значения 4 последовательных полных чанков (по одному на полосу SSE)
+	 * @param chunks Указатель на 4 * CHUNK_LEN байт
+	 * @param counter Номер первого чанка
+	 * @param out Результат
+	 */
+	ORION_TARGET("sse4.1,ssse3")
+	static void ChunkCv4Sse41(const uchar *chunks, const quint64 &counter, CV out[4])
+	{
+		const quint32 *iv = IV();
+		__m128i h[8];
+
+		for (int i = 0; i < 8; i++)
+			h[i] = _mm_set1_epi32((int)iv[i]);
+
+		const __m128i counterLow = _mm_set_epi32((int)(quint32)(counter + 3), (int)(quint32)(counter + 2), (int)(quint32)(counter + 1), (int)(quint32)counter);
+		const __m128i counterHigh = _mm_set_epi32((int)(quint32)((counter + 3) >> 32), (int)(quint32)((counter + 2) >> 32), (int)(quint32)((counter + 1) >> 32), (int)(quint32)(counter >> 32));
+
+		for (int block = 0; block < 16; block++)
+		{
+			__m128i m[16];
+
+			for (int group = 0; group < 4; group++)
+			{
+				const uchar *ptr = chunks + block * BLOCK_LEN + group * 16;
+
+				m[group * 4] = _mm_loadu_si128((const __m128i *)ptr);
+				m[group * 4 + 1] = _mm_loadu_si128((const __m128i *)(ptr + CHUNK_LEN));
+				m[group * 4 + 2] = _mm_loadu_si128((const __m128i *)(ptr + CHUNK_LEN * 2));
+				m[group * 4 + 3] = _mm_loadu_si128((const __m128i *)(ptr + CHUNK_LEN * 3));
+
+				Transpose4(m[group * 4], m[group * 4 + 1], m[group * 4 + 2], m[group * 4 + 3]);
+			}
+
+			int flags = (block == 0 ? CHUNK_START : 0) | (block == 15 ? CHUNK_END : 0);
+
+			__m128i v[16] =
+			{
+				h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+				_mm_set1_epi32((int)iv[0]), _mm_set1_epi32((int)iv[1]), _mm_set1_epi32((int)iv[2]), _mm_set1_epi32((int)iv[3]),
+				counterLow, counterHigh, _mm_set1_epi32(BLOCK_LEN), _mm_set1_epi32(flags)
+			};
+
+			for (int r = 0; r < 7; r++)
+			{
+				const quint8 *s = Schedule()[r];
+
+				G4(v, 0, 4, 8, 12, m[s[0]], m[s[1]]);
+				G4(v, 1, 5, 9, 13, m[s[2]], m[s[3]]);
+				G4(v, 2, 6, 10, 14, m[s[4]], m[s[5]]);
+				G4(v, 3, 7, 11, 15, m[s[6]], m[s[7]]);
+				G4(v, 0, 5, 10, 15, m[s[8]], m[s[9]]);
+				G4(v, 1, 6, 11, 12, m[s[10]], m[s[11]]);
+				G4(v, 2, 7, 8, 13, m[s[12]], m[s[13]]);
+				G4(v, 3, 4, 9, 14, m[s[14]], m[s[15]]);
+			}
+
+			for (int i = 0; i < 8; i++)
+				h[i] = _mm_xor_si128(v[i], v[i + 8]);
+		}
+
+		Transpose4(h[0], h[1], h[2], h[3]);
+		Transpose4(h[4], h[5], h[6], h[7]);
+
+		for (int lane = 0; lane < 4; lane++)
+		{
+			_mm_storeu_si128((__m128i *)&out[lane].Words[0], h[lane]);
+			_mm_storeu_si128((__m128i *)&out[lane].Words[4], h[lane + 4]);
+		}
+	}
+#endif
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ChunkCvs Цепочечные значения последовательности полных чанков
+	 * @param data Данные (count * CHUNK_LEN байт)
+	 * @param count Количество чанков
+	 * @param counter Номер первого чанка
+	 * @param out Результат
+	 */
+	static void ChunkCvs(const uchar *data, size_t count, quint64 counter, CV *out)
+	{
+#if defined(ORION_CPU_X86)
+		if (CCpuFeatures::HasSse41())
+		{
+			for (; count >= 4; count -= 4, counter += 4, data += CHUNK_LEN * 4, out += 4)
+				ChunkCv4Sse41(data, counter, out);
+		}
+#endif
+
+		for (; count; count--, counter++, data += CHUNK_LEN, out++)
+			ChunkCvPortable(data, counter, out->Words);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SubtreeCv Цепочечное значение полного поддерева (не корня)
+	 * @param data Данные (SUBTREE_CHUNKS * CHUNK_LEN байт)
+	 * @param counter Номер первого чанка поддерева
+	 * @param out Результат
+	 */
+	static void SubtreeCv(const uchar *data, const quint64 &counter, CV &out)
+	{
+		QVector<CV> cvs(SUBTREE_CHUNKS);
+		ChunkCvs(data, SUBTREE_CHUNKS, counter, cvs.data());
+
+		for (int count = SUBTREE_CHUNKS; count > 1; count /= 2)
+		{
+			for (int i = 0; i < count / 2; i++)
+				ParentCv(cvs[i * 2], cvs[i * 2 + 1], 0, cvs[i].Words);
+		}
+
+		out = cvs[0];
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief PushCv Добавить цепочечное значение завершенного поддерева
+	 * @param cv Значение
+	 * @param totalUnits Общее количество завершенных поддеревьев этого размера
+	 */
+	void PushCv(CV cv, quint64 totalUnits)
+	{
+		while (!(totalUnits & 1))
+		{
+			m_StackSize--;
+			ParentCv(m_Stack[m_StackSize], cv, 0, cv.Words);
+			totalUnits >>= 1;
+		}
+
+		m_Stack[m_StackSize++] = cv;
+	}
+
+	//----------------------------------------------------------------------------------
+	void ResetChunk()
+	{
+		memcpy(m_ChunkCv, IV(), sizeof(m_ChunkCv));
+		m_BlockLen = 0;
+		m_BlocksCompressed = 0;
+	}
+
+	//----------------------------------------------------------------------------------
+	int ChunkLength() const
+	{
+		return m_BlocksCompressed * BLOCK_LEN + m_BlockLen;
+	}
+
+	//----------------------------------------------------------------------------------
+	quint32 StartFlag() const
+	{
+		return (m_BlocksCompressed ? 0 : CHUNK_START);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief PushSubtree Добавить цепочечное значение полного поддерева из SUBTREE_CHUNKS чанков
+	 * Вызывается только до Update и только для выровненных поддеревьев
+	 * @param cv Значение
+	 */
+	void PushSubtree(const CV &cv)
+	{
+		m_ChunkCounter += SUBTREE_CHUNKS;
+		PushCv(cv, m_ChunkCounter / SUBTREE_CHUNKS);
+	}
+
+	//----------------------------------------------------------------------------------
+public:
+	CBlake3()
+	{
+		ResetChunk();
+	}
+
+	~CBlake3() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Update Добавить данные
+	 * @param data Данные
+	 * @param size Размер данных
+	 */
+	void Update(const uchar *data, size_t size)
+	{
+		while (size)
+		{
+			if (ChunkLength() == CHUNK_LEN)
+			{
+				CV cv;
+				Compress(m_ChunkCv, m_Block, BLOCK_LEN, m_ChunkCounter, CHUNK_END, cv.Words);
+				m_ChunkCounter++;
+				PushCv(cv, m_ChunkCounter);
+				ResetChunk();
+			}
+
+			//! Целые чанки (не последние во входных данных) обрабатываем пачкой
+			if (!ChunkLength() && size > CHUNK_LEN)
+			{
+				size_t count = qMin((size - 1) / CHUNK_LEN, (size_t)SUBTREE_CHUNKS);
+				CV cvs[SUBTREE_CHUNKS];
+				ChunkCvs(data, count, m_ChunkCounter, cvs);
+
+				for (size_t i = 0; i < count; i++)
+				{
+					m_ChunkCounter++;
+					PushCv(cvs[i], m_ChunkCounter);
+				}
+
+				data += count * CHUNK_LEN;
+				size -= count * CHUNK_LEN;
+				continue;
+			}
+
+			if (m_BlockLen == BLOCK_LEN)
+			{
+				Compress(m_ChunkCv, m_Block, BLOCK_LEN, m_ChunkCounter, StartFlag(), m_ChunkCv);
+				m_BlocksCompressed++;
+				m_BlockLen = 0;
+			}
+
+			size_t take = qMin(size, (size_t)(BLOCK_LEN - m_BlockLen));
+			memcpy(m_Block + m_BlockLen, data, take);
+			m_BlockLen += (int)take;
+			data += take;
+			size -= take;
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Finalize Завершить вычисление
+	 * @return 32 байта хэша
+	 */
+	QByteArray Finalize() const
+	{
+		uchar block[BLOCK_LEN];
+		memset(block, 0, sizeof(block));
+		memcpy(block, m_Block, m_BlockLen);
+
+		quint32 inputCv[8];
+		memcpy(inputCv, m_ChunkCv, sizeof(inputCv));
+		quint32 blockLen = (quint32)m_BlockLen;
+		quint64 counter = m_ChunkCounter;
+		quint32 flags = StartFlag() | CHUNK_END;
+
+		//! Поднимаемся по стеку, результат последнего узла - корень
+		for (int i = m_StackSize - 1; i >= 0; i--)
+		{
+			CV cv;
+			Compress(inputCv, block, blockLen, counter, flags, cv.Words);
+
+			for (int j = 0; j < 8; j++)
+			{
+				for (int k = 0; k < 4; k++)
+				{
+					block[j * 4 + k] = (uchar)(m_Stack[i].Words[j] >> (k * 8));
+					block[32 + j * 4 + k] = (uchar)(cv.Words[j] >> (k * 8));
+				}
+			}
+
+			memcpy(inputCv, IV(), sizeof(inputCv));
+			blockLen = BLOCK_LEN;
+			counter = 0;
+			flags = PARENT;
+		}
+
+		quint32 out[8];
+		Compress(inputCv, block, blockLen, 0, flags | ROOT, out);
+
+		QByteArray result(32, 0);
+
+		for (int i = 0; i < 8; i++)
+		{
+			for (int j = 0; j < 4; j++)
+				result[i * 4 + j] = (char)(out[i] >> (j * 8));
+		}
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief UpdateSubtrees Добавить полные поддеревья (по SUBTREE_CHUNKS чанков)
+	 * Вызывается только до Update; после последней части нужен Update хотя бы с одним байтом,
+	 * иначе последнее поддерево окажется корнем. Так большой буфер считается частями.
+	 * @param data Данные (count * SUBTREE_CHUNKS * CHUNK_LEN байт)
+	 * @param count Количество поддеревьев
+	 * @param parallel Использовать общий пул потоков
+	 */
+	void UpdateSubtrees(const uchar *data, const qint64 &count, const bool &parallel)
+	{
+		const qint64 subtreeLen = (qint64)SUBTREE_CHUNKS * CHUNK_LEN;
+		const quint64 counter = m_ChunkCounter;
+		QVector<CV> cvs((int)count);
+		CV *cvsData = cvs.data();
+
+		if (parallel && count > 1)
+		{
+			QVector<int> indexes((int)count);
+
+			for (int i = 0; i < indexes.size(); i++)
+				indexes[i] = i;
+
+			QtConcurrent::blockingMap(indexes, [data, subtreeLen, counter, cvsData](const int &index)
+			{
+				SubtreeCv(data + index * subtreeLen, counter + (quint64)index * SUBTREE_CHUNKS, cvsData[index]);
+			});
+		}
+		else
+		{
+			for (int i = 0; i < cvs.size(); i++)
+				SubtreeCv(data + i * subtreeLen, counter + (quint64)i * SUBTREE_CHUNKS, cvsData[i]);
+		}
+
+		for (const CV &cv : cvs)
+			PushSubtree(cv);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Hash Хэширование буфера, большие данные обрабатываются поддеревьями в пуле потоков
+	 * @param data Данные
+	 * @param size Размер данных
+	 * @param parallel Использовать общий пул потоков (false - все в вызывающем потоке)
+	 * @return 32 байта хэша
+	 */
+	static QByteArray Hash(const uchar *data, const qint64 &size, const bool &parallel = true)
+	{
+		const qint64 subtreeLen = (qint64)SUBTREE_CHUNKS * CHUNK_LEN;
+		CBlake3 hasher;
+
+		//! Последнее поддерево всегда обрабатываем последовательно, оно может оказаться корнем
+		qint64 subtrees = (size > 0 ? (size - 1) / subtreeLen : 0);
+
+		if (parallel && subtrees > 1)
+		{
+			hasher.UpdateSubtrees(data, subtrees, true);
+
+			data += subtrees * subtreeLen;
+			hasher.Update(data, (size_t)(size - subtrees * subtreeLen));
+		}
+		else
+			hasher.Update(data, (size_t)size);
+
+		return hasher.Finalize();
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // BLAKE3_H
+//----------------------------------------------------------------------------------
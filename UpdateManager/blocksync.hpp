@@ -0,0 +1,262 @@
+/**
+@file BlockSync.hpp
+
+@brief Поблочная синхронизация больших файлов (схема rsync/zsync)
+
+Сервер публикует рядом с несжатым файлом карту блоков:
+@code
+"ORBLKMAP"                 8 байт
+размер блока               4 байта
+размер файла               8 байт
+для каждого блока:
+	скользящая сумма       4 байта
+	BLAKE3 (первые 16 байт) 16 байт
+@endcode
+Числа - младший байт первым. Последний блок может быть короче размера блока.
+Лаунчер находит у себя блоки с совпадающими суммами (на любом смещении), остальные
+получает запросами Range к несжатому файлу.
+**/
+//----------------------------------------------------------------------------------
+#ifndef BLOCKSYNC_H
+#define BLOCKSYNC_H
+//----------------------------------------------------------------------------------
+#include <cstring>
+#include <QByteArray>
+#include <QMultiHash>
+#include <QVector>
+#include "blake3.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CBlockMap class
+ * Карта блоков файла на сервере
+ */
+class CBlockMap
+{
+private:
+	//! Размер заголовка
+	enum { HEADER_SIZE = 20 };
+
+	//! Размер записи о блоке
+	enum { RECORD_SIZE = 20 };
+
+	//! Размер блока
+	qint64 m_BlockSize{ 0 };
+
+	//! Размер файла
+	qint64 m_FileSize{ 0 };
+
+	//! Скользящие суммы блоков
+	QVector<quint32> m_Rolling;
+
+	//! Сильные суммы блоков подряд по STRONG_SIZE байт
+	QByteArray m_Strong;
+
+	//----------------------------------------------------------------------------------
+	static quint64 ReadNumber(const uchar *data, const int &size)
+	{
+		quint64 value = 0;
+
+		for (int i = size - 1; i >= 0; i--)
+			value = (value << 8) | data[i];
+
+		return value;
+	}
+
+public:
+	CBlockMap() {}
+	~CBlockMap() {}
+
+	//! Размер сильной суммы
+	enum { STRONG_SIZE = 16 };
+
+	qint64 BlockSize() const { return m_BlockSize; }
+
+	qint64 FileSize() const { return m_FileSize; }
+
+	int Count() const { return m_Rolling.size(); }
+
+	quint32 Rolling(const int &index) const { return m_Rolling[index]; }
+
+	const char *Strong(const int &index) const { return m_Strong.constData() + index * STRONG_SIZE; }
+
+	qint64 BlockOffset(const int &index) const { return (qint64)index * m_BlockSize; }
+
+	qint64 BlockLength(const int &index) const { return qMin(m_BlockSize, m_FileSize - BlockOffset(index)); }
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Parse Разбор карты блоков
+	 * @param data Данные
+	 * @return true если карта корректна
+	 */
+	bool Parse(const QByteArray &data)
+	{
+		const uchar *header = (const uchar *)data.constData();
+
+		if (data.size() < HEADER_SIZE || memcmp(header, "ORBLKMAP", 8))
+			return false;
+
+		m_BlockSize = (qint64)ReadNumber(header + 8, 4);
+		m_FileSize = (qint64)ReadNumber(header + 12, 8);
+
+		if (m_BlockSize <= 0 || m_FileSize < 0)
+			return false;
+
+		qint64 count = (m_FileSize + m_BlockSize - 1) / m_BlockSize;
+
+		if (count > (data.size() - HEADER_SIZE) / RECORD_SIZE)
+			return false;
+
+		m_Rolling.resize((int)count);
+		m_Strong.resize((int)count * STRONG_SIZE);
+
+		const uchar *record = header + HEADER_SIZE;
+
+		for (int i = 0; i < (int)count; i++, record += RECORD_SIZE)
+		{
+			m_Rolling[i] = (quint32)ReadNumber(record, 4);
+			memcpy(m_Strong.data() + i * STRONG_SIZE, record + 4, STRONG_SIZE);
+		}
+
+		return true;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CBlockSync class
+ * Поиск блоков карты в локальном файле
+ */
+class CBlockSync
+{
+private:
+	//----------------------------------------------------------------------------------
+	static bool StrongEquals(const uchar *data, const qint64 &size, const char *expected)
+	{
+		return !memcmp(CBlake3::Hash(data, size).constData(), expected, CBlockMap::STRONG_SIZE);
+	}
+
+	//----------------------------------------------------------------------------------
+	static bool TryLastBlock(const uchar *local, const qint64 &localSize, const CBlockMap &map, const qint64 &offset, QVector<qint64> &result)
+	{
+		int last = map.Count() - 1;
+		qint64 length = map.BlockLength(last);
+
+		if (offset < 0 || offset + length > localSize)
+			return false;
+
+		if (Rolling(local + offset, length) != map.Rolling(last) || !StrongEquals(local + offset, length, map.Strong(last)))
+			return false;
+
+		result[last] = offset;
+
+		return true;
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Rolling Скользящая сумма (как в rsync: a - сумма байт, b - взвешенная сумма, по модулю 2^16)
+	 * @param data Данные
+	 * @param size Размер
+	 * @return Сумма
+	 */
+	static quint32 Rolling(const uchar *data, const qint64 &size)
+	{
+		quint32 a = 0;
+		quint32 b = 0;
+
+		for (qint64 i = 0; i < size; i++)
+		{
+			a += data[i];
+			b += (quint32)(size - i) * data[i];
+		}
+
+		return (a & 0xFFFF) | ((b & 0xFFFF) << 16);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Match Найти блоки карты в локальном файле
+	 * @param local Локальный файл
+	 * @param localSize Размер локального файла
+	 * @param map Карта блоков
+	 * @return Смещение каждого блока в локальном файле (-1 - блока нет)
+	 */
+	static QVector<qint64> Match(const uchar *local, const qint64 &localSize, const CBlockMap &map)
+	{
+		QVector<qint64> result(map.Count(), -1);
+		qint64 blockSize = map.BlockSize();
+
+		if (!map.Count())
+			return result;
+
+		//! В таблице только полные блоки, короткий последний блок проверяется отдельно
+		QMultiHash<quint32, int> index;
+
+		for (int i = 0; i < map.Count(); i++)
+		{
+			if (map.BlockLength(i) == blockSize)
+				index.insert(map.Rolling(i), i);
+		}
+
+		qint64 position = 0;
+		quint32 a = 0;
+		quint32 b = 0;
+		bool recompute = true;
+
+		while (position + blockSize <= localSize)
+		{
+			if (recompute)
+			{
+				quint32 sum = Rolling(local + position, blockSize);
+				a = sum & 0xFFFF;
+				b = sum >> 16;
+				recompute = false;
+			}
+
+			bool matched = false;
+			quint32 sum = (a & 0xFFFF) | ((b & 0xFFFF) << 16);
+
+			for (auto it = index.constFind(sum); it != index.constEnd() && it.key() == sum; ++it)
+			{
+				//! Одинаковые блоки (например, заполненные нулями) берутся из одного места
+				if (result[it.value()] == -1 && StrongEquals(local + position, blockSize, map.Strong(it.value())))
+				{
+					result[it.value()] = position;
+					matched = true;
+				}
+			}
+
+			if (matched)
+			{
+				position += blockSize;
+				recompute = true;
+				continue;
+			}
+
+			if (position + blockSize >= localSize)
+				break;
+
+			quint32 out = local[position];
+			quint32 in = local[position + blockSize];
+
+			a = (a - out + in) & 0xFFFF;
+			b = (b - (quint32)blockSize * out + a) & 0xFFFF;
+			position++;
+		}
+
+		int last = map.Count() - 1;
+
+		//! Короткий последний блок ищем на том же месте и в конце локального файла
+		if (result[last] == -1 && map.BlockLength(last) != blockSize)
+		{
+			if (!TryLastBlock(local, localSize, map, map.BlockOffset(last), result))
+				TryLastBlock(local, localSize, map, localSize - map.BlockLength(last), result);
+		}
+
+		return result;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // BLOCKSYNC_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,545 @@
+/**
+@file ChangelogArchive.hpp
+
+@brief Архив записей истории изменений (по версиям и языкам) с полнотекстовым индексом
+
+Каждый раздел страницы истории изменений (версия) хранится отдельной записью, индекс - обратный:
+слово -> записи, в которых оно встречается.
+@code
+Changelog/Archive/entries/<номер>.html    текст раздела
+Changelog/Archive/index.xml
+
+<changelogarchive version="0" next="42">
+	<page name="OrionChangelogEN.html" hash="<blake3 страницы>"/>
+	<entry id="41" page="OrionChangelogEN.html" title="1.0.5.2" hash="<blake3 раздела>" order="0"/>
+	<term text="crash" entries="12 41"/>
+</changelogarchive>
+@endcode
+При получении страницы заново разбираются только новые и измененные разделы; неизменная страница
+не разбирается вовсе. Разделы, удаленные со страницы, остаются в архиве.
+**/
+//----------------------------------------------------------------------------------
+#ifndef CHANGELOGARCHIVE_H
+#define CHANGELOGARCHIVE_H
+//----------------------------------------------------------------------------------
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRegularExpression>
+#include <QSet>
+#include <QStringList>
+#include <QTextDocumentFragment>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <algorithm>
+#include "changelogcache.hpp"
+#include "hashcalculator.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CChangelogArchiveEntry class
+ * Запись архива - один раздел страницы
+ */
+class CChangelogArchiveEntry
+{
+public:
+	CChangelogArchiveEntry() {}
+	~CChangelogArchiveEntry() {}
+
+	//! Номер записи
+	int Id{ 0 };
+
+	//! Страница (язык), из которой взят раздел
+	QString Page{ "" };
+
+	//! Заголовок раздела (версия)
+	QString Title{ "" };
+
+	//! Хэш текста раздела
+	QString Hash{ "" };
+
+	//! Положение на странице, 0 - самый новый раздел
+	int Order{ 0 };
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CChangelogArchive class
+ * Архив и индекс. Один экземпляр, доступ из любых потоков.
+ */
+class CChangelogArchive
+{
+private:
+	//! Минимальная длина индексируемого слова
+	enum { MIN_TERM_LENGTH = 2 };
+
+	//! Максимальная длина заголовка без тега заголовка (первая строка раздела)
+	enum { MAX_TITLE_LENGTH = 80 };
+
+	//! Раздел полученной страницы, разобранный вне блокировки
+	struct CParsedSection
+	{
+		int Id;
+		QString Title;
+		QString Hash;
+		int Order;
+
+		//! Раздел новый или изменился (иначе меняется только положение)
+		bool Changed;
+
+		//! Слова раздела и слова прежнего текста записи (убираются из индекса)
+		QSet<QString> Terms;
+		QSet<QString> OldTerms;
+	};
+
+	//! Индекс и записи (поиск из потока интерфейса ждет только слияния результата)
+	QMutex m_Mutex;
+
+	//! Обновления архива выполняются по одному, разбор страницы - без m_Mutex
+	QMutex m_UpdateMutex;
+
+	//! Индекс загружен с диска
+	bool m_Loaded{ false };
+
+	//! Номер следующей записи
+	int m_NextId{ 1 };
+
+	//! Хэши последних разобранных страниц
+	QHash<QString, QString> m_Pages;
+
+	//! Записи по номеру
+	QHash<int, CChangelogArchiveEntry> m_Entries;
+
+	//! Номера записей по странице и заголовку
+	QHash<QString, int> m_Keys;
+
+	//! Обратный индекс, упорядочен для поиска по началу слова
+	QMap<QString, QSet<int>> m_Terms;
+
+	CChangelogArchive() {}
+
+	//----------------------------------------------------------------------------------
+	static QString Directory()
+	{
+		return QDir::currentPath() + "/Changelog/Archive";
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString EntryPath(const int &id)
+	{
+		return Directory() + "/entries/" + QString::number(id) + ".html";
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString Key(const QString &page, const QString &title)
+	{
+		return page + "\n" + title;
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString HashOf(const QString &text)
+	{
+		QByteArray data = text.toUtf8();
+
+		return CHashCalculator::HashData((const uchar *)data.constData(), data.size(), HA_BLAKE3);
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Заголовок раздела: текст первого заголовка h1-h3, без него - первая строка текста
+	static QString Title(const QString &section, const QString &text)
+	{
+		QRegularExpressionMatch heading = QRegularExpression("<h[1-3][^>]*>(.*?)</h[1-3]>", QRegularExpression::CaseInsensitiveOption | QRegularExpression::DotMatchesEverythingOption).match(section);
+
+		if (heading.hasMatch())
+			return QTextDocumentFragment::fromHtml(heading.captured(1)).toPlainText().simplified();
+
+		return text.trimmed().section('\n', 0, 0).simplified().left(MAX_TITLE_LENGTH);
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Добавить или убрать запись из индекса
+	void Index(const int &id, const QSet<QString> &terms, const bool &add)
+	{
+		for (const QString &term : terms)
+		{
+			if (add)
+				m_Terms[term].insert(id);
+			else
+			{
+				auto it = m_Terms.find(term);
+
+				if (it != m_Terms.end())
+				{
+					it.value().remove(id);
+
+					if (it.value().isEmpty())
+						m_Terms.erase(it);
+				}
+			}
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString ReadEntry(const int &id)
+	{
+		QFile file(EntryPath(id));
+
+		if (!file.open(QIODevice::ReadOnly))
+			return "";
+
+		QString html = QString::fromUtf8(file.readAll());
+		file.close();
+
+		return html;
+	}
+
+	//----------------------------------------------------------------------------------
+	void Load()
+	{
+		if (m_Loaded)
+			return;
+
+		m_Loaded = true;
+
+		QFile file(Directory() + "/index.xml");
+
+		if (!file.open(QIODevice::ReadOnly))
+			return;
+
+		QXmlStreamReader reader(&file);
+
+		while (!reader.atEnd() && !reader.hasError())
+		{
+			if (reader.readNext() != QXmlStreamReader::StartElement)
+				continue;
+
+			QXmlStreamAttributes attributes = reader.attributes();
+
+			if (reader.name() == "changelogarchive")
+				m_NextId = qMax(attributes.value("next").toInt(), 1);
+			else if (reader.name() == "page")
+				m_Pages[attributes.value("name").toString()] = attributes.value("hash").toString();
+			else if (reader.name() == "entry")
+			{
+				CChangelogArchiveEntry entry;
+				entry.Id = attributes.value("id").toInt();
+				entry.Page = attributes.value("page").toString();
+				entry.Title = attributes.value("title").toString();
+				entry.Hash = attributes.value("hash").toString();
+				entry.Order = attributes.value("order").toInt();
+
+				m_Entries[entry.Id] = entry;
+				m_Keys[Key(entry.Page, entry.Title)] = entry.Id;
+			}
+			else if (reader.name() == "term")
+			{
+				QSet<int> &ids = m_Terms[attributes.value("text").toString()];
+
+				for (const QString &id : attributes.value("entries").toString().split(' ', QString::SkipEmptyParts))
+					ids.insert(id.toInt());
+			}
+		}
+
+		file.close();
+
+		//! Испорченный индекс строится заново при следующем получении страниц
+		if (reader.hasError())
+		{
+			m_Pages.clear();
+			m_Entries.clear();
+			m_Keys.clear();
+			m_Terms.clear();
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	void Save()
+	{
+		QDir().mkpath(Directory());
+
+		QFile file(Directory() + "/index.xml.part");
+
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+			return;
+
+		QXmlStreamWriter writter(&file);
+
+		writter.setAutoFormatting(true);
+
+		writter.writeStartDocument();
+
+		writter.writeStartElement("changelogarchive");
+		writter.writeAttribute("version", "0");
+		writter.writeAttribute("next", QString::number(m_NextId));
+
+		for (auto it = m_Pages.constBegin(); it != m_Pages.constEnd(); ++it)
+		{
+			writter.writeStartElement("page");
+			writter.writeAttribute("name", it.key());
+			writter.writeAttribute("hash", it.value());
+			writter.writeEndElement(); // page
+		}
+
+		for (const CChangelogArchiveEntry &entry : m_Entries)
+		{
+			writter.writeStartElement("entry");
+			writter.writeAttribute("id", QString::number(entry.Id));
+			writter.writeAttribute("page", entry.Page);
+			writter.writeAttribute("title", entry.Title);
+			writter.writeAttribute("hash", entry.Hash);
+			writter.writeAttribute("order", QString::number(entry.Order));
+			writter.writeEndElement(); // entry
+		}
+
+		for (auto it = m_Terms.constBegin(); it != m_Terms.constEnd(); ++it)
+		{
+			QStringList ids;
+
+			for (const int &id : it.value())
+				ids.push_back(QString::number(id));
+
+			writter.writeStartElement("term");
+			writter.writeAttribute("text", it.key());
+			writter.writeAttribute("entries", ids.join(' '));
+			writter.writeEndElement(); // term
+		}
+
+		writter.writeEndElement(); // changelogarchive
+
+		writter.writeEndDocument();
+
+		file.close();
+
+		QFile::remove(Directory() + "/index.xml");
+		QFile::rename(Directory() + "/index.xml.part", Directory() + "/index.xml");
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	static CChangelogArchive &Instance()
+	{
+		static CChangelogArchive archive;
+		return archive;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Terms Слова текста для индекса и запроса (в нижнем регистре, номера версий целиком)
+	 * @param text Текст
+	 * @return Слова в порядке следования
+	 */
+	static QStringList Terms(const QString &text)
+	{
+		QStringList terms;
+
+		for (QString term : text.toLower().split(QRegularExpression("[^\\w.]+", QRegularExpression::UseUnicodePropertiesOption), QString::SkipEmptyParts))
+		{
+			//! Точка остается только внутри слова ("1.0.5.2"), но не в конце предложения
+			while (term.startsWith('.'))
+				term.remove(0, 1);
+
+			while (term.endsWith('.'))
+				term.chop(1);
+
+			if (term.length() >= MIN_TERM_LENGTH)
+				terms.push_back(term);
+		}
+
+		return terms;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Update Добавить в архив разделы полученной страницы
+	 * @param page Страница ("OrionChangelogEN.html")
+	 * @param data Страница в том виде, в котором ее прислал сервер
+	 * @return true если архив изменился
+	 */
+	bool Update(const QString &page, const QByteArray &data)
+	{
+		QString pageHash = CHashCalculator::HashData((const uchar *)data.constData(), data.size(), HA_BLAKE3);
+
+		QMutexLocker updateLocker(&m_UpdateMutex);
+
+		//! Записи страницы по заголовку; пока обновление одно, они меняются только здесь
+		QHash<QString, CChangelogArchiveEntry> known;
+		int nextId = 1;
+
+		{
+			QMutexLocker locker(&m_Mutex);
+
+			Load();
+
+			if (m_Pages.value(page) == pageHash)
+				return false;
+
+			for (const CChangelogArchiveEntry &entry : m_Entries)
+			{
+				if (entry.Page == page)
+					known[entry.Title] = entry;
+			}
+
+			nextId = m_NextId;
+		}
+
+		QString head = "";
+		QStringList sections = CChangelogCache::Sections(CChangelogCache::Decode(data), head);
+		QList<CParsedSection> parsed;
+		QSet<int> seen;
+
+		QDir().mkpath(Directory() + "/entries");
+
+		for (const QString &section : sections)
+		{
+			QString text = QTextDocumentFragment::fromHtml(section).toPlainText();
+			QString title = Title(section, text);
+
+			//! Разделитель без текста (<hr> перед заголовком) - не запись
+			if (!title.length())
+				continue;
+
+			QString hash = HashOf(section);
+			auto old = known.constFind(title);
+			int id = (old != known.constEnd() ? old->Id : 0);
+
+			if (id && seen.contains(id))
+				continue;
+
+			CParsedSection item;
+			item.Id = id;
+			item.Title = title;
+			item.Hash = hash;
+			item.Order = seen.size();
+			item.Changed = (!id || old->Hash != hash);
+
+			if (item.Changed)
+			{
+				if (id)
+					item.OldTerms = Terms(QTextDocumentFragment::fromHtml(ReadEntry(id)).toPlainText()).toSet();
+				else
+				{
+					item.Id = id = nextId++;
+					known[title].Id = id;
+				}
+
+				item.Terms = Terms(text).toSet();
+
+				QFile file(EntryPath(id));
+
+				if (file.open(QIODevice::WriteOnly))
+				{
+					file.write(section.toUtf8());
+					file.close();
+				}
+			}
+
+			parsed.push_back(item);
+			seen.insert(id);
+		}
+
+		QMutexLocker locker(&m_Mutex);
+
+		m_NextId = nextId;
+
+		for (const CParsedSection &item : parsed)
+		{
+			CChangelogArchiveEntry &entry = m_Entries[item.Id];
+			entry.Order = item.Order;
+
+			if (!item.Changed)
+				continue;
+
+			Index(item.Id, item.OldTerms, false);
+
+			entry.Id = item.Id;
+			entry.Page = page;
+			entry.Title = item.Title;
+			entry.Hash = item.Hash;
+			m_Keys[Key(page, item.Title)] = item.Id;
+
+			Index(item.Id, item.Terms, true);
+		}
+
+		//! Удаленные со страницы разделы остаются в архиве после оставшихся
+		for (CChangelogArchiveEntry &entry : m_Entries)
+		{
+			if (entry.Page == page && !seen.contains(entry.Id))
+				entry.Order += seen.size();
+		}
+
+		m_Pages[page] = pageHash;
+
+		Save();
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Search Найти записи, содержащие все слова запроса (каждое - как начало слова)
+	 * @param page Страница (язык)
+	 * @param query Запрос
+	 * @param limit Максимальное количество записей
+	 * @return Записи, новые первыми
+	 */
+	QList<CChangelogArchiveEntry> Search(const QString &page, const QString &query, const int &limit)
+	{
+		QList<CChangelogArchiveEntry> result;
+		QStringList terms = Terms(query);
+
+		if (terms.isEmpty())
+			return result;
+
+		QMutexLocker locker(&m_Mutex);
+
+		Load();
+
+		QSet<int> found;
+		bool first = true;
+
+		for (const QString &term : terms)
+		{
+			QSet<int> matches;
+
+			for (auto it = m_Terms.lowerBound(term); it != m_Terms.end() && it.key().startsWith(term); ++it)
+				matches.unite(it.value());
+
+			if (first)
+				found = matches;
+			else
+				found.intersect(matches);
+
+			first = false;
+
+			if (found.isEmpty())
+				return result;
+		}
+
+		for (const int &id : found)
+		{
+			const CChangelogArchiveEntry &entry = m_Entries.value(id);
+
+			if (entry.Page == page)
+				result.push_back(entry);
+		}
+
+		std::sort(result.begin(), result.end(), [](const CChangelogArchiveEntry &a, const CChangelogArchiveEntry &b) { return a.Order < b.Order; });
+
+		return result.mid(0, limit);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief EntryHtml Текст записи
+	 * @param id Номер записи
+	 * @return HTML раздела
+	 */
+	QString EntryHtml(const int &id)
+	{
+		return ReadEntry(id);
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // CHANGELOGARCHIVE_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,331 @@
+/**
+@file ChangelogCache.hpp
+
+@brief История изменений на диске (по файлу на язык) и разбиение для показа по частям
+
+@code
+Changelog/OrionChangelogEN.html         страница в том виде, в котором ее прислал сервер
+Changelog/OrionChangelogEN.html.xml     <changelog etag="..." lastmodified="..." time="..." hash="<blake3>"/>
+@endcode
+Сохраненная страница показывается сразу, затем проверяется на сервере условным запросом
+(If-None-Match / If-Modified-Since): 304 - страница не изменилась и не скачивается заново.
+Страница, не совпавшая со своим хэшем, считается отсутствующей.
+Разделы истории идут от новых к старым, поэтому первая часть - самые новые изменения.
+**/
+//----------------------------------------------------------------------------------
+#ifndef CHANGELOGCACHE_H
+#define CHANGELOGCACHE_H
+//----------------------------------------------------------------------------------
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTextCodec>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include "hashcalculator.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CChangelogEntry class
+ * Сохраненная страница истории изменений и ее валидаторы
+ */
+class CChangelogEntry
+{
+public:
+	CChangelogEntry() {}
+	~CChangelogEntry() {}
+
+	//! Содержимое страницы
+	QByteArray Data;
+
+	//! Валидаторы из ответа сервера
+	QString ETag{ "" };
+	QString LastModified{ "" };
+
+	//! Время последней проверки на сервере, мс от начала эпохи
+	qint64 Time{ 0 };
+
+	//----------------------------------------------------------------------------------
+	//! Время с последней проверки, мс
+	qint64 Age() const
+	{
+		return QDateTime::currentMSecsSinceEpoch() - Time;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Validators Заголовки условного запроса
+	 * @return Заголовки (пусто - страницы нет, нужен обычный запрос)
+	 */
+	QByteArray Validators() const
+	{
+		QByteArray headers;
+
+		if (Data.isEmpty())
+			return headers;
+
+		if (ETag.length())
+			headers += "If-None-Match: " + ETag.toLatin1() + "\r\n";
+
+		if (LastModified.length())
+			headers += "If-Modified-Since: " + LastModified.toLatin1() + "\r\n";
+
+		return headers;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CChangelogCache class
+ * Хранение страниц истории изменений и подготовка их к показу
+ */
+class CChangelogCache
+{
+public:
+	//! Сколько не проверять сохраненную страницу на сервере, мс
+	enum { FRESHNESS_MS = 10 * 60 * 1000 };
+
+private:
+	//! Разделов в первой части (показывается сразу)
+	enum { FIRST_PART_SECTIONS = 3 };
+
+	//! Разделов в каждой следующей части
+	enum { PART_SECTIONS = 20 };
+
+	//----------------------------------------------------------------------------------
+	static QString FilePath(const QString &page)
+	{
+		return QDir::currentPath() + "/Changelog/" + page;
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString MetaPath(const QString &page)
+	{
+		return FilePath(page) + ".xml";
+	}
+
+	//----------------------------------------------------------------------------------
+	static bool ReadMeta(const QString &page, CChangelogEntry &entry, QString &hash)
+	{
+		QFile file(MetaPath(page));
+
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		QXmlStreamReader reader(&file);
+		bool result = false;
+
+		while (!reader.atEnd() && !reader.hasError())
+		{
+			if (reader.readNext() == QXmlStreamReader::StartElement && reader.name() == "changelog")
+			{
+				QXmlStreamAttributes attributes = reader.attributes();
+
+				entry.ETag = attributes.value("etag").toString();
+				entry.LastModified = attributes.value("lastmodified").toString();
+				entry.Time = attributes.value("time").toLongLong();
+				hash = attributes.value("hash").toString();
+				result = true;
+			}
+		}
+
+		file.close();
+
+		return (result && !reader.hasError());
+	}
+
+	//----------------------------------------------------------------------------------
+	static bool WriteMeta(const QString &page, const CChangelogEntry &entry, const QString &hash)
+	{
+		QFile file(MetaPath(page));
+
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+			return false;
+
+		QXmlStreamWriter writter(&file);
+
+		writter.setAutoFormatting(true);
+
+		writter.writeStartDocument();
+
+		writter.writeStartElement("changelog");
+		writter.writeAttribute("etag", entry.ETag);
+		writter.writeAttribute("lastmodified", entry.LastModified);
+		writter.writeAttribute("time", QString::number(entry.Time));
+		writter.writeAttribute("hash", hash);
+		writter.writeEndElement(); // changelog
+
+		writter.writeEndDocument();
+
+		file.close();
+
+		return true;
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Load Прочитать сохраненную страницу
+	 * @param page Страница ("OrionChangelogEN.html")
+	 * @param entry Страница и валидаторы
+	 * @return true если страница есть и цела
+	 */
+	static bool Load(const QString &page, CChangelogEntry &entry)
+	{
+		QString hash = "";
+
+		if (!ReadMeta(page, entry, hash))
+			return false;
+
+		QFile file(FilePath(page));
+
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		entry.Data = file.readAll();
+		file.close();
+
+		if (!CHashCalculator::Compare(hash, CHashCalculator::HashData((const uchar *)entry.Data.constData(), entry.Data.size(), HA_BLAKE3)))
+		{
+			entry = CChangelogEntry();
+
+			return false;
+		}
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Save Сохранить полученную с сервера страницу
+	 * @param page Страница
+	 * @param entry Страница и валидаторы
+	 */
+	static void Save(const QString &page, const CChangelogEntry &entry)
+	{
+		QString path = FilePath(page);
+
+		QDir().mkpath(QFileInfo(path).absolutePath());
+
+		QFile file(path + ".part");
+
+		if (!file.open(QIODevice::WriteOnly))
+			return;
+
+		bool written = (file.write(entry.Data) == entry.Data.size());
+		file.close();
+
+		//! Описание пишется после страницы: прерванная запись оставит несовпадающий хэш, а не чужой текст
+		if (!written || (QFile::exists(path) && !QFile::remove(path)) || !QFile::rename(path + ".part", path))
+		{
+			QFile::remove(path + ".part");
+			return;
+		}
+
+		WriteMeta(page, entry, CHashCalculator::HashData((const uchar *)entry.Data.constData(), entry.Data.size(), HA_BLAKE3));
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Touch Сервер подтвердил, что страница не изменилась
+	 * @param page Страница
+	 */
+	static void Touch(const QString &page)
+	{
+		CChangelogEntry entry;
+		QString hash = "";
+
+		if (ReadMeta(page, entry, hash))
+		{
+			entry.Time = QDateTime::currentMSecsSinceEpoch();
+			WriteMeta(page, entry, hash);
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Decode Текст страницы в кодировке из BOM или meta charset (без них - локальная кодировка)
+	 * @param data Страница
+	 * @return Текст
+	 */
+	static QString Decode(const QByteArray &data)
+	{
+		return QTextCodec::codecForHtml(data, QTextCodec::codecForLocale())->toUnicode(data);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Sections Разделы страницы (по заголовкам h1-h3 и горизонтальным линиям)
+	 * @param html Страница
+	 * @param head Начало страницы до <body> (стили), пусто - страница без <body>
+	 * @return Разделы в порядке следования (вступление идет вместе с первым)
+	 */
+	static QStringList Sections(const QString &html, QString &head)
+	{
+		QStringList sections;
+		QString body = html;
+
+		head = "";
+
+		QRegularExpressionMatch bodyTag = QRegularExpression("<body[^>]*>", QRegularExpression::CaseInsensitiveOption).match(html);
+
+		if (bodyTag.hasMatch())
+		{
+			head = html.left(bodyTag.capturedStart());
+			body = html.mid(bodyTag.capturedEnd());
+
+			int bodyEnd = body.lastIndexOf("</body", -1, Qt::CaseInsensitive);
+
+			if (bodyEnd != -1)
+				body.truncate(bodyEnd);
+		}
+
+		int from = 0;
+		QRegularExpressionMatchIterator it = QRegularExpression("<(h[1-3]|hr)\\b", QRegularExpression::CaseInsensitiveOption).globalMatch(body);
+
+		while (it.hasNext())
+		{
+			int start = it.next().capturedStart();
+
+			if (start > from)
+			{
+				sections.push_back(body.mid(from, start - from));
+				from = start;
+			}
+		}
+
+		if (from < body.length())
+			sections.push_back(body.mid(from));
+
+		return sections;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Split Разбить страницу на части для показа по мере готовности
+	 * Каждая часть - самостоятельный документ с заголовком (стилями) исходной страницы
+	 * @param html Страница
+	 * @return Части в порядке следования, первая - короче остальных
+	 */
+	static QStringList Split(const QString &html)
+	{
+		QStringList parts;
+		QString head = "";
+		QStringList sections = Sections(html, head);
+		int count = FIRST_PART_SECTIONS;
+
+		for (int i = 0; i < sections.size(); i += count, count = PART_SECTIONS)
+		{
+			QString part = QStringList(sections.mid(i, count)).join("");
+
+			parts.push_back(head.length() ? head + "<body>" + part + "</body></html>" : part);
+		}
+
+		return parts;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // CHANGELOGCACHE_H
+//----------------------------------------------------------------------------------
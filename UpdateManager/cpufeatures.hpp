@@ -0,0 +1,97 @@
+/**
+@file CpuFeatures.hpp
+
+@brief Определение расширений процессора для ускоренных алгоритмов
+**/
+//----------------------------------------------------------------------------------
+#ifndef CPUFEATURES_H
+#define CPUFEATURES_H
+//----------------------------------------------------------------------------------
+#include <QtGlobal>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ORION_CPU_X86 1
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define ORION_TARGET(features)
+#else
+#include <cpuid.h>
+#define ORION_TARGET(features) __attribute__((target(features)))
+#endif
+
+#include <immintrin.h>
+#endif
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CCpuFeatures class
+ * Набор поддерживаемых процессором расширений (определяется один раз)
+ */
+class CCpuFeatures
+{
+private:
+	CCpuFeatures()
+	{
+#if defined(ORION_CPU_X86)
+		uint regs[4] = { 0, 0, 0, 0 };
+		uint maxLeaf = 0;
+
+#if defined(_MSC_VER)
+		__cpuid((int *)regs, 0);
+		maxLeaf = regs[0];
+
+		if (maxLeaf >= 1)
+		{
+			__cpuid((int *)regs, 1);
+			m_Ssse3 = ((regs[2] & (1 << 9)) != 0);
+			m_Sse41 = ((regs[2] & (1 << 19)) != 0);
+		}
+
+		if (maxLeaf >= 7)
+		{
+			__cpuidex((int *)regs, 7, 0);
+			m_Sha = ((regs[1] & (1 << 29)) != 0);
+		}
+#else
+		maxLeaf = __get_cpuid_max(0, nullptr);
+
+		if (maxLeaf >= 1 && __get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]))
+		{
+			m_Ssse3 = ((regs[2] & (1 << 9)) != 0);
+			m_Sse41 = ((regs[2] & (1 << 19)) != 0);
+		}
+
+		if (maxLeaf >= 7)
+		{
+			__cpuid_count(7, 0, regs[0], regs[1], regs[2], regs[3]);
+			m_Sha = ((regs[1] & (1 << 29)) != 0);
+		}
+#endif
+#endif
+	}
+
+	//! Поддержка SSSE3
+	bool m_Ssse3{ false };
+
+	//! Поддержка SSE4.1
+	bool m_Sse41{ false };
+
+	//! Поддержка SHA extensions
+	bool m_Sha{ false };
+
+	static const CCpuFeatures &Instance()
+	{
+		static const CCpuFeatures features;
+		return features;
+	}
+
+public:
+	//! Можно использовать 4-полосную SSE4.1 реализацию (BLAKE3)
+	static bool HasSse41() { return Instance().m_Sse41 && Instance().m_Ssse3; }
+
+	//! Можно использовать аппаратные SHA-256 инструкции
+	static bool HasSha() { return Instance().m_Sha && Instance().m_Sse41 && Instance().m_Ssse3; }
+};
+//----------------------------------------------------------------------------------
+#endif // CPUFEATURES_H
+//----------------------------------------------------------------------------------
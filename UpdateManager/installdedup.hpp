@@ -0,0 +1,302 @@
+/**
+@file InstallDedup.hpp
+
+@brief Объединение одинаковых файлов нескольких установок клиента
+
+Одинаковые файлы (размер + BLAKE3) разных установок на одном томе заменяются жесткими ссылками
+на один файл: место на диске и страницы файлового кэша становятся общими для всех запущенных клиентов.
+На Linux сначала пробуется reflink (FICLONE): копии делят блоки, но остаются отдельными файлами.
+Обновление не пишет в существующий файл, а заменяет его новым (запись рядом и переименование),
+поэтому изменение одной установки не затрагивает файлы других.
+**/
+//----------------------------------------------------------------------------------
+#ifndef INSTALLDEDUP_H
+#define INSTALLDEDUP_H
+//----------------------------------------------------------------------------------
+#include <QtGlobal>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QMap>
+#include <QPair>
+#include <QStringList>
+#include "hashcalculator.hpp"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#endif
+
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CDedupReport class
+ * Результат объединения файлов
+ */
+class CDedupReport
+{
+public:
+	CDedupReport() {}
+	~CDedupReport() {}
+
+	//! Количество групп одинаковых файлов
+	int Groups{ 0 };
+
+	//! Количество файлов, замененных ссылками
+	int Linked{ 0 };
+
+	//! Количество файлов, которые не удалось заменить (заняты запущенным клиентом, другой том)
+	int Failed{ 0 };
+
+	//! Освобождено на диске, байт
+	qint64 SavedBytes{ 0 };
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Summary Краткое описание результата для пользователя
+	 * @return Текст
+	 */
+	QString Summary() const
+	{
+		QString text = "";
+		text.sprintf("%i group(s) of identical files, %i file(s) shared, %.1f MB freed", Groups, Linked, (double)SavedBytes / 1048576.0);
+
+		if (Failed)
+			text += QString(", %1 file(s) skipped (in use or on another disk)").arg(Failed);
+
+		return text;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CInstallDedup class
+ * Поиск одинаковых файлов и замена копий ссылками
+ */
+class CInstallDedup
+{
+private:
+	//! Файлы меньше этого размера не объединяются (выигрыш не стоит риска)
+	enum { MIN_FILE_SIZE = 1024 * 1024 };
+
+	/**
+	 * @brief The CFileId class
+	 * Физический файл: том, номер файла на томе и количество ссылок на него
+	 */
+	class CFileId
+	{
+	public:
+		quint64 Volume{ 0 };
+		quint64 Index{ 0 };
+		int Links{ 0 };
+	};
+
+	//----------------------------------------------------------------------------------
+	static bool GetFileId(const QString &path, CFileId &id)
+	{
+#if defined(Q_OS_WIN)
+		HANDLE file = CreateFileW((LPCWSTR)QDir::toNativeSeparators(path).utf16(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		BY_HANDLE_FILE_INFORMATION info;
+		bool result = (GetFileInformationByHandle(file, &info) != FALSE);
+
+		CloseHandle(file);
+
+		if (result)
+		{
+			id.Volume = info.dwVolumeSerialNumber;
+			id.Index = ((quint64)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+			id.Links = (int)info.nNumberOfLinks;
+		}
+
+		return result;
+#elif defined(Q_OS_LINUX)
+		struct stat info;
+
+		if (stat(QFile::encodeName(path).constData(), &info))
+			return false;
+
+		id.Volume = (quint64)info.st_dev;
+		id.Index = (quint64)info.st_ino;
+		id.Links = (int)info.st_nlink;
+
+		return true;
+#else
+		Q_UNUSED(path);
+		Q_UNUSED(id);
+
+		return false;
+#endif
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Share Заменить target копией source, разделяющей с ним данные
+	 * Новая ссылка создается рядом и переименовывается поверх target: при ошибке target не меняется
+	 * @param source Оставляемый файл
+	 * @param target Заменяемая копия
+	 * @return true если копия заменена
+	 */
+	static bool Share(const QString &source, const QString &target)
+	{
+		QString temp = target + ".dedup";
+
+		QFile::remove(temp);
+
+#if defined(Q_OS_WIN)
+		bool result = (CreateHardLinkW((LPCWSTR)QDir::toNativeSeparators(temp).utf16(), (LPCWSTR)QDir::toNativeSeparators(source).utf16(), NULL) != FALSE);
+
+		if (result)
+			result = (MoveFileExW((LPCWSTR)QDir::toNativeSeparators(temp).utf16(), (LPCWSTR)QDir::toNativeSeparators(target).utf16(), MOVEFILE_REPLACE_EXISTING) != FALSE);
+#elif defined(Q_OS_LINUX)
+		QByteArray sourcePath = QFile::encodeName(source);
+		QByteArray tempPath = QFile::encodeName(temp);
+		bool result = false;
+
+		//! Reflink не требует разрыва при обновлении, поэтому пробуем его первым
+		int in = open(sourcePath.constData(), O_RDONLY);
+
+		if (in != -1)
+		{
+			int out = open(tempPath.constData(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+
+			if (out != -1)
+			{
+				result = !ioctl(out, FICLONE, in);
+				close(out);
+
+				if (!result)
+					unlink(tempPath.constData());
+			}
+
+			close(in);
+		}
+
+		if (!result)
+			result = !link(sourcePath.constData(), tempPath.constData());
+
+		if (result)
+			result = !rename(tempPath.constData(), QFile::encodeName(target).constData());
+#else
+		bool result = false;
+#endif
+
+		if (!result)
+			QFile::remove(temp);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Run Объединить одинаковые файлы установок
+	 * @param directories Директории клиентов
+	 * @param operation Операция (между файлами проверяется Stopped, уже связанные файлы остаются связанными)
+	 * @return Результат (до прерывания, если операция прервана)
+	 */
+	static CDedupReport Run(const QStringList &directories, const COperation &operation = COperation())
+	{
+		CDedupReport report;
+
+		//! Кандидаты - только файлы одинакового размера
+		QMap<qint64, QStringList> bySize;
+
+		for (const QString &directory : directories)
+		{
+			QDirIterator it(directory, QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+
+			while (it.hasNext())
+			{
+				if (operation.Stopped())
+					return report;
+
+				it.next();
+
+				if (it.fileInfo().size() >= MIN_FILE_SIZE)
+					bySize[it.fileInfo().size()].push_back(it.filePath());
+			}
+		}
+
+		for (auto size = bySize.constBegin(); size != bySize.constEnd(); ++size)
+		{
+			if (size.value().size() < 2)
+				continue;
+
+			//! Уже связанные файлы - один физический файл, его хэш считаем один раз
+			QMap<QPair<quint64, quint64>, QStringList> names;
+
+			for (const QString &path : size.value())
+			{
+				CFileId id;
+
+				if (GetFileId(path, id))
+					names[qMakePair(id.Volume, id.Index)].push_back(path);
+			}
+
+			//! Физические файлы с одинаковым содержимым на одном томе
+			QMap<QPair<quint64, QString>, QList<QStringList>> groups;
+
+			for (auto file = names.constBegin(); file != names.constEnd(); ++file)
+			{
+				QFile data(file.value().first());
+
+				if (!data.open(QIODevice::ReadOnly))
+					continue;
+
+				QString hash = CHashCalculator::HashFile(data, HA_BLAKE3, nullptr, &operation);
+
+				data.close();
+
+				//! Недосчитанный хэш (пустой) объединил бы разные файлы
+				if (operation.Stopped())
+					return report;
+
+				groups[qMakePair(file.key().first, hash)].push_back(file.value());
+			}
+
+			for (auto group = groups.constBegin(); group != groups.constEnd(); ++group)
+			{
+				const QList<QStringList> &files = group.value();
+
+				if (files.size() < 2)
+					continue;
+
+				report.Groups++;
+
+				const QString &source = files.first().first();
+
+				for (int i = 1; i < files.size(); i++)
+				{
+					bool shared = true;
+
+					for (const QString &path : files.at(i))
+					{
+						if (Share(source, path))
+							report.Linked++;
+						else
+						{
+							report.Failed++;
+							shared = false;
+						}
+					}
+
+					//! Место освобождается, только когда заменены все имена физического файла
+					if (shared)
+						report.SavedBytes += size.key();
+				}
+			}
+		}
+
+		return report;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // INSTALLDEDUP_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,331 @@
+/**
+@file InstallSnapshot.hpp
+
+@brief Локальные снимки файлов клиента перед обновлением (откат без скачивания резервной версии)
+
+Снимки хранятся рядом с настройками лаунчера, по директории на установку клиента:
+@code
+Snapshots/<ключ описи клиента>/<время>/files/...     заменяемые файлы (жесткие ссылки, если том тот же)
+Snapshots/<ключ описи клиента>/<время>/snapshot.xml
+
+<snapshot version="1.0.5.2" time="..." directory="C:/Games/OrionUO">
+	<file name="OrionUO.exe"/>
+	<file name="Plugins/New.dll" existed="no"/>
+</snapshot>
+@endcode
+Файлы без предыдущей версии при откате удаляются. Снимок без snapshot.xml - незавершенный.
+Ссылки безопасны: обновление не пишет в существующий файл, а заменяет его переименованием.
+**/
+//----------------------------------------------------------------------------------
+#ifndef INSTALLSNAPSHOT_H
+#define INSTALLSNAPSHOT_H
+//----------------------------------------------------------------------------------
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include "installdedup.hpp"
+#include "installverifier.hpp"
+#include "merkletree.hpp"
+
+#include <QDebug>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CSnapshotInfo class
+ * Описание снимка
+ */
+class CSnapshotInfo
+{
+public:
+	CSnapshotInfo() {}
+	~CSnapshotInfo() {}
+
+	//! Идентификатор (название директории снимка)
+	QString Id{ "" };
+
+	//! Версия клиента на момент снимка
+	QString Version{ "" };
+
+	//! Время снимка, мс от начала эпохи
+	qint64 Time{ 0 };
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Name Название для списка резервных версий
+	 * @return Текст
+	 */
+	QString Name() const
+	{
+		return "Local: " + Version + " (" + QDateTime::fromMSecsSinceEpoch(Time).toString("yyyy-MM-dd hh:mm") + ")";
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CInstallSnapshot class
+ * Снимки установки клиента: создание, список, откат, удаление старых
+ */
+class CInstallSnapshot
+{
+private:
+	//! Количество хранимых снимков по умолчанию
+	enum { DEFAULT_RETENTION = 3 };
+
+	//----------------------------------------------------------------------------------
+	static QAtomicInt &RetentionValue()
+	{
+		static QAtomicInt retention(DEFAULT_RETENTION);
+		return retention;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Положить копию source в target: ссылкой, если возможно, иначе копированием
+	static bool Place(const QString &source, const QString &target)
+	{
+		QDir().mkpath(QFileInfo(target).absolutePath());
+
+		if (CInstallDedup::Share(source, target))
+			return true;
+
+		QFile::remove(target);
+
+		return QFile::copy(source, target);
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString SnapshotPath(const QString &clientDirectory, const QString &id)
+	{
+		return Root(clientDirectory) + "/" + id;
+	}
+
+	//----------------------------------------------------------------------------------
+	static bool Read(const QString &path, CSnapshotInfo &info, QList<QPair<QString, bool>> *files)
+	{
+		QFile file(path + "/snapshot.xml");
+
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		QXmlStreamReader reader(&file);
+		bool result = false;
+
+		while (!reader.atEnd() && !reader.hasError())
+		{
+			if (reader.readNext() != QXmlStreamReader::StartElement)
+				continue;
+
+			QXmlStreamAttributes attributes = reader.attributes();
+
+			if (reader.name() == "snapshot")
+			{
+				info.Id = QFileInfo(path).fileName();
+				info.Version = attributes.value("version").toString();
+				info.Time = attributes.value("time").toLongLong();
+				result = true;
+			}
+			else if (reader.name() == "file" && files != nullptr)
+				files->push_back(qMakePair(attributes.value("name").toString(), attributes.value("existed") != "no"));
+		}
+
+		file.close();
+
+		return (result && !reader.hasError());
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SetRetention Задать количество хранимых снимков установки
+	 * @param count Количество (0 - снимки не создаются)
+	 */
+	static void SetRetention(const int &count)
+	{
+		RetentionValue().store(qMax(count, 0));
+	}
+
+	//----------------------------------------------------------------------------------
+	static int Retention()
+	{
+		return RetentionValue().load();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Root Директория снимков установки
+	 * @param clientDirectory Директория клиента
+	 * @return Путь
+	 */
+	static QString Root(const QString &clientDirectory)
+	{
+		return QDir::currentPath() + "/Snapshots/" + QFileInfo(CInstallVerifier::InventoryPath(clientDirectory)).completeBaseName();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Take Сохранить файлы, которые будут заменены обновлением
+	 * @param clientDirectory Директория клиента
+	 * @param names Файлы (относительно директории клиента)
+	 * @param version Текущая версия клиента
+	 * @return Идентификатор снимка (пусто, если снимки отключены или не удалось сохранить)
+	 */
+	static QString Take(const QString &clientDirectory, const QStringList &names, const QString &version)
+	{
+		if (!Retention() || names.isEmpty())
+			return "";
+
+		QString id = QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss-zzz");
+		QString path = SnapshotPath(clientDirectory, id);
+
+		QDir().mkpath(path);
+
+		QFile file(path + "/snapshot.xml");
+
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+			return "";
+
+		QXmlStreamWriter writter(&file);
+
+		writter.setAutoFormatting(true);
+
+		writter.writeStartDocument();
+
+		writter.writeStartElement("snapshot");
+		writter.writeAttribute("version", version);
+		writter.writeAttribute("time", QString::number(QDateTime::currentMSecsSinceEpoch()));
+		writter.writeAttribute("directory", clientDirectory);
+
+		bool result = true;
+
+		for (const QString &name : names.toSet())
+		{
+			QString source = clientDirectory + "/" + name;
+			bool existed = QFile::exists(source);
+
+			if (existed && !Place(source, path + "/files/" + name))
+			{
+				result = false;
+				break;
+			}
+
+			writter.writeStartElement("file");
+
+			writter.writeAttribute("name", name);
+
+			if (!existed)
+				writter.writeAttribute("existed", "no");
+
+			writter.writeEndElement(); // file
+		}
+
+		writter.writeEndElement(); // snapshot
+
+		writter.writeEndDocument();
+
+		file.close();
+
+		if (!result)
+		{
+			qDebug() << "Failed to take snapshot of" << clientDirectory;
+			QDir(path).removeRecursively();
+
+			return "";
+		}
+
+		Prune(clientDirectory);
+
+		return id;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief List Снимки установки
+	 * @param clientDirectory Директория клиента
+	 * @return Снимки, новые первыми
+	 */
+	static QList<CSnapshotInfo> List(const QString &clientDirectory)
+	{
+		QList<CSnapshotInfo> list;
+		QString root = Root(clientDirectory);
+
+		//! Идентификатор - время, поэтому сортировка по имени - сортировка по времени
+		for (const QString &id : QDir(root).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name | QDir::Reversed))
+		{
+			CSnapshotInfo info;
+
+			if (Read(root + "/" + id, info, nullptr))
+				list.push_back(info);
+		}
+
+		return list;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Restore Вернуть файлы установки из снимка
+	 * @param clientDirectory Директория клиента
+	 * @param id Идентификатор снимка
+	 * @return true если все файлы восстановлены
+	 */
+	static bool Restore(const QString &clientDirectory, const QString &id)
+	{
+		QString path = SnapshotPath(clientDirectory, id);
+		CSnapshotInfo info;
+		QList<QPair<QString, bool>> files;
+
+		if (!Read(path, info, &files))
+			return false;
+
+		bool result = true;
+
+		for (const QPair<QString, bool> &file : files)
+		{
+			QString target = clientDirectory + "/" + file.first;
+
+			if (file.second)
+			{
+				//! Целевой файл заменяется, а не перезаписывается: он может быть общим с другими установками
+				if (!Place(path + "/files/" + file.first, target))
+				{
+					qDebug() << "Failed to restore file:" << target;
+					result = false;
+				}
+			}
+			else
+				QFile::remove(target);
+		}
+
+		//! Сохраненное состояние дерева описывает замененные файлы - после отката клиент проверяется заново
+		QFile::remove(CMerkleTreeState::StatePath(CInstallVerifier::InventoryPath(clientDirectory)));
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Prune Удалить снимки сверх заданного количества и незавершенные
+	 * @param clientDirectory Директория клиента
+	 */
+	static void Prune(const QString &clientDirectory)
+	{
+		QString root = Root(clientDirectory);
+		int kept = 0;
+
+		for (const QString &id : QDir(root).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name | QDir::Reversed))
+		{
+			CSnapshotInfo info;
+
+			if (kept < Retention() && Read(root + "/" + id, info, nullptr))
+				kept++;
+			else
+				QDir(root + "/" + id).removeRecursively();
+		}
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // INSTALLSNAPSHOT_H
+//----------------------------------------------------------------------------------
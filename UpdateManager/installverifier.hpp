@@ -0,0 +1,558 @@
+/**
+@file InstallVerifier.hpp
+
+@brief Проверка установленного клиента: опись директории, сверка с манифестом и прошлой описью
+**/
+//----------------------------------------------------------------------------------
+#ifndef INSTALLVERIFIER_H
+#define INSTALLVERIFIER_H
+//----------------------------------------------------------------------------------
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <QtConcurrent>
+#include "updateinfo.hpp"
+#include "hashcalculator.hpp"
+#include "peversionreader.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CInventoryEntry class
+ * Запись описи: файл клиента
+ */
+class CInventoryEntry
+{
+public:
+	CInventoryEntry() {}
+	~CInventoryEntry() {}
+
+	//! Путь относительно директории клиента (через '/')
+	QString Path{ "" };
+
+	//! Размер файла
+	qint64 Size{ 0 };
+
+	//! Время изменения (мс с начала эпохи)
+	qint64 Modified{ 0 };
+
+	//! Контрольная сумма
+	QString Hash{ "" };
+
+	//! Алгоритм контрольной суммы
+	QString HashAlgo{ "" };
+
+	//! Версия из ресурсов (только для файлов с версией в манифесте)
+	QString Version{ "" };
+};
+//----------------------------------------------------------------------------------
+//! Состояние файла после проверки
+enum VERIFY_STATE
+{
+	VS_OK = 0,		//! Файл в порядке
+	VS_MISSING,		//! Файл отсутствует
+	VS_TRUNCATED,	//! Файл короче, чем был
+	VS_CORRUPT,		//! Контрольная сумма не совпадает с манифестом
+	VS_OUTDATED,	//! Версия старее, чем в манифесте
+	VS_MODIFIED,	//! Файл вне манифеста изменился со времени прошлой проверки
+	VS_EXTRA		//! Файл вне манифеста, которого не было при прошлой проверке
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CVerifyResult class
+ * Результат проверки одного файла
+ */
+class CVerifyResult
+{
+public:
+	CVerifyResult() {}
+	CVerifyResult(const QString &path, const VERIFY_STATE &state, const bool &repairable)
+	: Path(path), State(state), Repairable(repairable) {}
+	~CVerifyResult() {}
+
+	//! Путь относительно директории клиента
+	QString Path{ "" };
+
+	//! Состояние
+	VERIFY_STATE State{ VS_OK };
+
+	//! Файл можно восстановить из манифеста
+	bool Repairable{ false };
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CVerifyReport class
+ * Отчет о проверке установки
+ */
+class CVerifyReport
+{
+public:
+	CVerifyReport() {}
+	~CVerifyReport() {}
+
+	//! Проверенная директория
+	QString Directory{ "" };
+
+	//! Количество просмотренных файлов
+	int FilesCount{ 0 };
+
+	//! Проблемные файлы
+	QList<CVerifyResult> Problems;
+
+	//! Файлы из манифеста, которые нужно скачать заново
+	QList<CUpdateInfo> RepairList;
+
+	//----------------------------------------------------------------------------------
+	static QString StateToText(const VERIFY_STATE &state)
+	{
+		switch (state)
+		{
+			case VS_MISSING:
+				return "missing";
+			case VS_TRUNCATED:
+				return "truncated";
+			case VS_CORRUPT:
+				return "corrupt";
+			case VS_OUTDATED:
+				return "outdated";
+			case VS_MODIFIED:
+				return "modified";
+			case VS_EXTRA:
+				return "extra";
+			default:
+				break;
+		}
+
+		return "ok";
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Summary Краткое описание результата для пользователя
+	 * @return Текст
+	 */
+	QString Summary() const
+	{
+		int counts[VS_EXTRA + 1] = { 0 };
+
+		for (const CVerifyResult &result : Problems)
+			counts[result.State]++;
+
+		QString text = "";
+		text.sprintf("Files checked: %i\nMissing: %i\nTruncated: %i\nCorrupt: %i\nOutdated: %i\nModified: %i\nUnknown: %i\nFiles to download again: %i",
+			FilesCount, counts[VS_MISSING], counts[VS_TRUNCATED], counts[VS_CORRUPT], counts[VS_OUTDATED], counts[VS_MODIFIED], counts[VS_EXTRA], RepairList.size());
+
+		return text;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Save Сохранить отчет в XML
+	 * @param path Путь к файлу отчета
+	 * @return true если отчет записан
+	 */
+	bool Save(const QString &path) const
+	{
+		QFile file(path);
+
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+			return false;
+
+		QXmlStreamWriter writter(&file);
+
+		writter.setAutoFormatting(true);
+
+		writter.writeStartDocument();
+
+		writter.writeStartElement("verifyreport");
+		writter.writeAttribute("version", "0");
+		writter.writeAttribute("directory", Directory);
+		writter.writeAttribute("date", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+		writter.writeAttribute("files", QString::number(FilesCount));
+		writter.writeAttribute("problems", QString::number(Problems.size()));
+		writter.writeAttribute("repair", QString::number(RepairList.size()));
+
+		for (const CVerifyResult &result : Problems)
+		{
+			writter.writeStartElement("file");
+
+			writter.writeAttribute("path", result.Path);
+			writter.writeAttribute("state", StateToText(result.State));
+			writter.writeAttribute("repairable", result.Repairable ? "true" : "false");
+
+			writter.writeEndElement(); // file
+		}
+
+		writter.writeEndElement(); // verifyreport
+
+		writter.writeEndDocument();
+
+		file.close();
+
+		return true;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CInstallVerifier class
+ * Проверка директории клиента
+ */
+class CInstallVerifier
+{
+private:
+	//----------------------------------------------------------------------------------
+	//! Ключ для сравнения путей (файловая система Windows нечувствительна к регистру)
+	static QString PathKey(const QString &path)
+	{
+		return QDir::fromNativeSeparators(path).toLower();
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Задание обхода одной поддиректории
+	struct CWalkTask
+	{
+		QString Directory;
+		QStringList Files;
+	};
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ListFiles Параллельный обход директории (каждая поддиректория верхнего уровня - отдельная задача)
+	 * @param root Корневая директория
+	 * @param operation Операция (после отмены обход прекращается)
+	 * @return Список путей относительно root
+	 */
+	static QStringList ListFiles(const QString &root, const COperation &operation)
+	{
+		const QDir::Filters fileFilters = QDir::Files | QDir::Hidden | QDir::System;
+		QDir rootDir(root);
+
+		QStringList result = rootDir.entryList(fileFilters);
+
+		QVector<CWalkTask> tasks;
+
+		for (const QString &name : rootDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System))
+		{
+			CWalkTask task;
+			task.Directory = name;
+			tasks.push_back(task);
+		}
+
+		QtConcurrent::blockingMap(tasks, [&rootDir, fileFilters, &operation](CWalkTask &task)
+		{
+			QDirIterator it(rootDir.filePath(task.Directory), fileFilters, QDirIterator::Subdirectories);
+
+			while (it.hasNext() && !operation.Stopped())
+				task.Files << rootDir.relativeFilePath(it.next());
+		});
+
+		for (const CWalkTask &task : tasks)
+			result << task.Files;
+
+		return result;
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief InventoryPath Путь к файлу описи для директории клиента (хранится рядом с настройками лаунчера)
+	 * @param directory Директория клиента
+	 * @return Путь к файлу описи
+	 */
+	static QString InventoryPath(const QString &directory)
+	{
+		QByteArray key = PathKey(QDir(directory).absolutePath()).toUtf8();
+
+		return QDir::currentPath() + "/Inventory/" + CHashCalculator::HashData((const uchar *)key.constData(), key.size(), HA_CRC32) + ".xml";
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief LoadInventory Загрузить опись
+	 * @param path Путь к файлу описи
+	 * @return Записи описи по ключу пути
+	 */
+	static QHash<QString, CInventoryEntry> LoadInventory(const QString &path)
+	{
+		QHash<QString, CInventoryEntry> inventory;
+		QFile file(path);
+
+		if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+		{
+			QXmlStreamReader reader(&file);
+
+			while (!reader.atEnd() && !reader.hasError())
+			{
+				if (reader.isStartElement() && reader.name() == "file")
+				{
+					QXmlStreamAttributes attributes = reader.attributes();
+					CInventoryEntry entry;
+
+					entry.Path = attributes.value("path").toString();
+					entry.Size = attributes.value("size").toLongLong();
+					entry.Modified = attributes.value("modified").toLongLong();
+					entry.Hash = attributes.value("hash").toString();
+					entry.HashAlgo = attributes.value("hashalgo").toString();
+					entry.Version = attributes.value("fileversion").toString();
+
+					if (entry.Path.length())
+						inventory.insert(PathKey(entry.Path), entry);
+				}
+
+				reader.readNext();
+			}
+
+			file.close();
+		}
+
+		return inventory;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SaveInventory Сохранить опись
+	 * @param path Путь к файлу описи
+	 * @param entries Записи
+	 * @return true если опись записана
+	 */
+	static bool SaveInventory(const QString &path, const QVector<CInventoryEntry> &entries)
+	{
+		QDir().mkpath(QFileInfo(path).absolutePath());
+
+		QFile file(path);
+
+		if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+			return false;
+
+		QXmlStreamWriter writter(&file);
+
+		writter.setAutoFormatting(true);
+
+		writter.writeStartDocument();
+
+		writter.writeStartElement("inventory");
+		writter.writeAttribute("version", "0");
+		writter.writeAttribute("size", QString::number(entries.size()));
+
+		for (const CInventoryEntry &entry : entries)
+		{
+			writter.writeStartElement("file");
+
+			writter.writeAttribute("path", entry.Path);
+			writter.writeAttribute("size", QString::number(entry.Size));
+			writter.writeAttribute("modified", QString::number(entry.Modified));
+			writter.writeAttribute("hash", entry.Hash);
+			writter.writeAttribute("hashalgo", entry.HashAlgo);
+
+			if (entry.Version.length())
+				writter.writeAttribute("fileversion", entry.Version);
+
+			writter.writeEndElement(); // file
+		}
+
+		writter.writeEndElement(); // inventory
+
+		writter.writeEndDocument();
+
+		file.close();
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief BuildInventory Составить опись директории (обход и хэширование в пуле потоков)
+	 * Файл, размер и время изменения которого совпадают с прошлой описью, не хэшируется заново
+	 * @param directory Директория клиента
+	 * @param algorithms Алгоритм для отдельных файлов (ключ - PathKey), остальные - BLAKE3
+	 * @param withVersion Файлы, для которых нужна версия (ключ - PathKey)
+	 * @param previous Прошлая опись (ключ - PathKey)
+	 * @param operation Операция (после отмены оставшиеся файлы не хэшируются)
+	 * @return Записи описи (неполные, если операция прервана)
+	 */
+	static QVector<CInventoryEntry> BuildInventory(const QString &directory, const QHash<QString, QString> &algorithms, const QSet<QString> &withVersion, const QHash<QString, CInventoryEntry> &previous, const COperation &operation)
+	{
+		QVector<CInventoryEntry> entries;
+
+		for (const QString &path : ListFiles(directory, operation))
+		{
+			CInventoryEntry entry;
+			entry.Path = path;
+			entry.HashAlgo = algorithms.value(PathKey(path), "blake3");
+			entries.push_back(entry);
+		}
+
+		QDir root(directory);
+
+		QtConcurrent::blockingMap(entries, [&root, &withVersion, &previous, &operation](CInventoryEntry &entry)
+		{
+			if (operation.Stopped())
+				return;
+
+			QString path = root.filePath(entry.Path);
+			QFileInfo info(path);
+			QString key = PathKey(entry.Path);
+
+			entry.Size = info.size();
+			entry.Modified = info.lastModified().toMSecsSinceEpoch();
+
+			//! Файл не менялся со времени прошлой проверки - берем ее результат
+			auto old = previous.constFind(key);
+
+			if (old != previous.constEnd() && old->Size == entry.Size && old->Modified == entry.Modified && old->HashAlgo == entry.HashAlgo && old->Hash.length())
+				entry.Hash = old->Hash;
+			else
+			{
+				QFile file(path);
+
+				if (file.open(QIODevice::ReadOnly))
+				{
+					entry.Hash = CHashCalculator::HashFile(file, CHashCalculator::AlgorithmFromName(entry.HashAlgo), nullptr, &operation);
+					file.close();
+				}
+			}
+
+			if (withVersion.contains(key))
+				CPEVersionReader::ReadFileVersion(path, entry.Version);
+		});
+
+		return entries;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Verify Проверить установку
+	 * Файлы манифеста сверяются с манифестом, остальные - с описью прошлой проверки.
+	 * Контрольные суммы неизменившихся файлов (размер и время изменения) берутся из прошлой описи.
+	 * После проверки текущее состояние сохраняется как новая опись.
+	 * @param directory Директория клиента
+	 * @param manifest Список файлов из манифеста
+	 * @param testVersions Функция сравнения версий (true - нужно обновление)
+	 * @param operation Операция (между файлами и порциями файла проверяется Stopped)
+	 * @return Отчет (пустой, если операция прервана: опись при этом не сохраняется)
+	 */
+	static CVerifyReport Verify(const QString &directory, const QList<CUpdateInfo> &manifest, bool (*testVersions)(const QString &, const QString &), const COperation &operation = COperation())
+	{
+		CVerifyReport report;
+		report.Directory = directory;
+
+		QString inventoryPath = InventoryPath(directory);
+		QHash<QString, CInventoryEntry> previous = LoadInventory(inventoryPath);
+
+		//! В директории клиента лежат только файлы с uodir="yes"
+		QHash<QString, CUpdateInfo> expected;
+		QHash<QString, QString> algorithms;
+		QSet<QString> withVersion;
+
+		for (const CUpdateInfo &info : manifest)
+		{
+			if (info.UODir != "yes")
+				continue;
+
+			QString key = PathKey(info.Name);
+			expected.insert(key, info);
+			//! Если в манифесте есть контрольная сумма - считаем тем же алгоритмом, чтобы не хэшировать файл дважды
+			if (info.Hash.length())
+				algorithms.insert(key, CHashCalculator::AlgorithmName(CHashCalculator::AlgorithmFromName(info.HashAlgo)));
+
+			if (info.Version.length())
+				withVersion.insert(key);
+		}
+
+		QVector<CInventoryEntry> current = BuildInventory(directory, algorithms, withVersion, previous, operation);
+
+		//! Недосчитанные контрольные суммы выглядели бы как поврежденные файлы
+		if (operation.Stopped())
+			return report;
+
+		report.FilesCount = current.size();
+
+		QHash<QString, int> currentIndex;
+
+		for (int i = 0; i < current.size(); i++)
+			currentIndex.insert(PathKey(current[i].Path), i);
+
+		QSet<QString> brokenKeys;
+
+		//! Файлы манифеста
+		for (auto it = expected.constBegin(); it != expected.constEnd(); ++it)
+		{
+			const CUpdateInfo &info = it.value();
+			VERIFY_STATE state = VS_OK;
+
+			if (!currentIndex.contains(it.key()))
+				state = VS_MISSING;
+			else
+			{
+				const CInventoryEntry &entry = current[currentIndex.value(it.key())];
+
+				if (info.Version.length() && testVersions(entry.Version, info.Version))
+					state = VS_OUTDATED;
+				else if (info.Hash.length() && !CHashCalculator::Compare(info.Hash, entry.Hash))
+				{
+					state = VS_CORRUPT;
+
+					if (previous.contains(it.key()) && entry.Size < previous.value(it.key()).Size)
+						state = VS_TRUNCATED;
+				}
+			}
+
+			if (state != VS_OK)
+			{
+				report.Problems.push_back(CVerifyResult(info.Name, state, true));
+				report.RepairList.push_back(info);
+				brokenKeys.insert(it.key());
+			}
+		}
+
+		//! Остальные файлы сверяем с прошлой описью
+		for (const CInventoryEntry &entry : current)
+		{
+			QString key = PathKey(entry.Path);
+
+			if (expected.contains(key))
+				continue;
+
+			if (!previous.contains(key))
+			{
+				if (previous.size())
+					report.Problems.push_back(CVerifyResult(entry.Path, VS_EXTRA, false));
+
+				continue;
+			}
+
+			const CInventoryEntry &old = previous[key];
+
+			if (entry.Size < old.Size)
+				report.Problems.push_back(CVerifyResult(entry.Path, VS_TRUNCATED, false));
+			else if (entry.HashAlgo == old.HashAlgo && entry.Hash != old.Hash)
+				report.Problems.push_back(CVerifyResult(entry.Path, VS_MODIFIED, false));
+		}
+
+		for (auto it = previous.constBegin(); it != previous.constEnd(); ++it)
+		{
+			if (!expected.contains(it.key()) && !currentIndex.contains(it.key()))
+				report.Problems.push_back(CVerifyResult(it.value().Path, VS_MISSING, false));
+		}
+
+		//! Поврежденные файлы манифеста в опись не попадают, они будут скачаны заново
+		QVector<CInventoryEntry> inventory;
+
+		for (const CInventoryEntry &entry : current)
+		{
+			if (!brokenKeys.contains(PathKey(entry.Path)))
+				inventory.push_back(entry);
+		}
+
+		SaveInventory(inventoryPath, inventory);
+
+		return report;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // INSTALLVERIFIER_H
+//----------------------------------------------------------------------------------
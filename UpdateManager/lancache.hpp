@@ -0,0 +1,345 @@
+/**
+@file LanCache.hpp
+
+@brief Раздача хранилища пакетов другим лаунчерам локальной сети
+
+Лаунчер в режиме сервера отдает по HTTP проверенные файлы своего хранилища:
+@code
+GET /blob/file:blake3:<хэш>     распакованный файл (ключ CPackageCache::FileKey)
+@endcode
+Остальные лаунчеры берут адрес из настроек ("192.168.1.10:8090") или ищут сервер широковещательным
+UDP запросом "ORIONLAN?" на порт обнаружения; сервер отвечает "ORIONLAN <порт> <экземпляр>".
+Запрос отправляется и на 127.0.0.1, поэтому два экземпляра на одной машине находят друг друга.
+Получатель сверяет каждый файл с хэшем из манифеста сервера обновлений: доверять соседу не нужно.
+Архивы, патчи и резервные копии соседом не раздаются и загружаются с сервера обновлений.
+**/
+//----------------------------------------------------------------------------------
+#ifndef LANCACHE_H
+#define LANCACHE_H
+//----------------------------------------------------------------------------------
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHostAddress>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSharedPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QUdpSocket>
+#include <QUrl>
+#include "packagecache.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CLanCache class
+ * Адрес соседа-зеркала (настроенный или найденный)
+ */
+class CLanCache
+{
+public:
+	//! Порт сервера по умолчанию
+	enum { DEFAULT_PORT = 8090 };
+
+	//! Порт обнаружения (UDP)
+	enum { DISCOVERY_PORT = 8091 };
+
+private:
+	//! Время ожидания ответов на запрос обнаружения, мс
+	enum { DISCOVERY_TIMEOUT_MS = 500 };
+
+	//! Пауза перед повторным поиском, если сервер не найден или перестал отвечать, мс
+	enum { DISCOVERY_RETRY_MS = 5 * 60 * 1000 };
+
+	//----------------------------------------------------------------------------------
+	static QMutex &Mutex()
+	{
+		static QMutex mutex;
+		return mutex;
+	}
+
+	static QString &ConfiguredPeer()
+	{
+		static QString peer = "";
+		return peer;
+	}
+
+	static QString &FoundPeer()
+	{
+		static QString peer = "";
+		return peer;
+	}
+
+	static qint64 &NextDiscovery()
+	{
+		static qint64 time = 0;
+		return time;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Discover Найти сервер в локальной сети
+	 * @return Адрес ("192.168.1.10:8090", пусто - не найден)
+	 */
+	static QString Discover()
+	{
+		QUdpSocket socket;
+
+		if (!socket.bind(QHostAddress::AnyIPv4, 0))
+			return "";
+
+		QByteArray query = "ORIONLAN?";
+		QByteArray self = InstanceId().toLatin1();
+
+		socket.writeDatagram(query, QHostAddress::Broadcast, DISCOVERY_PORT);
+		socket.writeDatagram(query, QHostAddress::LocalHost, DISCOVERY_PORT);
+
+		QElapsedTimer timer;
+		timer.start();
+
+		while (timer.elapsed() < DISCOVERY_TIMEOUT_MS && socket.waitForReadyRead((int)(DISCOVERY_TIMEOUT_MS - timer.elapsed())))
+		{
+			while (socket.hasPendingDatagrams())
+			{
+				QByteArray data((int)qMax(socket.pendingDatagramSize(), (qint64)0), 0);
+				QHostAddress sender;
+
+				socket.readDatagram(data.data(), data.size(), &sender);
+
+				QList<QByteArray> fields = data.split(' ');
+
+				//! Собственный сервер отвечает тоже - его пропускаем
+				if (fields.size() == 3 && fields[0] == "ORIONLAN" && fields[1].toUShort() && fields[2] != self)
+					return QHostAddress(sender.toIPv4Address()).toString() + ":" + QString::fromLatin1(fields[1]);
+			}
+		}
+
+		return "";
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	//! Идентификатор экземпляра лаунчера (отличить свой сервер при обнаружении)
+	static QString InstanceId()
+	{
+		static QString id = QString::number(QCoreApplication::applicationPid()) + "-" + QString::number(QDateTime::currentMSecsSinceEpoch());
+		return id;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SetPeer Задать адрес сервера вручную
+	 * @param address Адрес ("192.168.1.10:8090", пусто - искать в сети)
+	 */
+	static void SetPeer(const QString &address)
+	{
+		QMutexLocker locker(&Mutex());
+
+		ConfiguredPeer() = address.trimmed();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Peer Адрес соседа-зеркала. Первый вызов без настроенного адреса ищет сервер в сети.
+	 * @return Адрес (пусто - зеркала нет)
+	 */
+	static QString Peer()
+	{
+		QMutexLocker locker(&Mutex());
+
+		qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+		if (ConfiguredPeer().length())
+			return (now >= NextDiscovery() ? ConfiguredPeer() : QString());
+
+		if (!FoundPeer().length() && now >= NextDiscovery())
+		{
+			//! Поиск под блокировкой: параллельные загрузки дождутся его результата, а не начнут свой
+			FoundPeer() = Discover();
+			NextDiscovery() = now + DISCOVERY_RETRY_MS;
+		}
+
+		return FoundPeer();
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Сосед не отвечает - не обращаться к нему до следующего поиска
+	static void Forget()
+	{
+		QMutexLocker locker(&Mutex());
+
+		//! Настроенный адрес не забывается, но и не опрашивается до истечения паузы
+		FoundPeer() = "";
+		NextDiscovery() = QDateTime::currentMSecsSinceEpoch() + DISCOVERY_RETRY_MS;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CLanCacheServer class
+ * HTTP сервер хранилища пакетов и ответчик обнаружения в отдельном потоке со своим циклом событий
+ */
+class CLanCacheServer : public QThread
+{
+private:
+	//! Максимальный размер заголовка запроса, байт
+	enum { MAX_REQUEST_SIZE = 8 * 1024 };
+
+	//! Размер блока чтения файла, байт
+	enum { CHUNK_SIZE = 64 * 1024 };
+
+	//! Сколько держать в буфере отправки: файл читается по мере ухода данных в сеть, байт
+	enum { SEND_BUFFER_SIZE = 4 * CHUNK_SIZE };
+
+	/**
+	 * @brief The CConnection class
+	 * Состояние одного соединения
+	 */
+	class CConnection
+	{
+	public:
+		QByteArray Request;
+		QFile File;
+		bool Answered{ false };
+	};
+
+	//! Порт сервера
+	quint16 m_Port{ CLanCache::DEFAULT_PORT };
+
+	//----------------------------------------------------------------------------------
+	//! Отправить следующую часть файла, после последней - закрыть соединение
+	static void Pump(QTcpSocket *socket, CConnection &connection)
+	{
+		if (socket->state() != QAbstractSocket::ConnectedState)
+			return;
+
+		while (connection.File.isOpen() && !connection.File.atEnd() && socket->bytesToWrite() < SEND_BUFFER_SIZE)
+			socket->write(connection.File.read(CHUNK_SIZE));
+
+		if ((!connection.File.isOpen() || connection.File.atEnd()) && !socket->bytesToWrite())
+			socket->disconnectFromHost();
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Разобрать запрос и начать ответ
+	static void Answer(QTcpSocket *socket, CConnection &connection)
+	{
+		QList<QByteArray> line = connection.Request.left(connection.Request.indexOf("\r\n")).split(' ');
+		bool found = false;
+
+		if (line.size() >= 2 && line[0] == "GET")
+		{
+			QString target = QUrl::fromPercentEncoding(line[1]);
+
+			if (target.startsWith("/blob/file:"))
+			{
+				//! Раздаются только распакованные файлы: их можно проверить по манифесту до использования
+				QString objectPath = CPackageCache::Instance().Locate(target.mid(6));
+
+				if (objectPath.length())
+				{
+					connection.File.setFileName(objectPath);
+					found = connection.File.open(QIODevice::ReadOnly);
+				}
+			}
+		}
+
+		QByteArray header = (found ? "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\n" : "HTTP/1.1 404 Not Found\r\n");
+		header += "Content-Length: " + QByteArray::number(found ? connection.File.size() : 0) + "\r\nConnection: close\r\n\r\n";
+
+		socket->write(header);
+
+		Pump(socket, connection);
+	}
+
+	//----------------------------------------------------------------------------------
+	static void Serve(QTcpSocket *socket)
+	{
+		QSharedPointer<CConnection> connection(new CConnection());
+
+		QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket, connection]()
+		{
+			QByteArray data = socket->readAll();
+
+			if (connection->Answered)
+				return;
+
+			connection->Request.append(data);
+
+			if (connection->Request.contains("\r\n\r\n"))
+			{
+				connection->Answered = true;
+				Answer(socket, *connection);
+			}
+			else if (connection->Request.size() > MAX_REQUEST_SIZE)
+				socket->abort();
+		});
+
+		QObject::connect(socket, &QTcpSocket::bytesWritten, socket, [socket, connection]()
+		{
+			if (connection->Answered)
+				Pump(socket, *connection);
+		});
+
+		QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+	}
+
+protected:
+	//----------------------------------------------------------------------------------
+	void run() override
+	{
+		QTcpServer server;
+
+		//! Порт занят - сервер не работает, соседи берут файлы с сервера обновлений
+		if (!server.listen(QHostAddress::Any, m_Port))
+			return;
+
+		QUdpSocket discovery;
+		QByteArray reply = "ORIONLAN " + QByteArray::number(m_Port) + " " + CLanCache::InstanceId().toLatin1();
+
+		//! Без обнаружения (порт занят) сервер доступен по настроенному адресу
+		discovery.bind(QHostAddress::AnyIPv4, CLanCache::DISCOVERY_PORT, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint);
+
+		QObject::connect(&discovery, &QUdpSocket::readyRead, &discovery, [&discovery, reply]()
+		{
+			while (discovery.hasPendingDatagrams())
+			{
+				QByteArray data((int)qMax(discovery.pendingDatagramSize(), (qint64)0), 0);
+				QHostAddress sender;
+				quint16 senderPort = 0;
+
+				discovery.readDatagram(data.data(), data.size(), &sender, &senderPort);
+
+				if (data == "ORIONLAN?")
+					discovery.writeDatagram(reply, sender, senderPort);
+			}
+		});
+
+		QObject::connect(&server, &QTcpServer::newConnection, &server, [&server]()
+		{
+			while (server.hasPendingConnections())
+				Serve(server.nextPendingConnection());
+		});
+
+		exec();
+	}
+
+public:
+	CLanCacheServer(const quint16 &port) : QThread(), m_Port(port) {}
+
+	~CLanCacheServer()
+	{
+		Stop();
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Остановить сервер (закрывает соединения)
+	void Stop()
+	{
+		quit();
+		wait();
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // LANCACHE_H
+//----------------------------------------------------------------------------------
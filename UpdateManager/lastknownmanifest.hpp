@@ -0,0 +1,157 @@
+/**
+@file LastKnownManifest.hpp
+
+@brief Последний успешно полученный результат проверки обновлений (для показа до ответа сервера)
+
+Хранится в формате манифеста сервера и читается тем же разборщиком:
+@code
+<lastknown version="0">
+	<meta name="OrionUO.exe" version="..." hash="..." hashalgo="blake3" filename="orion.zip" zipsize="..." uodir="yes"/>
+	<meta backup="1.0.5.2" filename="backup_1052.zip"/>
+</lastknown>
+@endcode
+**/
+//----------------------------------------------------------------------------------
+#ifndef LASTKNOWNMANIFEST_H
+#define LASTKNOWNMANIFEST_H
+//----------------------------------------------------------------------------------
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QXmlStreamWriter>
+#include "updateinfo.hpp"
+#include "manifestparser.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CLastKnownManifest class
+ * Устаревшие файлы и резервные версии из последней проверки, дошедшей до сервера
+ */
+class CLastKnownManifest
+{
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SnapshotPath Путь к файлу для директории клиента
+	 * @param inventoryPath Путь к файлу описи этой директории
+	 * @return Путь
+	 */
+	static QString SnapshotPath(const QString &inventoryPath)
+	{
+		QString path = inventoryPath;
+
+		if (path.endsWith(".xml"))
+			path.chop(4);
+
+		return path + ".last.xml";
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Load Загрузить сохраненный результат
+	 * @param path Путь к файлу
+	 * @param manifest Манифест
+	 * @return true если файл прочитан
+	 */
+	static bool Load(const QString &path, CCompactManifest &manifest)
+	{
+		QFile file(path);
+
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		CManifestParser parser;
+		parser.AddData(file.readAll());
+		parser.Finish();
+
+		file.close();
+
+		manifest = parser.Manifest();
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Save Сохранить результат проверки
+	 * @param path Путь к файлу
+	 * @param updateList Устаревшие файлы
+	 * @param backupsList Резервные версии
+	 */
+	static void Save(const QString &path, const QList<CUpdateInfo> &updateList, const QList<CBackupInfo> &backupsList)
+	{
+		QDir().mkpath(QFileInfo(path).absolutePath());
+
+		QFile file(path);
+
+		if (file.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			QXmlStreamWriter writter(&file);
+
+			writter.setAutoFormatting(true);
+
+			writter.writeStartDocument();
+
+			writter.writeStartElement("lastknown");
+			writter.writeAttribute("version", "0");
+
+			for (const CUpdateInfo &info : updateList)
+			{
+				writter.writeStartElement("meta");
+
+				writter.writeAttribute("name", info.Name);
+				writter.writeAttribute("version", info.Version);
+				writter.writeAttribute("hash", info.Hash);
+				writter.writeAttribute("hashalgo", info.HashAlgo);
+				writter.writeAttribute("filename", info.ZipFileName);
+
+				if (info.ZipSize >= 0)
+					writter.writeAttribute("zipsize", QString::number(info.ZipSize));
+
+				writter.writeAttribute("updatenotes", info.Notes);
+				writter.writeAttribute("uodir", info.UODir);
+
+				if (info.BlockMapFileName.length())
+				{
+					writter.writeAttribute("blockmap", info.BlockMapFileName);
+					writter.writeAttribute("rawfile", info.RawFileName);
+				}
+
+				writter.writeEndElement(); // meta
+
+				for (const CPatchInfo &patch : info.Patches)
+				{
+					writter.writeStartElement("patch");
+
+					writter.writeAttribute("name", info.Name);
+					writter.writeAttribute("fromhash", patch.FromHash);
+					writter.writeAttribute("fromversion", patch.FromVersion);
+					writter.writeAttribute("filename", patch.FileName);
+
+					if (patch.Size >= 0)
+						writter.writeAttribute("size", QString::number(patch.Size));
+
+					writter.writeEndElement(); // patch
+				}
+			}
+
+			for (const CBackupInfo &backup : backupsList)
+			{
+				writter.writeStartElement("meta");
+
+				writter.writeAttribute("backup", backup.Name);
+				writter.writeAttribute("filename", backup.ZipFileName);
+
+				writter.writeEndElement(); // meta
+			}
+
+			writter.writeEndElement(); // lastknown
+
+			writter.writeEndDocument();
+
+			file.close();
+		}
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // LASTKNOWNMANIFEST_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,105 @@
+/**
+@file ManifestCache.hpp
+
+@brief Кэш разобранных манифестов в памяти процесса
+**/
+//----------------------------------------------------------------------------------
+#ifndef MANIFESTCACHE_H
+#define MANIFESTCACHE_H
+//----------------------------------------------------------------------------------
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CManifestCache class
+ * Последние полученные значения по ключу (host + path + page) со временем получения.
+ * Один экземпляр на тип значения, доступ из любых потоков.
+ */
+template<typename V>
+class CManifestCache
+{
+private:
+	/**
+	 * @brief The CItem class
+	 * Значение и время его получения
+	 */
+	class CItem
+	{
+	public:
+		//! Время получения, мс от начала эпохи
+		qint64 Time{ 0 };
+
+		//! Значение
+		V Value;
+	};
+
+	//! Значения по ключу
+	QHash<QString, CItem> m_Items;
+
+	//! Защита m_Items
+	QMutex m_Mutex;
+
+	CManifestCache() {}
+
+public:
+	~CManifestCache() {}
+
+	//----------------------------------------------------------------------------------
+	static CManifestCache<V> &Instance()
+	{
+		static CManifestCache<V> cache;
+
+		return cache;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Get Получить значение, если оно не старше maxAgeMs
+	 * @param key Ключ
+	 * @param value Значение
+	 * @param maxAgeMs Окно свежести, мс (-1 - возраст не важен)
+	 * @return true если значение найдено
+	 */
+	bool Get(const QString &key, V &value, const qint64 &maxAgeMs)
+	{
+		QMutexLocker locker(&m_Mutex);
+
+		auto it = m_Items.constFind(key);
+
+		if (it == m_Items.constEnd())
+			return false;
+
+		if (maxAgeMs >= 0 && QDateTime::currentMSecsSinceEpoch() - it.value().Time > maxAgeMs)
+			return false;
+
+		value = it.value().Value;
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	void Put(const QString &key, const V &value)
+	{
+		QMutexLocker locker(&m_Mutex);
+
+		CItem item;
+		item.Time = QDateTime::currentMSecsSinceEpoch();
+		item.Value = value;
+
+		m_Items.insert(key, item);
+	}
+
+	//----------------------------------------------------------------------------------
+	void Clear()
+	{
+		QMutexLocker locker(&m_Mutex);
+
+		m_Items.clear();
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // MANIFESTCACHE_H
+//----------------------------------------------------------------------------------
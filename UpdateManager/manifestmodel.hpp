@@ -0,0 +1,568 @@
+/**
+@file ManifestModel.hpp
+
+@brief Компактное представление манифеста обновлений
+**/
+//----------------------------------------------------------------------------------
+#ifndef MANIFESTMODEL_H
+#define MANIFESTMODEL_H
+//----------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <algorithm>
+#include <string.h>
+#include "updateinfo.hpp"
+#include "hashcalculator.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CVersionKey class
+ * Версия "a.b.c.d", упакованная в 64 бита (по 16 бит на часть).
+ * Недостающие части считаются нулями, поэтому "1.2" == "1.2.0.0" и "1.2" < "1.2.1".
+ */
+class CVersionKey
+{
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Pack Упаковать версию
+	 * @param version Версия в виде строки
+	 * @return Ключ, сравнимый обычными операторами
+	 */
+	static quint64 Pack(const QString &version)
+	{
+		quint64 key = 0;
+		quint64 value = 0;
+		int part = 0;
+		bool digits = true;
+
+		for (const QChar &c : version)
+		{
+			if (c == QLatin1Char('.'))
+			{
+				key |= (value << (48 - part * 16));
+				value = 0;
+				digits = true;
+
+				if (++part == 4)
+					return key;
+			}
+			else if (digits && c >= QLatin1Char('0') && c <= QLatin1Char('9'))
+				value = qMin(value * 10 + (quint64)(c.unicode() - '0'), (quint64)0xFFFF);
+			else
+			{
+				//! Как и QString::toInt, часть с посторонними символами считаем нулем
+				value = 0;
+				digits = false;
+			}
+		}
+
+		return key | (value << (48 - part * 16));
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CHashKey class
+ * Контрольная сумма в двоичном виде (до 256 бит), сравнение - 4 целых числа
+ */
+class CHashKey
+{
+private:
+	//! Значение, старшие байты первыми
+	quint64 m_Words[4];
+
+	//! Длина в байтах (0 - контрольная сумма не указана или не упаковывается)
+	quint8 m_Length{ 0 };
+
+	//! Запись, которую нельзя упаковать (не шестнадцатеричная или длиннее 32 байт), хранится как есть
+	QString m_Text;
+
+	static int HexValue(const ushort &c)
+	{
+		if (c >= '0' && c <= '9')
+			return c - '0';
+		else if (c >= 'a' && c <= 'f')
+			return c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			return c - 'A' + 10;
+
+		return -1;
+	}
+
+public:
+	CHashKey()
+	{
+		memset(m_Words, 0, sizeof(m_Words));
+	}
+
+	bool IsEmpty() const { return (!m_Length && m_Text.isEmpty()); }
+
+	bool operator==(const CHashKey &other) const
+	{
+		return (m_Length == other.m_Length && m_Words[0] == other.m_Words[0] && m_Words[1] == other.m_Words[1] &&
+			m_Words[2] == other.m_Words[2] && m_Words[3] == other.m_Words[3] && m_Text == other.m_Text);
+	}
+
+	bool operator!=(const CHashKey &other) const { return !(*this == other); }
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FromHex Разбор шестнадцатеричной записи (регистр не важен)
+	 * @param hex Запись
+	 * @return Ключ, пустой только если запись пуста. Некорректная запись сохраняется как есть
+	 * и не равна ни одной корректной: файл с такой контрольной суммой считается измененным.
+	 */
+	static CHashKey FromHex(const QString &hex)
+	{
+		CHashKey key;
+		QString value = hex.trimmed();
+		int length = value.length();
+
+		if (!length)
+			return key;
+
+		//! Незначащий ноль слева мог быть опущен при записи манифеста
+		if (length & 1)
+		{
+			value.prepend(QLatin1Char('0'));
+			length++;
+		}
+
+		if (length > 64)
+		{
+			key.m_Text = hex.trimmed();
+			return key;
+		}
+
+		for (int i = 0; i < length; i++)
+		{
+			int nibble = HexValue(value.at(i).unicode());
+
+			if (nibble < 0)
+			{
+				key = CHashKey();
+				key.m_Text = hex.trimmed();
+				return key;
+			}
+
+			key.m_Words[i / 16] |= ((quint64)nibble << (60 - (i % 16) * 4));
+		}
+
+		key.m_Length = (quint8)(length / 2);
+
+		return key;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ToHex Запись в том виде, в котором ее выдает CHashCalculator
+	 * @param upper Верхний регистр (CRC32)
+	 * @return Запись
+	 */
+	QString ToHex(const bool &upper) const
+	{
+		if (!m_Text.isEmpty())
+			return m_Text;
+
+		static const char lowerDigits[] = "0123456789abcdef";
+		static const char upperDigits[] = "0123456789ABCDEF";
+		const char *digits = (upper ? upperDigits : lowerDigits);
+
+		QString result(m_Length * 2, QLatin1Char('0'));
+
+		for (int i = 0; i < m_Length * 2; i++)
+			result[i] = QLatin1Char(digits[(m_Words[i / 16] >> (60 - (i % 16) * 4)) & 0xF]);
+
+		return result;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CArenaString class
+ * Ссылка на строку в CStringArena
+ */
+class CArenaString
+{
+public:
+	//! Смещение в арене
+	quint32 Offset{ 0 };
+
+	//! Длина в байтах UTF-8
+	quint32 Length{ 0 };
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CStringArena class
+ * Все строки манифеста в одном буфере UTF-8, повторяющиеся значения хранятся один раз
+ */
+class CStringArena
+{
+private:
+	//! Буфер строк
+	QByteArray m_Data;
+
+	//! Уже добавленные строки (только на время заполнения)
+	QHash<QByteArray, CArenaString> m_Index;
+
+public:
+	CStringArena() {}
+	~CStringArena() {}
+
+	//----------------------------------------------------------------------------------
+	CArenaString Add(const QString &value)
+	{
+		CArenaString result;
+
+		if (value.isEmpty())
+			return result;
+
+		QByteArray utf8 = value.toUtf8();
+		auto it = m_Index.constFind(utf8);
+
+		if (it != m_Index.constEnd())
+			return it.value();
+
+		result.Offset = (quint32)m_Data.size();
+		result.Length = (quint32)utf8.size();
+
+		m_Data.append(utf8);
+		m_Index.insert(utf8, result);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	QString Get(const CArenaString &value) const
+	{
+		if (!value.Length)
+			return QString("");
+
+		return QString::fromUtf8(m_Data.constData() + value.Offset, (int)value.Length);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Compare Сравнение строки из арены с байтами UTF-8 (без выделения памяти)
+	 * @return <0, 0, >0 как у memcmp
+	 */
+	int Compare(const CArenaString &value, const char *data, const int &length) const
+	{
+		int result = memcmp(m_Data.constData() + value.Offset, data, qMin((int)value.Length, length));
+
+		if (!result)
+			result = (int)value.Length - length;
+
+		return result;
+	}
+
+	int Compare(const CArenaString &left, const CArenaString &right) const
+	{
+		return Compare(left, m_Data.constData() + right.Offset, (int)right.Length);
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Освободить индекс повторов и лишнюю емкость после заполнения
+	void Squeeze()
+	{
+		m_Index = QHash<QByteArray, CArenaString>();
+		m_Data.squeeze();
+	}
+
+	int Size() const { return m_Data.size(); }
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CManifestEntry class
+ * Запись о файле в компактном манифесте
+ */
+class CManifestEntry
+{
+public:
+	//! Упакованная версия (CVersionKey)
+	quint64 Version{ 0 };
+
+	//! Размер архива (-1 - не указан)
+	qint64 ZipSize{ -1 };
+
+	//! Контрольная сумма
+	CHashKey Hash;
+
+	//! Название файла
+	CArenaString Name;
+
+	//! Версия в исходном виде (для отображения)
+	CArenaString VersionText;
+
+	//! Название архива
+	CArenaString ZipFileName;
+
+	//! Примечание
+	CArenaString Notes;
+
+	//! Карта блоков
+	CArenaString BlockMapFileName;
+
+	//! Несжатый файл
+	CArenaString RawFileName;
+
+	//! Алгоритм контрольной суммы (HASH_ALGORITHM)
+	quint8 HashAlgo{ HA_CRC32 };
+
+	//! Версия указана в манифесте
+	bool HasVersion{ false };
+
+	//! Файл в директории клиента (uodir="yes")
+	bool UODir{ false };
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CManifestBackup class
+ * Запись о резервной версии в компактном манифесте
+ */
+class CManifestBackup
+{
+public:
+	//! Название
+	CArenaString Name;
+
+	//! Название архива
+	CArenaString ZipFileName;
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CManifestPatch class
+ * Запись о бинарном патче в компактном манифесте
+ */
+class CManifestPatch
+{
+public:
+	//! Размер патча (-1 - не указан)
+	qint64 Size{ -1 };
+
+	//! Название файла, к которому применяется патч
+	CArenaString Name;
+
+	//! Контрольная сумма исходного файла
+	CArenaString FromHash;
+
+	//! Версия исходного файла
+	CArenaString FromVersion;
+
+	//! Название патча
+	CArenaString FileName;
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CCompactManifest class
+ * Манифест: непрерывный массив записей + арена строк + индекс по имени
+ */
+class CCompactManifest
+{
+private:
+	//! Строки
+	CStringArena m_Arena;
+
+	//! Файлы в порядке следования в манифесте
+	QVector<CManifestEntry> m_Entries;
+
+	//! Резервные версии
+	QVector<CManifestBackup> m_Backups;
+
+	//! Патчи (обычно единицы, привязываются к файлу по имени при развороте записи)
+	QVector<CManifestPatch> m_Patches;
+
+	//! Индексы записей, отсортированные по имени (строится в Finish)
+	QVector<int> m_ByName;
+
+public:
+	CCompactManifest() {}
+	~CCompactManifest() {}
+
+	int Size() const { return m_Entries.size(); }
+
+	int BackupsCount() const { return m_Backups.size(); }
+
+	const CManifestEntry &Entry(const int &index) const { return m_Entries[index]; }
+
+	QString String(const CArenaString &value) const { return m_Arena.Get(value); }
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Add Добавить файл
+	 * @param info Информация о файле
+	 */
+	void Add(const CUpdateInfo &info)
+	{
+		CManifestEntry entry;
+
+		entry.Name = m_Arena.Add(info.Name);
+		entry.VersionText = m_Arena.Add(info.Version);
+		entry.ZipFileName = m_Arena.Add(info.ZipFileName);
+		entry.ZipSize = info.ZipSize;
+		entry.Notes = m_Arena.Add(info.Notes);
+		entry.BlockMapFileName = m_Arena.Add(info.BlockMapFileName);
+		entry.RawFileName = m_Arena.Add(info.RawFileName);
+		entry.HasVersion = !info.Version.isEmpty();
+		entry.Version = CVersionKey::Pack(info.Version);
+		entry.HashAlgo = (quint8)CHashCalculator::AlgorithmFromName(info.HashAlgo);
+		entry.Hash = CHashKey::FromHex(info.Hash);
+		entry.UODir = (info.UODir == "yes");
+
+		m_Entries.push_back(entry);
+		m_ByName.clear();
+	}
+
+	//----------------------------------------------------------------------------------
+	void AddBackup(const CBackupInfo &info)
+	{
+		CManifestBackup backup;
+
+		backup.Name = m_Arena.Add(info.Name);
+		backup.ZipFileName = m_Arena.Add(info.ZipFileName);
+
+		m_Backups.push_back(backup);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief AddPatch Добавить патч
+	 * @param name Название файла, к которому применяется патч
+	 * @param info Информация о патче
+	 */
+	void AddPatch(const QString &name, const CPatchInfo &info)
+	{
+		CManifestPatch patch;
+
+		patch.Size = info.Size;
+		patch.Name = m_Arena.Add(name);
+		patch.FromHash = m_Arena.Add(info.FromHash);
+		patch.FromVersion = m_Arena.Add(info.FromVersion);
+		patch.FileName = m_Arena.Add(info.FileName);
+
+		m_Patches.push_back(patch);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Finish Завершить заполнение: построить индекс по имени и освободить лишнюю память
+	 */
+	void Finish()
+	{
+		m_Entries.squeeze();
+		m_Backups.squeeze();
+		m_Patches.squeeze();
+		m_Arena.Squeeze();
+
+		m_ByName.resize(m_Entries.size());
+
+		for (int i = 0; i < m_ByName.size(); i++)
+			m_ByName[i] = i;
+
+		const CStringArena &arena = m_Arena;
+		const QVector<CManifestEntry> &entries = m_Entries;
+
+		std::stable_sort(m_ByName.begin(), m_ByName.end(), [&arena, &entries](const int &left, const int &right)
+		{
+			return (arena.Compare(entries[left].Name, entries[right].Name) < 0);
+		});
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Find Поиск файла по имени
+	 * @param name Название файла
+	 * @return Индекс записи или -1
+	 */
+	int Find(const QString &name) const
+	{
+		QByteArray utf8 = name.toUtf8();
+
+		if (m_ByName.size() != m_Entries.size())
+		{
+			for (int i = 0; i < m_Entries.size(); i++)
+			{
+				if (!m_Arena.Compare(m_Entries[i].Name, utf8.constData(), utf8.size()))
+					return i;
+			}
+
+			return -1;
+		}
+
+		auto it = std::lower_bound(m_ByName.begin(), m_ByName.end(), utf8, [this](const int &index, const QByteArray &value)
+		{
+			return (m_Arena.Compare(m_Entries[index].Name, value.constData(), value.size()) < 0);
+		});
+
+		if (it != m_ByName.end() && !m_Arena.Compare(m_Entries[*it].Name, utf8.constData(), utf8.size()))
+			return *it;
+
+		return -1;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Info Развернуть запись в CUpdateInfo (для списков интерфейса и сигналов)
+	 * @param index Индекс записи
+	 * @return Информация о файле
+	 */
+	CUpdateInfo Info(const int &index) const
+	{
+		const CManifestEntry &entry = m_Entries[index];
+		HASH_ALGORITHM algorithm = (HASH_ALGORITHM)entry.HashAlgo;
+		CUpdateInfo info;
+
+		info.Name = m_Arena.Get(entry.Name);
+		info.Version = m_Arena.Get(entry.VersionText);
+		info.ZipFileName = m_Arena.Get(entry.ZipFileName);
+		info.ZipSize = entry.ZipSize;
+		info.Notes = m_Arena.Get(entry.Notes);
+		info.BlockMapFileName = m_Arena.Get(entry.BlockMapFileName);
+		info.RawFileName = m_Arena.Get(entry.RawFileName);
+		info.Hash = entry.Hash.ToHex(algorithm == HA_CRC32);
+		info.HashAlgo = (algorithm == HA_CRC32 ? "" : CHashCalculator::AlgorithmName(algorithm));
+		info.UODir = (entry.UODir ? "yes" : "");
+
+		for (const CManifestPatch &patch : m_Patches)
+		{
+			if (m_Arena.Compare(patch.Name, entry.Name))
+				continue;
+
+			CPatchInfo patchInfo;
+			patchInfo.FromHash = m_Arena.Get(patch.FromHash);
+			patchInfo.FromVersion = m_Arena.Get(patch.FromVersion);
+			patchInfo.FileName = m_Arena.Get(patch.FileName);
+			patchInfo.Size = patch.Size;
+
+			info.Patches.push_back(patchInfo);
+		}
+
+		return info;
+	}
+
+	//----------------------------------------------------------------------------------
+	CBackupInfo Backup(const int &index) const
+	{
+		const CManifestBackup &backup = m_Backups[index];
+		CBackupInfo info;
+
+		info.Name = m_Arena.Get(backup.Name);
+		info.ZipFileName = m_Arena.Get(backup.ZipFileName);
+
+		return info;
+	}
+
+	//----------------------------------------------------------------------------------
+	QList<CBackupInfo> Backups() const
+	{
+		QList<CBackupInfo> list;
+
+		for (int i = 0; i < m_Backups.size(); i++)
+			list.push_back(Backup(i));
+
+		return list;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // MANIFESTMODEL_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,141 @@
+/**
+@file ManifestParser.hpp
+
+@brief Потоковый разбор манифеста обновлений по мере получения данных
+**/
+//----------------------------------------------------------------------------------
+#ifndef MANIFESTPARSER_H
+#define MANIFESTPARSER_H
+//----------------------------------------------------------------------------------
+#include <QByteArray>
+#include <QXmlStreamReader>
+#include "manifestmodel.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CManifestParser class
+ * Принимает порции UTF-8 данных (QXmlStreamReader::addData) и разбирает все
+ * полностью полученные теги <meta> и <patch>. Имена тегов и атрибутов сравниваются без выделения памяти.
+ */
+class CManifestParser
+{
+private:
+	//! Читатель XML
+	QXmlStreamReader m_Reader;
+
+	//! Разобранные файлы и резервные версии
+	CCompactManifest m_Manifest;
+
+	//! Документ разобран до конца
+	bool m_Finished{ false };
+
+	//----------------------------------------------------------------------------------
+	static QString Value(const QXmlStreamAttributes &attributes, const char *name)
+	{
+		return attributes.value(QLatin1String(name)).toString();
+	}
+
+	//----------------------------------------------------------------------------------
+	void ReadMeta()
+	{
+		QXmlStreamAttributes attributes = m_Reader.attributes();
+
+		if (attributes.hasAttribute(QLatin1String("name")))
+		{
+			CUpdateInfo info;
+			info.Name = Value(attributes, "name");
+
+			//! Добавляем только если есть имя
+			if (info.Name.length())
+			{
+				info.Version = Value(attributes, "version");
+				info.Hash = Value(attributes, "hash");
+				info.HashAlgo = Value(attributes, "hashalgo");
+				info.ZipFileName = Value(attributes, "filename");
+				info.ZipSize = (attributes.hasAttribute(QLatin1String("zipsize")) ? attributes.value(QLatin1String("zipsize")).toLongLong() : -1);
+				info.Notes = Value(attributes, "updatenotes");
+				info.BlockMapFileName = Value(attributes, "blockmap");
+				info.RawFileName = Value(attributes, "rawfile");
+				info.UODir = Value(attributes, "uodir");
+
+				m_Manifest.Add(info);
+
+				return;
+			}
+		}
+
+		CBackupInfo backup;
+		backup.Name = Value(attributes, "backup");
+
+		if (backup.Name.length())
+		{
+			backup.ZipFileName = Value(attributes, "filename");
+			m_Manifest.AddBackup(backup);
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	void ReadPatch()
+	{
+		QXmlStreamAttributes attributes = m_Reader.attributes();
+
+		QString name = Value(attributes, "name");
+		CPatchInfo patch;
+		patch.FileName = Value(attributes, "filename");
+
+		if (!name.length() || !patch.FileName.length())
+			return;
+
+		patch.FromHash = Value(attributes, "fromhash");
+		patch.FromVersion = Value(attributes, "fromversion");
+		patch.Size = (attributes.hasAttribute(QLatin1String("size")) ? attributes.value(QLatin1String("size")).toLongLong() : -1);
+
+		m_Manifest.AddPatch(name, patch);
+	}
+
+public:
+	CManifestParser() {}
+	~CManifestParser() {}
+
+	//! Разобранный манифест
+	const CCompactManifest &Manifest() const { return m_Manifest; }
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Finish Завершить разбор (построить индекс по имени, освободить лишнюю память)
+	 */
+	void Finish()
+	{
+		m_Manifest.Finish();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief AddData Добавить порцию данных и разобрать все полностью полученные теги
+	 * @param data Данные
+	 */
+	void AddData(const QByteArray &data)
+	{
+		if (m_Finished)
+			return;
+
+		m_Reader.addData(data);
+
+		//! При нехватке данных readNext возвращает Invalid (PrematureEndOfDocumentError),
+		//! после следующего addData разбор продолжается с того же места
+		for (QXmlStreamReader::TokenType token = m_Reader.readNext(); token != QXmlStreamReader::Invalid; token = m_Reader.readNext())
+		{
+			if (token == QXmlStreamReader::StartElement && !m_Reader.name().compare(QLatin1String("meta"), Qt::CaseInsensitive))
+				ReadMeta();
+			else if (token == QXmlStreamReader::StartElement && !m_Reader.name().compare(QLatin1String("patch"), Qt::CaseInsensitive))
+				ReadPatch();
+			else if (token == QXmlStreamReader::EndDocument)
+			{
+				m_Finished = true;
+				break;
+			}
+		}
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // MANIFESTPARSER_H
+//----------------------------------------------------------------------------------
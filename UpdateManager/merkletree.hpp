@@ -0,0 +1,451 @@
+/**
+@file MerkleTree.hpp
+
+@brief Иерархический манифест обновлений (дерево хэшей директорий)
+
+Формат узла (корень - OrionUpdateTree.xml, остальные узлы - файлы, указанные в manifest):
+@code
+<node path="Data" hash="...">
+	<meta name="Data/art.mul" hash="..." hashalgo="blake3" version="..." filename="art.zip" uodir="yes"/>
+	<patch name="Data/art.mul" fromhash="..." filename="art_1052.patch" size="..."/>
+	<dir path="Data/Maps" hash="..." manifest="tree/data_maps.xml"/>
+</node>
+@endcode
+Хэш узла - BLAKE3 от отсортированных по имени строк "f <name> <hashalgo> <hash> <version>\n"
+для файлов и "d <path> <hash>\n" для поддиректорий. Хэш корня идентифицирует релиз.
+**/
+//----------------------------------------------------------------------------------
+#ifndef MERKLETREE_H
+#define MERKLETREE_H
+//----------------------------------------------------------------------------------
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QPair>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include "updateinfo.hpp"
+#include "hashcalculator.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CMerkleDirInfo class
+ * Ссылка на дочерний узел дерева
+ */
+class CMerkleDirInfo
+{
+public:
+	CMerkleDirInfo() {}
+	~CMerkleDirInfo() {}
+
+	//! Путь директории
+	QString Path{ "" };
+
+	//! Хэш поддерева
+	QString Hash{ "" };
+
+	//! Название файла узла на сервере
+	QString Manifest{ "" };
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CMerkleNode class
+ * Узел дерева манифеста
+ */
+class CMerkleNode
+{
+public:
+	CMerkleNode() {}
+	~CMerkleNode() {}
+
+	//! Путь директории ("" - корень)
+	QString Path{ "" };
+
+	//! Заявленный хэш узла
+	QString Hash{ "" };
+
+	//! Файлы директории
+	QList<CUpdateInfo> Files;
+
+	//! Поддиректории
+	QList<CMerkleDirInfo> Dirs;
+
+	//! Резервные версии (только в корне)
+	QList<CBackupInfo> Backups;
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Parse Разбор XML узла
+	 * @param data Данные
+	 * @param node Узел
+	 * @return true если это корректный узел дерева
+	 */
+	static bool Parse(const QByteArray &data, CMerkleNode &node)
+	{
+		bool found = false;
+		QXmlStreamReader reader(data);
+		QList<QPair<QString, CPatchInfo>> patches;
+
+		while (!reader.atEnd() && !reader.hasError())
+		{
+			if (reader.isStartElement())
+			{
+				QXmlStreamAttributes attributes = reader.attributes();
+
+				if (!reader.name().compare(QLatin1String("node")))
+				{
+					found = true;
+					node.Path = attributes.value("path").toString();
+					node.Hash = attributes.value("hash").toString();
+				}
+				else if (!reader.name().compare(QLatin1String("dir")))
+				{
+					CMerkleDirInfo dir;
+					dir.Path = attributes.value("path").toString();
+					dir.Hash = attributes.value("hash").toString();
+					dir.Manifest = attributes.value("manifest").toString();
+
+					if (dir.Path.length() && dir.Manifest.length())
+						node.Dirs.push_back(dir);
+				}
+				else if (!reader.name().compare(QLatin1String("meta")))
+				{
+					if (attributes.hasAttribute("name"))
+					{
+						CUpdateInfo info;
+						info.Name = attributes.value("name").toString();
+						info.Version = attributes.value("version").toString();
+						info.Hash = attributes.value("hash").toString();
+						info.HashAlgo = attributes.value("hashalgo").toString();
+						info.ZipFileName = attributes.value("filename").toString();
+						info.ZipSize = (attributes.hasAttribute("zipsize") ? attributes.value("zipsize").toLongLong() : -1);
+						info.Notes = attributes.value("updatenotes").toString();
+						info.BlockMapFileName = attributes.value("blockmap").toString();
+						info.RawFileName = attributes.value("rawfile").toString();
+						info.UODir = attributes.value("uodir").toString();
+
+						node.Files.push_back(info);
+					}
+					else if (attributes.hasAttribute("backup"))
+					{
+						CBackupInfo backup;
+						backup.Name = attributes.value("backup").toString();
+						backup.ZipFileName = attributes.value("filename").toString();
+
+						node.Backups.push_back(backup);
+					}
+				}
+				else if (!reader.name().compare(QLatin1String("patch")))
+				{
+					CPatchInfo patch;
+					patch.FromHash = attributes.value("fromhash").toString();
+					patch.FromVersion = attributes.value("fromversion").toString();
+					patch.FileName = attributes.value("filename").toString();
+					patch.Size = (attributes.hasAttribute("size") ? attributes.value("size").toLongLong() : -1);
+
+					if (patch.FileName.length())
+						patches.push_back(qMakePair(attributes.value("name").toString(), patch));
+				}
+			}
+
+			reader.readNext();
+		}
+
+		//! Патчи не входят в хэш узла: они описывают способ получения файла, а не его содержимое
+		for (const QPair<QString, CPatchInfo> &patch : patches)
+		{
+			for (CUpdateInfo &info : node.Files)
+			{
+				if (info.Name == patch.first)
+					info.Patches.push_back(patch.second);
+			}
+		}
+
+		return (found && !reader.hasError());
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ComputeHash Вычислить хэш узла по его содержимому
+	 * @return Хэш в шестнадцатеричном виде
+	 */
+	QString ComputeHash() const
+	{
+		QStringList lines;
+
+		for (const CUpdateInfo &info : Files)
+			lines << ("f " + info.Name + " " + CHashCalculator::AlgorithmName(CHashCalculator::AlgorithmFromName(info.HashAlgo)) + " " + info.Hash.toLower() + " " + info.Version + "\n");
+
+		for (const CMerkleDirInfo &dir : Dirs)
+			lines << ("d " + dir.Path + " " + dir.Hash.toLower() + "\n");
+
+		lines.sort();
+
+		QByteArray data = lines.join("").toUtf8();
+
+		return CHashCalculator::HashData((const uchar *)data.constData(), data.size(), HA_BLAKE3);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief IsValid Проверка целостности узла
+	 * @param expectedHash Хэш, указанный в родительском узле (пусто для корня)
+	 * @return true если содержимое соответствует хэшу
+	 */
+	bool IsValid(const QString &expectedHash) const
+	{
+		QString hash = ComputeHash();
+
+		if (!CHashCalculator::Compare(Hash, hash))
+			return false;
+
+		return (!expectedHash.length() || CHashCalculator::Compare(expectedHash, hash));
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CMerkleTreeState class
+ * Хэши узлов, которые полностью совпадают с установленным клиентом
+ * Для каждого узла запоминаются размер и время изменения его файлов на диске: узел считается
+ * синхронизированным, только пока они не изменились (файл удален, поврежден, перезаписан).
+ */
+class CMerkleTreeState
+{
+private:
+	//! Файл узла на диске
+	struct CFileStamp
+	{
+		QString Path;
+		qint64 Size;
+		qint64 Modified;
+	};
+
+	//! Синхронизированный узел
+	struct CSyncedNode
+	{
+		QString Hash;
+		QList<CFileStamp> Files;
+		QStringList Dirs;
+	};
+
+	//! Узлы по пути
+	QHash<QString, CSyncedNode> m_Nodes;
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief IsIntact Файлы узла и его поддеревьев не менялись с момента синхронизации
+	 * @param path Путь узла
+	 * @return true если узел и все поддеревья на месте и не изменились
+	 */
+	bool IsIntact(const QString &path) const
+	{
+		auto node = m_Nodes.constFind(path);
+
+		if (node == m_Nodes.constEnd())
+			return false;
+
+		for (const CFileStamp &stamp : node->Files)
+		{
+			QFileInfo info(stamp.Path);
+
+			if (!info.exists() || info.size() != stamp.Size || info.lastModified().toMSecsSinceEpoch() != stamp.Modified)
+				return false;
+		}
+
+		for (const QString &dir : node->Dirs)
+		{
+			if (!IsIntact(dir))
+				return false;
+		}
+
+		return true;
+	}
+
+public:
+	CMerkleTreeState() {}
+	~CMerkleTreeState() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief StatePath Путь к файлу состояния для директории клиента
+	 * @param inventoryPath Путь к файлу описи этой директории
+	 * @return Путь
+	 */
+	static QString StatePath(const QString &inventoryPath)
+	{
+		QString path = inventoryPath;
+
+		if (path.endsWith(".xml"))
+			path.chop(4);
+
+		return path + ".tree.xml";
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Invalidate Сбросить узлы, содержащие перезаписанные файлы (и все узлы над ними)
+	 * @param statePath Путь к файлу состояния
+	 * @param files Пути файлов относительно директории клиента
+	 */
+	static void Invalidate(const QString &statePath, const QStringList &files)
+	{
+		if (!QFile::exists(statePath))
+			return;
+
+		CMerkleTreeState state;
+		state.Load(statePath);
+
+		for (const QString &file : files)
+		{
+			QString dir = QDir::fromNativeSeparators(file);
+
+			do
+			{
+				int slash = dir.lastIndexOf('/');
+				dir = (slash > 0 ? dir.left(slash) : QString(""));
+				state.Reset(dir);
+			}
+			while (dir.length());
+		}
+
+		state.Save(statePath);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief IsSynced Узел совпадает с релизом и его файлы на диске не менялись
+	 * @param path Путь узла
+	 * @param hash Хэш узла на сервере
+	 * @return true если узел можно не проверять
+	 */
+	bool IsSynced(const QString &path, const QString &hash) const
+	{
+		return (hash.length() && m_Nodes.value(path).Hash == hash.toLower() && IsIntact(path));
+	}
+
+	/**
+	 * @brief SetSynced Запомнить синхронизированный узел
+	 * @param path Путь узла
+	 * @param hash Хэш узла
+	 * @param files Пути файлов узла на диске (размер и время изменения берутся сейчас)
+	 * @param dirs Пути поддеревьев узла
+	 */
+	void SetSynced(const QString &path, const QString &hash, const QStringList &files, const QStringList &dirs)
+	{
+		CSyncedNode node;
+		node.Hash = hash.toLower();
+		node.Dirs = dirs;
+
+		for (const QString &file : files)
+		{
+			QFileInfo info(file);
+			node.Files.push_back({ file, info.size(), info.lastModified().toMSecsSinceEpoch() });
+		}
+
+		m_Nodes.insert(path, node);
+	}
+
+	void Reset(const QString &path)
+	{
+		m_Nodes.remove(path);
+	}
+
+	//----------------------------------------------------------------------------------
+	void Load(const QString &path)
+	{
+		m_Nodes.clear();
+
+		QFile file(path);
+
+		if (file.open(QIODevice::ReadOnly | QIODevice::Text))
+		{
+			QXmlStreamReader reader(&file);
+			QString current = "";
+			bool supported = false;
+
+			while (!reader.atEnd() && !reader.hasError())
+			{
+				if (reader.isStartElement())
+				{
+					QXmlStreamAttributes attributes = reader.attributes();
+
+					//! В состоянии старого формата нет файлов узлов - по нему изменения на диске не видны
+					if (!reader.name().compare(QLatin1String("treestate")))
+						supported = (attributes.value("version") == QLatin1String("1"));
+					else if (!supported)
+						break;
+					else if (!reader.name().compare(QLatin1String("node")))
+					{
+						current = attributes.value("path").toString();
+						m_Nodes[current].Hash = attributes.value("hash").toString();
+					}
+					else if (!reader.name().compare(QLatin1String("file")))
+						m_Nodes[current].Files.push_back({ attributes.value("path").toString(), attributes.value("size").toLongLong(), attributes.value("modified").toLongLong() });
+					else if (!reader.name().compare(QLatin1String("dir")))
+						m_Nodes[current].Dirs.push_back(attributes.value("path").toString());
+				}
+
+				reader.readNext();
+			}
+
+			file.close();
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	void Save(const QString &path) const
+	{
+		QDir().mkpath(QFileInfo(path).absolutePath());
+
+		QFile file(path);
+
+		if (file.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			QXmlStreamWriter writter(&file);
+
+			writter.setAutoFormatting(true);
+
+			writter.writeStartDocument();
+
+			writter.writeStartElement("treestate");
+			writter.writeAttribute("version", "1");
+
+			for (auto it = m_Nodes.constBegin(); it != m_Nodes.constEnd(); ++it)
+			{
+				writter.writeStartElement("node");
+
+				writter.writeAttribute("path", it.key());
+				writter.writeAttribute("hash", it.value().Hash);
+
+				for (const CFileStamp &stamp : it.value().Files)
+				{
+					writter.writeStartElement("file");
+
+					writter.writeAttribute("path", stamp.Path);
+					writter.writeAttribute("size", QString::number(stamp.Size));
+					writter.writeAttribute("modified", QString::number(stamp.Modified));
+
+					writter.writeEndElement(); // file
+				}
+
+				for (const QString &dir : it.value().Dirs)
+				{
+					writter.writeStartElement("dir");
+					writter.writeAttribute("path", dir);
+					writter.writeEndElement(); // dir
+				}
+
+				writter.writeEndElement(); // node
+			}
+
+			writter.writeEndElement(); // treestate
+
+			writter.writeEndDocument();
+
+			file.close();
+		}
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // MERKLETREE_H
+//----------------------------------------------------------------------------------
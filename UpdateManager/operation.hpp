@@ -0,0 +1,328 @@
+/**
+@file Operation.hpp
+
+@brief Отмена и срок выполнения операций обновления, запущенных в пуле потоков
+
+Владелец (окно) хранит копию COperation, задача - свою копию; обе ссылаются на одно состояние.
+Отмена закрывает зарегистрированные соединения WinINet: заблокированные HttpSendRequest и
+InternetReadFile сразу возвращают ошибку, поэтому задача не ждет таймаутов сервера.
+Между частями работы задача проверяет Stopped(). Отмененная владельцем задача не отправляет
+результат (владельцу он не нужен, а получатель может уже удаляться); задача, у которой вышел
+срок, отправляет результат как при ошибке, чтобы интерфейс не остался заблокированным.
+Прогресс задача публикует в очередь владельца (ProgressQueue.hpp), если она указана; очередью
+владеют совместно владелец и операции, поэтому она живет, пока ее может заполнять задача.
+Проверка установки, объединение файлов и хэширование проверяют Stopped() между файлами и порциями
+файла; не прерываются восстановление снимка и связывание одной группы одинаковых файлов, поэтому
+владелец перед удалением ждет свои операции без ограничения времени (CancelAll).
+**/
+//----------------------------------------------------------------------------------
+#ifndef OPERATION_H
+#define OPERATION_H
+//----------------------------------------------------------------------------------
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThread>
+#include "progressqueue.hpp"
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <Wininet.h>
+#else
+//! Без WinINet отмена только выставляет флаг (хэширование и проверка установки в тестах)
+typedef void *HINTERNET;
+#endif
+//----------------------------------------------------------------------------------
+/**
+ * @brief The COperationState class
+ * Общее состояние операции (владелец и задача)
+ */
+class COperationState
+{
+public:
+	COperationState() {}
+	~COperationState() {}
+
+	//! Номер операции (различает события прогресса в общей очереди владельца)
+	quint32 Id{ 0 };
+
+	//! Операция отменена владельцем
+	QAtomicInt Cancelled{ 0 };
+
+	//! Срок выполнения, мс от начала эпохи (0 - без срока)
+	qint64 Deadline{ 0 };
+
+	//! Открытые соединения задачи
+	QSet<HINTERNET> Handles;
+
+	QMutex Mutex;
+
+	//! Задача в пуле потоков
+	QFuture<void> Future;
+
+	//! Очередь прогресса владельца (пустой указатель - прогресс не нужен)
+	QSharedPointer<CProgressQueue> Progress;
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The COperation class
+ * Описатель операции: отмена, срок выполнения, ожидание завершения
+ */
+class COperation
+{
+private:
+	QSharedPointer<COperationState> m_State;
+
+	//----------------------------------------------------------------------------------
+	static QAtomicInteger<quint32> &LastId()
+	{
+		static QAtomicInteger<quint32> id(0);
+		return id;
+	}
+
+public:
+	/**
+	 * @brief COperation
+	 * @param timeout Срок выполнения от текущего момента, мс (0 - без срока)
+	 * @param progress Очередь прогресса владельца
+	 */
+	COperation(const qint64 &timeout = 0, const QSharedPointer<CProgressQueue> &progress = QSharedPointer<CProgressQueue>())
+	: m_State(new COperationState())
+	{
+		m_State->Id = LastId().fetchAndAddRelaxed(1) + 1;
+
+		if (timeout > 0)
+			m_State->Deadline = QDateTime::currentMSecsSinceEpoch() + timeout;
+
+		m_State->Progress = progress;
+	}
+
+	~COperation() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Cancel Отменить операцию и прервать ее соединения
+	 */
+	void Cancel()
+	{
+		QMutexLocker locker(&m_State->Mutex);
+
+		m_State->Cancelled.storeRelease(1);
+
+#if defined(Q_OS_WIN)
+		for (HINTERNET handle : m_State->Handles)
+			InternetCloseHandle(handle);
+#endif
+
+		m_State->Handles.clear();
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Номер операции (операции, начатые позже, имеют больший номер)
+	quint32 Id() const
+	{
+		return m_State->Id;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Операция отменена владельцем (результат не отправляется)
+	bool IsCancelled() const
+	{
+		return (m_State->Cancelled.loadAcquire() != 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Срок выполнения вышел
+	bool Expired() const
+	{
+		return (m_State->Deadline && QDateTime::currentMSecsSinceEpoch() >= m_State->Deadline);
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Работу нужно прекратить (отмена или срок)
+	bool Stopped() const
+	{
+		return (IsCancelled() || Expired());
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Remaining Оставшееся время
+	 * @return мс (-1 - без срока)
+	 */
+	qint64 Remaining() const
+	{
+		if (!m_State->Deadline)
+			return -1;
+
+		return qMax(m_State->Deadline - QDateTime::currentMSecsSinceEpoch(), (qint64)0);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Publish Опубликовать прогресс (без блокировок, можно на каждую принятую часть)
+	 * @param percent Общий прогресс, % (-1 - неизвестен)
+	 * @param bytes Принято с начала операции, байт
+	 */
+	void Publish(const int &percent, const qint64 &bytes) const
+	{
+		if (!m_State->Progress.isNull())
+			m_State->Progress->Publish(CProgressEvent(m_State->Id, percent, bytes));
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Attach Зарегистрировать соединение (отмена его закроет)
+	 * @param handle Соединение
+	 * @return false если операция уже отменена (соединение не зарегистрировано)
+	 */
+	bool Attach(HINTERNET handle)
+	{
+		QMutexLocker locker(&m_State->Mutex);
+
+		if (IsCancelled())
+			return false;
+
+		m_State->Handles.insert(handle);
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Detach Снять соединение с регистрации перед закрытием
+	 * @param handle Соединение
+	 * @return true если соединение нужно закрыть (отмена его еще не закрыла)
+	 */
+	bool Detach(HINTERNET handle)
+	{
+		QMutexLocker locker(&m_State->Mutex);
+
+		return m_State->Handles.remove(handle);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SetFuture Запомнить задачу операции
+	 * @param future Результат QtConcurrent::run
+	 */
+	void SetFuture(const QFuture<void> &future)
+	{
+		QMutexLocker locker(&m_State->Mutex);
+
+		m_State->Future = future;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Задача еще выполняется (или ждет свободного потока)
+	bool IsRunning() const
+	{
+		QMutexLocker locker(&m_State->Mutex);
+
+		return (m_State->Future.isStarted() && !m_State->Future.isFinished());
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Wait Дождаться завершения задачи
+	 * @param timeout Сколько ждать, мс (-1 - без ограничения)
+	 * @return true если задача завершилась
+	 */
+	bool Wait(const int &timeout = -1) const
+	{
+		QElapsedTimer timer;
+		timer.start();
+
+		while (IsRunning())
+		{
+			if (timeout >= 0 && timer.elapsed() >= timeout)
+				return false;
+
+			QThread::msleep(10);
+		}
+
+		return true;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The COperationList class
+ * Операции владельца (отменяются вместе при закрытии)
+ */
+class COperationList
+{
+private:
+	QList<COperation> m_Operations;
+
+public:
+	COperationList() {}
+	~COperationList() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Add Добавить запущенную операцию (завершенные забываются)
+	 * @param operation Операция
+	 * @param future Ее задача (результат QtConcurrent::run)
+	 * @return Операция
+	 */
+	COperation Add(COperation operation, const QFuture<void> &future)
+	{
+		for (int i = m_Operations.size() - 1; i >= 0; i--)
+		{
+			if (!m_Operations[i].IsRunning())
+				m_Operations.removeAt(i);
+		}
+
+		operation.SetFuture(future);
+		m_Operations.push_back(operation);
+
+		return operation;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Хотя бы одна задача еще выполняется
+	bool IsRunning() const
+	{
+		for (const COperation &operation : m_Operations)
+		{
+			if (operation.IsRunning())
+				return true;
+		}
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CancelAll Отменить все операции и дождаться их завершения
+	 * Задача, которую перестали ждать, может обратиться к удаленному владельцу, поэтому перед
+	 * удалением владельца ограничение не указывается: отмена прерывает сетевые запросы, а
+	 * непрерываемая работа заканчивается сама.
+	 * @param timeout Сколько ждать в сумме, мс (-1 - без ограничения)
+	 * @return true если все задачи завершились
+	 */
+	bool CancelAll(const int &timeout = -1)
+	{
+		for (COperation &operation : m_Operations)
+			operation.Cancel();
+
+		QElapsedTimer timer;
+		timer.start();
+		bool result = true;
+
+		for (const COperation &operation : m_Operations)
+			result = (operation.Wait(timeout < 0 ? -1 : (int)qMax(timeout - timer.elapsed(), (qint64)0)) && result);
+
+		m_Operations.clear();
+
+		return result;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // OPERATION_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,513 @@
+/**
+@file PackageCache.hpp
+
+@brief Локальное хранилище скачанных архивов, патчей и распакованных файлов (адресация по содержимому)
+
+Каждый объект хранится один раз под именем BLAKE3 своего содержимого, на объект ссылаются ключи:
+@code
+UpdateCache/objects/<blake3>      содержимое
+UpdateCache/index.xml             ключи, размеры и время последнего использования:
+
+<packagecache version="0">
+	<object hash="..." size="..." used="..."/>
+	<alias key="pkg:..." hash="..."/>
+	<alias key="file:blake3:..." hash="..."/>
+</packagecache>
+@endcode
+Ключ архива или патча - хэш от названия и версий/контрольных сумм его файлов (новая версия архива
+с тем же названием не подменяется старой), ключ распакованного файла - его контрольная сумма из манифеста,
+ключ резервной версии - ее адрес на сервере. При чтении содержимое объекта проверяется заново.
+Когда объем хранилища превышает бюджет, удаляются дольше всего не использованные объекты.
+**/
+//----------------------------------------------------------------------------------
+#ifndef PACKAGECACHE_H
+#define PACKAGECACHE_H
+//----------------------------------------------------------------------------------
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include "blake3.hpp"
+#include "hashcalculator.hpp"
+#include "updateplanner.hpp"
+
+#include <QDebug>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CPackageCache class
+ * Хранилище с ограничением объема. Один экземпляр, доступ из любых потоков.
+ */
+class CPackageCache
+{
+private:
+	//! Бюджет по умолчанию, Мб
+	enum { DEFAULT_BUDGET_MB = 2048 };
+
+	/**
+	 * @brief The CObject class
+	 * Объект хранилища
+	 */
+	class CObject
+	{
+	public:
+		//! Размер, байт
+		qint64 Size{ 0 };
+
+		//! Время последнего использования, мс от начала эпохи
+		qint64 LastUsed{ 0 };
+	};
+
+	//! Хэш содержимого по ключу
+	QHash<QString, QString> m_Aliases;
+
+	//! Объекты по хэшу содержимого
+	QHash<QString, CObject> m_Objects;
+
+	//! Суммарный размер объектов
+	qint64 m_TotalSize{ 0 };
+
+	//! Бюджет, байт
+	qint64 m_Budget{ DEFAULT_BUDGET_MB * 1024LL * 1024LL };
+
+	//! Индекс прочитан с диска
+	bool m_Loaded{ false };
+
+	//! Защита индекса
+	QMutex m_Mutex;
+
+	CPackageCache() {}
+
+	//----------------------------------------------------------------------------------
+	static QString IndexPath()
+	{
+		return Directory() + "/index.xml";
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString ObjectPath(const QString &hash)
+	{
+		return Directory() + "/objects/" + hash;
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString HashOf(const QString &filePath)
+	{
+		QFile file(filePath);
+
+		if (!file.open(QIODevice::ReadOnly))
+			return "";
+
+		QString hash = CHashCalculator::HashFile(file, HA_BLAKE3).toLower();
+
+		file.close();
+
+		return hash;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Прочитать индекс при первом обращении (вызывается под m_Mutex)
+	void Load()
+	{
+		if (m_Loaded)
+			return;
+
+		m_Loaded = true;
+
+		QFile file(IndexPath());
+
+		if (!file.open(QIODevice::ReadOnly))
+			return;
+
+		QXmlStreamReader reader(&file);
+
+		while (!reader.atEnd() && !reader.hasError())
+		{
+			if (reader.readNext() != QXmlStreamReader::StartElement)
+				continue;
+
+			QXmlStreamAttributes attributes = reader.attributes();
+
+			if (reader.name() == "object")
+			{
+				QString hash = attributes.value("hash").toString();
+
+				//! Объект, удаленный вручную, из индекса выпадает
+				if (!hash.length() || !QFile::exists(ObjectPath(hash)))
+					continue;
+
+				CObject object;
+				object.Size = attributes.value("size").toLongLong();
+				object.LastUsed = attributes.value("used").toLongLong();
+
+				m_Objects[hash] = object;
+				m_TotalSize += object.Size;
+			}
+			else if (reader.name() == "alias")
+				m_Aliases[attributes.value("key").toString()] = attributes.value("hash").toString();
+		}
+
+		file.close();
+
+		for (auto it = m_Aliases.begin(); it != m_Aliases.end(); )
+		{
+			if (m_Objects.contains(it.value()))
+				++it;
+			else
+				it = m_Aliases.erase(it);
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Записать индекс (вызывается под m_Mutex)
+	void Save() const
+	{
+		QDir().mkpath(Directory());
+
+		QFile file(IndexPath());
+
+		if (file.open(QIODevice::WriteOnly | QIODevice::Text))
+		{
+			QXmlStreamWriter writter(&file);
+
+			writter.setAutoFormatting(true);
+
+			writter.writeStartDocument();
+
+			writter.writeStartElement("packagecache");
+			writter.writeAttribute("version", "0");
+
+			for (auto it = m_Objects.constBegin(); it != m_Objects.constEnd(); ++it)
+			{
+				writter.writeStartElement("object");
+
+				writter.writeAttribute("hash", it.key());
+				writter.writeAttribute("size", QString::number(it.value().Size));
+				writter.writeAttribute("used", QString::number(it.value().LastUsed));
+
+				writter.writeEndElement(); // object
+			}
+
+			for (auto it = m_Aliases.constBegin(); it != m_Aliases.constEnd(); ++it)
+			{
+				writter.writeStartElement("alias");
+
+				writter.writeAttribute("key", it.key());
+				writter.writeAttribute("hash", it.value());
+
+				writter.writeEndElement(); // alias
+			}
+
+			writter.writeEndElement(); // packagecache
+
+			writter.writeEndDocument();
+
+			file.close();
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Удалить объект и все ссылающиеся на него ключи (вызывается под m_Mutex)
+	void Remove(const QString &hash)
+	{
+		auto it = m_Objects.find(hash);
+
+		if (it != m_Objects.end())
+		{
+			m_TotalSize -= it.value().Size;
+			m_Objects.erase(it);
+		}
+
+		for (auto alias = m_Aliases.begin(); alias != m_Aliases.end(); )
+		{
+			if (alias.value() == hash)
+				alias = m_Aliases.erase(alias);
+			else
+				++alias;
+		}
+
+		QFile::remove(ObjectPath(hash));
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Evict Удалять дольше всего не использованные объекты, пока объем больше бюджета
+	 * @param keep Объект, который удалять нельзя (только что добавленный)
+	 */
+	void Evict(const QString &keep)
+	{
+		while (m_TotalSize > m_Budget)
+		{
+			QString oldest = "";
+			qint64 oldestTime = 0;
+
+			for (auto it = m_Objects.constBegin(); it != m_Objects.constEnd(); ++it)
+			{
+				if (it.key() != keep && (!oldest.length() || it.value().LastUsed < oldestTime))
+				{
+					oldest = it.key();
+					oldestTime = it.value().LastUsed;
+				}
+			}
+
+			if (!oldest.length())
+				break;
+
+			Remove(oldest);
+		}
+	}
+
+public:
+	~CPackageCache() {}
+
+	//----------------------------------------------------------------------------------
+	static CPackageCache &Instance()
+	{
+		static CPackageCache cache;
+
+		return cache;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Directory Директория хранилища (рядом с настройками лаунчера)
+	 * @return Путь
+	 */
+	static QString Directory()
+	{
+		return QDir::currentPath() + "/UpdateCache";
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Key Ключ архива или патча из плана
+	 * @param action Скачивание архива или патча
+	 * @return Ключ (пусто для остальных действий)
+	 */
+	static QString Key(const CUpdateAction &action)
+	{
+		if (action.Type != UAT_FETCH && action.Type != UAT_PATCH)
+			return "";
+
+		QByteArray text = action.ZipFileName.toLower().toUtf8() + "\n";
+
+		for (const CUpdateInfo &info : action.Files)
+		{
+			text += (info.Name + " " + info.Version + " " + info.Hash).toUtf8();
+
+			//! Патч зависит и от исходной версии файла
+			if (action.Type == UAT_PATCH && info.Patch >= 0 && info.Patch < info.Patches.size())
+				text += (" " + info.Patches.at(info.Patch).FromHash + " " + info.Patches.at(info.Patch).FromVersion).toUtf8();
+
+			text += "\n";
+		}
+
+		return "pkg:" + CHashCalculator::ToHex(CBlake3::Hash((const uchar *)text.constData(), text.size())).left(32);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FileKey Ключ распакованного файла
+	 * @param info Информация о файле из манифеста
+	 * @return Ключ (пусто, если контрольная сумма не указана)
+	 */
+	static QString FileKey(const CUpdateInfo &info)
+	{
+		if (!info.Hash.trimmed().length())
+			return "";
+
+		return "file:" + CHashCalculator::AlgorithmName(CHashCalculator::AlgorithmFromName(info.HashAlgo)) + ":" + info.Hash.trimmed().toLower();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief UrlKey Ключ файла, который не меняется на сервере (резервные версии)
+	 * @param host Адрес хоста
+	 * @param path Путь
+	 * @param page Название
+	 * @return Ключ
+	 */
+	static QString UrlKey(const QString &host, const QString &path, const QString &page)
+	{
+		return "url:" + (host + path + page).toLower();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SetBudget Задать максимальный объем хранилища
+	 * @param bytes Объем, байт (0 - хранилище не используется)
+	 */
+	void SetBudget(const qint64 &bytes)
+	{
+		QMutexLocker locker(&m_Mutex);
+
+		Load();
+
+		m_Budget = qMax(bytes, (qint64)0);
+
+		qint64 totalSize = m_TotalSize;
+
+		Evict("");
+
+		if (m_TotalSize != totalSize)
+			Save();
+	}
+
+	//----------------------------------------------------------------------------------
+	qint64 Budget()
+	{
+		QMutexLocker locker(&m_Mutex);
+
+		return m_Budget;
+	}
+
+	//----------------------------------------------------------------------------------
+	bool Contains(const QString &key)
+	{
+		QMutexLocker locker(&m_Mutex);
+
+		Load();
+
+		return (key.length() && m_Aliases.contains(key));
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Locate Путь к объекту для чтения на месте (раздача по сети)
+	 * Содержимое не проверяется: получатель сверяет его с манифестом сам
+	 * @param key Ключ
+	 * @return Путь (пусто, если объекта нет)
+	 */
+	QString Locate(const QString &key)
+	{
+		QMutexLocker locker(&m_Mutex);
+
+		Load();
+
+		QString hash = m_Aliases.value(key);
+
+		return (hash.length() ? ObjectPath(hash) : QString());
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Get Получить копию объекта по ключу
+	 * Содержимое проверяется перед копированием, испорченный объект удаляется
+	 * @param key Ключ
+	 * @param targetPath Куда скопировать
+	 * @return true если объект найден, цел и скопирован
+	 */
+	bool Get(const QString &key, const QString &targetPath)
+	{
+		if (!key.length())
+			return false;
+
+		QString hash = "";
+
+		{
+			QMutexLocker locker(&m_Mutex);
+
+			Load();
+
+			hash = m_Aliases.value(key);
+		}
+
+		if (!hash.length())
+			return false;
+
+		//! Проверка и копирование - без блокировки, объект могут удалить параллельно - тогда копирование не удастся
+		if (HashOf(ObjectPath(hash)) != hash)
+		{
+			qDebug() << "Package cache object is damaged:" << hash;
+
+			QMutexLocker locker(&m_Mutex);
+
+			Remove(hash);
+			Save();
+
+			return false;
+		}
+
+		QDir().mkpath(QFileInfo(targetPath).absolutePath());
+		QFile::remove(targetPath);
+
+		if (!QFile::copy(ObjectPath(hash), targetPath))
+			return false;
+
+		QMutexLocker locker(&m_Mutex);
+
+		auto it = m_Objects.find(hash);
+
+		if (it != m_Objects.end())
+		{
+			it.value().LastUsed = QDateTime::currentMSecsSinceEpoch();
+			Save();
+		}
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Put Поместить копию файла в хранилище под ключом
+	 * @param key Ключ
+	 * @param filePath Файл (остается на месте)
+	 * @return true если файл сохранен
+	 */
+	bool Put(const QString &key, const QString &filePath)
+	{
+		if (!key.length() || !Budget())
+			return false;
+
+		QString hash = HashOf(filePath);
+		qint64 size = QFileInfo(filePath).size();
+
+		if (!hash.length() || size > Budget())
+			return false;
+
+		QString objectPath = ObjectPath(hash);
+
+		//! Одинаковое содержимое под разными ключами хранится один раз
+		if (!QFile::exists(objectPath))
+		{
+			QString partPath = objectPath + ".part";
+
+			QDir().mkpath(QFileInfo(objectPath).absolutePath());
+			QFile::remove(partPath);
+
+			if (!QFile::copy(filePath, partPath) || !QFile::rename(partPath, objectPath))
+			{
+				QFile::remove(partPath);
+
+				//! Тот же объект мог сохранить параллельный поток
+				if (!QFile::exists(objectPath))
+					return false;
+			}
+		}
+
+		QMutexLocker locker(&m_Mutex);
+
+		Load();
+
+		if (!m_Objects.contains(hash))
+		{
+			m_Objects[hash].Size = size;
+			m_TotalSize += size;
+		}
+
+		m_Objects[hash].LastUsed = QDateTime::currentMSecsSinceEpoch();
+		m_Aliases[key] = hash;
+
+		Evict(hash);
+		Save();
+
+		return true;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // PACKAGECACHE_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,301 @@
+/**
+@file PEVersionReader.hpp
+
+@brief Чтение версии из ресурсов PE файла без использования WinAPI
+**/
+//----------------------------------------------------------------------------------
+#ifndef PEVERSIONREADER_H
+#define PEVERSIONREADER_H
+//----------------------------------------------------------------------------------
+#include <QFile>
+#include <QString>
+#include <QtEndian>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CPEVersionReader class
+ * Разбор PE образа (отображенного в память) до VS_FIXEDFILEINFO:
+ * заголовки -> таблица секций -> каталог ресурсов (RT_VERSION) -> VS_VERSIONINFO.
+ * Остальные страницы образа не затрагиваются.
+ */
+class CPEVersionReader
+{
+private:
+	enum
+	{
+		//! Тип ресурса с версией
+		RT_VERSION_ID = 16,
+
+		//! Максимальное количество секций, которое мы готовы просмотреть
+		MAX_SECTIONS = 96
+	};
+
+	//! Сигнатура VS_FIXEDFILEINFO
+	static quint32 FixedFileInfoSignature() { return 0xFEEF04BD; }
+
+	//! Отображенный образ
+	const uchar *m_Data{ nullptr };
+
+	//! Размер образа
+	quint64 m_Size{ 0 };
+
+	//! Смещение таблицы секций
+	quint64 m_SectionsOffset{ 0 };
+
+	//! Количество секций
+	int m_SectionsCount{ 0 };
+
+	//----------------------------------------------------------------------------------
+	CPEVersionReader(const uchar *data, const quint64 &size)
+	: m_Data(data), m_Size(size)
+	{
+	}
+
+	//----------------------------------------------------------------------------------
+	bool Has(const quint64 &offset, const quint64 &size) const
+	{
+		return (offset <= m_Size && size <= m_Size - offset);
+	}
+
+	quint16 U16(const quint64 &offset) const
+	{
+		return qFromLittleEndian<quint16>(m_Data + offset);
+	}
+
+	quint32 U32(const quint64 &offset) const
+	{
+		return qFromLittleEndian<quint32>(m_Data + offset);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief RvaToOffset Преобразование RVA в смещение в файле по таблице секций
+	 * @param rva Относительный виртуальный адрес
+	 * @param offset Смещение в файле
+	 * @param available Сколько байт секции доступно начиная с offset
+	 * @return true если адрес принадлежит одной из секций
+	 */
+	bool RvaToOffset(const quint32 &rva, quint64 &offset, quint64 &available) const
+	{
+		for (int i = 0; i < m_SectionsCount; i++)
+		{
+			quint64 section = m_SectionsOffset + i * 40;
+			quint32 virtualSize = U32(section + 8);
+			quint32 virtualAddress = U32(section + 12);
+			quint32 rawSize = U32(section + 16);
+			quint32 rawOffset = U32(section + 20);
+			quint32 size = qMax(virtualSize, rawSize);
+
+			if (rva >= virtualAddress && rva - virtualAddress < size)
+			{
+				quint32 delta = rva - virtualAddress;
+
+				if (delta >= rawSize)
+					return false;
+
+				offset = (quint64)rawOffset + delta;
+				available = rawSize - delta;
+
+				return Has(offset, 1);
+			}
+		}
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FindEntry Поиск записи в каталоге ресурсов
+	 * @param base Смещение начала секции ресурсов
+	 * @param limit Размер секции ресурсов
+	 * @param directory Смещение каталога относительно base
+	 * @param id Искомый ID (0xFFFFFFFF - первая запись)
+	 * @param value Значение OffsetToData найденной записи
+	 * @return true если запись найдена
+	 */
+	bool FindEntry(const quint64 &base, const quint64 &limit, const quint32 &directory, const quint32 &id, quint32 &value) const
+	{
+		if ((quint64)directory + 16 > limit)
+			return false;
+
+		quint64 offset = base + directory;
+		int named = U16(offset + 12);
+		int ids = U16(offset + 14);
+		quint64 entries = offset + 16;
+
+		if ((quint64)directory + 16 + (quint64)(named + ids) * 8 > limit)
+			return false;
+
+		for (int i = 0; i < named + ids; i++)
+		{
+			quint64 entry = entries + i * 8;
+			quint32 name = U32(entry);
+
+			//! Именованные записи идут первыми, ID ищем только среди числовых
+			if (id == 0xFFFFFFFF || (i >= named && !(name & 0x80000000) && name == id))
+			{
+				value = U32(entry + 4);
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------------
+	bool Read(quint16 version[4])
+	{
+		//! IMAGE_DOS_HEADER
+		if (!Has(0, 0x40) || m_Data[0] != 'M' || m_Data[1] != 'Z')
+			return false;
+
+		quint64 pe = U32(0x3C);
+
+		//! Сигнатура + IMAGE_FILE_HEADER
+		if (!Has(pe, 24) || U32(pe) != 0x00004550)
+			return false;
+
+		m_SectionsCount = U16(pe + 6);
+		quint16 optionalSize = U16(pe + 20);
+		quint64 optional = pe + 24;
+
+		if (!m_SectionsCount || m_SectionsCount > MAX_SECTIONS || !Has(optional, optionalSize))
+			return false;
+
+		m_SectionsOffset = optional + optionalSize;
+
+		if (!Has(m_SectionsOffset, (quint64)m_SectionsCount * 40))
+			return false;
+
+		//! Каталог данных ресурсов (индекс 2) в PE32 / PE32+
+		quint16 magic = U16(optional);
+		quint64 directoriesCountOffset = (magic == 0x20B ? 108 : 92);
+
+		if (magic != 0x10B && magic != 0x20B)
+			return false;
+
+		if (optionalSize < directoriesCountOffset + 4 + 3 * 8 || U32(optional + directoriesCountOffset) < 3)
+			return false;
+
+		quint64 resourceDirectory = optional + directoriesCountOffset + 4 + 2 * 8;
+		quint32 resourceRva = U32(resourceDirectory);
+
+		quint64 base = 0;
+		quint64 limit = 0;
+
+		if (!resourceRva || !RvaToOffset(resourceRva, base, limit))
+			return false;
+
+		limit = qMin(limit, m_Size - base);
+
+		//! Тип -> имя -> язык
+		quint32 value = 0;
+
+		if (!FindEntry(base, limit, 0, (quint32)RT_VERSION_ID, value) || !(value & 0x80000000))
+			return false;
+
+		if (!FindEntry(base, limit, value & 0x7FFFFFFF, 0xFFFFFFFF, value) || !(value & 0x80000000))
+			return false;
+
+		if (!FindEntry(base, limit, value & 0x7FFFFFFF, 0xFFFFFFFF, value) || (value & 0x80000000))
+			return false;
+
+		//! IMAGE_RESOURCE_DATA_ENTRY
+		if ((quint64)value + 16 > limit)
+			return false;
+
+		quint32 dataRva = U32(base + value);
+		quint32 dataSize = U32(base + value + 4);
+		quint64 data = 0;
+		quint64 available = 0;
+
+		if (!RvaToOffset(dataRva, data, available))
+			return false;
+
+		quint64 size = qMin(qMin((quint64)dataSize, available), m_Size - data);
+
+		//! VS_VERSIONINFO: wLength, wValueLength, wType, szKey (UTF-16), выравнивание, VS_FIXEDFILEINFO
+		if (size < 6)
+			return false;
+
+		quint64 position = 6;
+
+		while (position + 2 <= size && U16(data + position))
+			position += 2;
+
+		position = (position + 2 + 3) & ~(quint64)3;
+
+		if (U16(data + 2) < 52 || position + 52 > size || U32(data + position) != FixedFileInfoSignature())
+			return false;
+
+		quint32 versionMS = U32(data + position + 8);
+		quint32 versionLS = U32(data + position + 12);
+
+		version[0] = (quint16)(versionMS >> 16);
+		version[1] = (quint16)versionMS;
+		version[2] = (quint16)(versionLS >> 16);
+		version[3] = (quint16)versionLS;
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+public:
+	/**
+	 * @brief ReadVersion Получить версию из ресурсов PE образа в памяти
+	 * @param data Образ
+	 * @param size Размер образа
+	 * @param version Версия (4 части)
+	 * @return true если версия найдена
+	 */
+	static bool ReadVersion(const uchar *data, const qint64 &size, quint16 version[4])
+	{
+		if (data == nullptr || size <= 0)
+			return false;
+
+		CPEVersionReader reader(data, (quint64)size);
+
+		return reader.Read(version);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ReadFileVersion Получить версию из ресурсов PE файла
+	 * @param path Путь к файлу
+	 * @param version Версия в виде "a.b.c.d", пустая если версии нет
+	 * @return true если версия найдена
+	 */
+	static bool ReadFileVersion(const QString &path, QString &version)
+	{
+		version = "";
+
+		QFile file(path);
+
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		//! Файлы данных отсеиваем по первым байтам, не отображая их в память
+		char magic[2] = { 0, 0 };
+
+		if (file.read(magic, 2) != 2 || magic[0] != 'M' || magic[1] != 'Z')
+			return false;
+
+		qint64 size = file.size();
+		uchar *data = file.map(0, size);
+
+		if (data == nullptr)
+			return false;
+
+		quint16 parts[4] = { 0, 0, 0, 0 };
+		bool result = ReadVersion(data, size, parts);
+
+		file.unmap(data);
+
+		if (result)
+			version.sprintf("%i.%i.%i.%i", parts[0], parts[1], parts[2], parts[3]);
+
+		return result;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // PEVERSIONREADER_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,216 @@
+/**
+@file ProgressQueue.hpp
+
+@brief Очередь событий прогресса без блокировок (несколько писателей, один читатель)
+
+Задачи обновления публикуют прогресс в очередь из рабочих потоков (хоть на каждую принятую часть),
+интерфейс забирает накопившееся по своему таймеру. Так прием не ждет интерфейс, а очередь событий Qt
+не заполняется сигналами прогресса. Очередь ограничена; событие, которому не хватило места,
+записывается в ячейку переполнения поверх предыдущего, поэтому последнее значение операции
+не теряется. Читатель оставляет по каждой операции ее наибольший прогресс: внутри операции он
+только растет, а прогресс разных операций между собой не сравнивается.
+
+Кольцевой буфер с номером поколения в каждой ячейке (D. Vyukov, bounded MPMC queue):
+писатель захватывает позицию сравнением с обменом, читатель (один) продвигается без атомарных операций.
+**/
+//----------------------------------------------------------------------------------
+#ifndef PROGRESSQUEUE_H
+#define PROGRESSQUEUE_H
+//----------------------------------------------------------------------------------
+#include <QAtomicInteger>
+#include <QHash>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CProgressEvent class
+ * Событие прогресса операции
+ */
+class CProgressEvent
+{
+public:
+	CProgressEvent() {}
+	CProgressEvent(const quint32 &operation, const int &percent, const qint64 &bytes)
+	: Operation(operation), Percent(percent), Bytes(bytes)
+	{
+	}
+
+	~CProgressEvent() {}
+
+	//! Номер операции (COperation::Id)
+	quint32 Operation{ 0 };
+
+	//! Общий прогресс операции, % (-1 - неизвестен, например при скачивании вне плана)
+	int Percent{ -1 };
+
+	//! Принято операцией с начала, байт
+	qint64 Bytes{ 0 };
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CMpscQueue class
+ * Ограниченная очередь без блокировок: Push - из любых потоков, Pop - только из одного
+ * @param T Тип элемента (копируемый)
+ * @param SIZE Емкость, степень двойки
+ */
+template<typename T, int SIZE>
+class CMpscQueue
+{
+	static_assert(SIZE > 1 && (SIZE & (SIZE - 1)) == 0, "Queue size must be a power of two");
+
+private:
+	class CCell
+	{
+	public:
+		//! Поколение ячейки: == позиции - свободна для записи, == позиции + 1 - заполнена
+		QAtomicInteger<quint32> Sequence;
+
+		T Data;
+	};
+
+	CCell m_Cells[SIZE];
+
+	//! Следующая позиция записи (общая для писателей)
+	QAtomicInteger<quint32> m_Head;
+
+	//! Следующая позиция чтения (только читатель)
+	quint32 m_Tail{ 0 };
+
+public:
+	CMpscQueue()
+	: m_Head(0)
+	{
+		for (int i = 0; i < SIZE; i++)
+			m_Cells[i].Sequence.store((quint32)i);
+	}
+
+	~CMpscQueue() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Push Добавить элемент
+	 * @param value Элемент
+	 * @return false если очередь заполнена (элемент не добавлен)
+	 */
+	bool Push(const T &value)
+	{
+		quint32 position = m_Head.load();
+		CCell *cell = nullptr;
+
+		for (;;)
+		{
+			cell = &m_Cells[position & (SIZE - 1)];
+
+			qint32 difference = (qint32)(cell->Sequence.loadAcquire() - position);
+
+			if (!difference)
+			{
+				//! Позицию занял другой писатель - повторяем с текущей
+				if (m_Head.testAndSetRelaxed(position, position + 1, position))
+					break;
+			}
+			else if (difference < 0)
+				return false;
+			else
+				position = m_Head.load();
+		}
+
+		cell->Data = value;
+		cell->Sequence.storeRelease(position + 1);
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Pop Забрать элемент (только из потока-читателя)
+	 * @param value Элемент
+	 * @return false если очередь пуста
+	 */
+	bool Pop(T &value)
+	{
+		CCell &cell = m_Cells[m_Tail & (SIZE - 1)];
+
+		if ((qint32)(cell.Sequence.loadAcquire() - (m_Tail + 1)) < 0)
+			return false;
+
+		value = cell.Data;
+		cell.Data = T();
+		cell.Sequence.storeRelease(m_Tail + SIZE);
+		m_Tail++;
+
+		return true;
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CProgressQueue class
+ * Очередь прогресса операций одного владельца (окна или вызывающего кода без интерфейса)
+ */
+class CProgressQueue : public CMpscQueue<CProgressEvent, 1024>
+{
+private:
+	//! Событие, не поместившееся в очередь: номер операции (старшие 32 бита) и прогресс + 1 (0 - пусто)
+	QAtomicInteger<quint64> m_Overflow;
+
+	//----------------------------------------------------------------------------------
+	//! Учесть событие в последних значениях операций
+	static void Merge(QHash<quint32, CProgressEvent> &latest, const CProgressEvent &event)
+	{
+		auto it = latest.find(event.Operation);
+
+		if (it == latest.end())
+			latest.insert(event.Operation, event);
+		else
+		{
+			it->Percent = qMax(it->Percent, event.Percent);
+			it->Bytes = qMax(it->Bytes, event.Bytes);
+		}
+	}
+
+public:
+	CProgressQueue() : CMpscQueue<CProgressEvent, 1024>(), m_Overflow(0) {}
+	~CProgressQueue() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Publish Добавить событие (из любых потоков)
+	 * При переполнении событие заменяет предыдущее в ячейке переполнения (байты в ней не хранятся:
+	 * следующее событие операции все равно несет полный счетчик)
+	 * @param event Событие
+	 */
+	void Publish(const CProgressEvent &event)
+	{
+		if (!Push(event))
+			m_Overflow.storeRelease(((quint64)event.Operation << 32) | (quint32)(event.Percent + 1));
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Drain Забрать все накопившиеся события (только из потока-читателя)
+	 * @param latest Последние значения по операциям: наибольший прогресс и счетчик байт
+	 * @return Количество событий
+	 */
+	int Drain(QHash<quint32, CProgressEvent> &latest)
+	{
+		int count = 0;
+		CProgressEvent event;
+
+		while (Pop(event))
+		{
+			Merge(latest, event);
+			count++;
+		}
+
+		quint64 overflow = m_Overflow.fetchAndStoreAcquire(0);
+
+		if (overflow)
+		{
+			Merge(latest, CProgressEvent((quint32)(overflow >> 32), (int)(quint32)overflow - 1, 0));
+			count++;
+		}
+
+		return count;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // PROGRESSQUEUE_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,232 @@
+/**
+@file SelfUpdate.hpp
+
+@brief Обновление запущенного лаунчера без внешней программы
+
+Архив лаунчера распаковывается во временную директорию, файлы проверяются по манифесту и
+меняются переименованием: запущенный файл отодвигается (Windows разрешает переименовать
+исполняемый файл и загруженные библиотеки, но не перезаписать их), на его место переименовывается новый.
+Затем лаунчер запускает сам себя и завершается. Отодвинутые файлы удаляются при следующем запуске.
+**/
+//----------------------------------------------------------------------------------
+#ifndef SELFUPDATE_H
+#define SELFUPDATE_H
+//----------------------------------------------------------------------------------
+#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPair>
+#include <QProcess>
+#include <QStringList>
+#include "qzipreader_p.h"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CSelfUpdate class
+ * Подготовка, замена и перезапуск
+ */
+class CSelfUpdate
+{
+private:
+	//----------------------------------------------------------------------------------
+	static QAtomicInt &SwappedValue()
+	{
+		static QAtomicInt swapped(0);
+		return swapped;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Суффикс отодвинутых файлов
+	static QString AsideSuffix()
+	{
+		return ".replaced";
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Список отодвинутых файлов (удаляются при следующем запуске)
+	static QString AsideListPath(const QString &launcherDirectory)
+	{
+		return launcherDirectory + "/ReplacedFiles.txt";
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief StagingDirectory Директория распакованного архива лаунчера
+	 * @param launcherDirectory Директория лаунчера
+	 * @return Путь
+	 */
+	static QString StagingDirectory(const QString &launcherDirectory)
+	{
+		return launcherDirectory + "/UpdateStaging";
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Swapped Файлы запущенного лаунчера заменены, нужен перезапуск
+	 * @return true если замена выполнена
+	 */
+	static bool Swapped()
+	{
+		return (SwappedValue().load() != 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Stage Распаковать архив лаунчера во временную директорию
+	 * @param archivePath Путь к архиву
+	 * @param launcherDirectory Директория лаунчера
+	 * @param files Распакованные файлы (относительно директории)
+	 * @return true если архив распакован
+	 */
+	static bool Stage(const QString &archivePath, const QString &launcherDirectory, QStringList &files)
+	{
+		QString staging = StagingDirectory(launcherDirectory);
+
+		QDir(staging).removeRecursively();
+		QDir().mkpath(staging);
+
+		QZipReader zipReader(archivePath);
+
+		bool result = zipReader.extractAll(staging);
+
+		if (result)
+		{
+			for (const QZipReader::FileInfo &info : zipReader.fileInfoList())
+			{
+				if (info.isFile)
+					files.push_back(info.filePath);
+			}
+		}
+
+		zipReader.close();
+
+		return (result && files.size());
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Swap Заменить файлы лаунчера распакованными
+	 * При ошибке уже замененные файлы возвращаются на место
+	 * @param launcherDirectory Директория лаунчера
+	 * @param files Распакованные файлы
+	 * @return true если все файлы заменены
+	 */
+	static bool Swap(const QString &launcherDirectory, const QStringList &files)
+	{
+		QString staging = StagingDirectory(launcherDirectory);
+
+		//! Замененные файлы и были ли у них предыдущие версии
+		QList<QPair<QString, bool>> done;
+		bool result = true;
+
+		for (const QString &name : files)
+		{
+			QString target = launcherDirectory + "/" + name;
+			QString aside = target + AsideSuffix();
+			bool existed = QFile::exists(target);
+
+			//! Файл мог остаться от прошлой замены, если тот процесс еще работал при запуске
+			QFile::remove(aside);
+			QDir().mkpath(QFileInfo(target).absolutePath());
+
+			if (existed && !QFile::rename(target, aside))
+			{
+				result = false;
+				break;
+			}
+
+			if (!QFile::rename(staging + "/" + name, target))
+			{
+				if (existed)
+					QFile::rename(aside, target);
+
+				result = false;
+				break;
+			}
+
+			done.push_back(qMakePair(target, existed));
+		}
+
+		if (!result)
+		{
+			for (const QPair<QString, bool> &file : done)
+			{
+				QFile::remove(file.first);
+
+				if (file.second)
+					QFile::rename(file.first + AsideSuffix(), file.first);
+			}
+		}
+		else
+		{
+			QFile list(AsideListPath(launcherDirectory));
+
+			if (list.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text))
+			{
+				for (const QString &name : files)
+					list.write((name + AsideSuffix() + "\n").toUtf8());
+
+				list.close();
+			}
+
+			SwappedValue().store(1);
+		}
+
+		QDir(staging).removeRecursively();
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Cleanup Удалить файлы, отодвинутые предыдущей заменой
+	 * @param launcherDirectory Директория лаунчера
+	 */
+	static void Cleanup(const QString &launcherDirectory)
+	{
+		QFile list(AsideListPath(launcherDirectory));
+
+		if (list.open(QIODevice::ReadOnly | QIODevice::Text))
+		{
+			bool removed = true;
+
+			for (const QByteArray &line : list.readAll().split('\n'))
+			{
+				QString path = launcherDirectory + "/" + QString::fromUtf8(line.trimmed());
+
+				//! Предыдущая копия могла еще не завершиться - тогда удалим при следующем запуске
+				if (line.trimmed().length() && QFile::exists(path) && !QFile::remove(path))
+					removed = false;
+			}
+
+			list.close();
+
+			if (removed)
+				list.remove();
+		}
+
+		QDir(StagingDirectory(launcherDirectory)).removeRecursively();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Restart Запустить новую копию лаунчера (вызывающий после этого завершается)
+	 * @param arguments Аргументы командной строки (состояние окна)
+	 * @return true если процесс запущен
+	 */
+	static bool Restart(const QStringList &arguments)
+	{
+		QString program = QCoreApplication::applicationFilePath();
+
+		//! Запускаем новый файл, даже если система сообщает путь отодвинутого
+		if (program.endsWith(AsideSuffix()))
+			program.chop(AsideSuffix().length());
+
+		return QProcess::startDetached(program, arguments, QCoreApplication::applicationDirPath());
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // SELFUPDATE_H
+//----------------------------------------------------------------------------------
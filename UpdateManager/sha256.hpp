@@ -0,0 +1,280 @@
+/**
+@file Sha256.hpp
+
+@brief Потоковый SHA-256 с поддержкой аппаратных SHA extensions
+**/
+//----------------------------------------------------------------------------------
+#ifndef SHA256_H
+#define SHA256_H
+//----------------------------------------------------------------------------------
+#include <QByteArray>
+#include <string.h>
+#include "cpufeatures.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CSha256 class
+ * Потоковое вычисление SHA-256
+ */
+class CSha256
+{
+private:
+	//! Текущее состояние
+	quint32 m_State[8];
+
+	//! Неполный блок
+	uchar m_Buffer[64];
+
+	//! Заполнение буфера
+	int m_BufferSize{ 0 };
+
+	//! Общее количество обработанных байт
+	quint64 m_Length{ 0 };
+
+	//! Использовать аппаратную реализацию
+	bool m_UseSha{ false };
+
+	//----------------------------------------------------------------------------------
+	static const quint32 *RoundConstants()
+	{
+		static const quint32 k[64] =
+		{
+			0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+			0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+			0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+			0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+			0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+			0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+			0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+			0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+		};
+
+		return k;
+	}
+
+	//----------------------------------------------------------------------------------
+	static inline quint32 Rotr(const quint32 &value, const int &bits)
+	{
+		return (value >> bits) | (value << (32 - bits));
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CompressPortable Обработка блоков без специальных инструкций
+	 * @param state Состояние
+	 * @param data Данные
+	 * @param blocks Количество 64-байтных блоков
+	 */
+	static void CompressPortable(quint32 state[8], const uchar *data, size_t blocks)
+	{
+		const quint32 *k = RoundConstants();
+
+		for (; blocks; blocks--, data += 64)
+		{
+			quint32 w[64];
+
+			for (int i = 0; i < 16; i++)
+				w[i] = ((quint32)data[i * 4] << 24) | ((quint32)data[i * 4 + 1] << 16) | ((quint32)data[i * 4 + 2] << 8) | (quint32)data[i * 4 + 3];
+
+			for (int i = 16; i < 64; i++)
+			{
+				quint32 s0 = Rotr(w[i - 15], 7) ^ Rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+				quint32 s1 = Rotr(w[i - 2], 17) ^ Rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+				w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+			}
+
+			quint32 a = state[0], b = state[1], c = state[2], d = state[3];
+			quint32 e = state[4], f = state[5], g = state[6], h = state[7];
+
+			for (int i = 0; i < 64; i++)
+			{
+				quint32 t1 = h + (Rotr(e, 6) ^ Rotr(e, 11) ^ Rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+				quint32 t2 = (Rotr(a, 2) ^ Rotr(a, 13) ^ Rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+
+				h = g;
+				g = f;
+				f = e;
+				e = d + t1;
+				d = c;
+				c = b;
+				b = a;
+				a = t1 + t2;
+			}
+
+			state[0] += a;
+			state[1] += b;
+			state[2] += c;
+			state[3] += d;
+			state[4] += e;
+			state[5] += f;
+			state[6] += g;
+			state[7] += h;
+		}
+	}
+
+#if defined(ORION_CPU_X86)
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CompressSha Обработка блоков инструкциями SHA extensions
+	 * @param state Состояние
+	 * @param data Данные
+	 * @param blocks Количество 64-байтных блоков
+	 */
+	ORION_TARGET("sha,sse4.1,ssse3")
+	static void CompressSha(quint32 state[8], const uchar *data, size_t blocks)
+	{
+		const quint32 *k = RoundConstants();
+		const __m128i mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+
+		//! Перестановка состояния в порядок ABEF/CDGH
+		__m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+		__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+		__m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+		state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+		for (; blocks; blocks--, data += 64)
+		{
+			__m128i abefSave = state0;
+			__m128i cdghSave = state1;
+			__m128i msg[4];
+
+			for (int i = 0; i < 16; i++)
+			{
+				__m128i &current = msg[i & 3];
+
+				if (i < 4)
+					current = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + i * 16)), mask);
+				else
+				{
+					const __m128i &prev = msg[(i + 3) & 3];
+
+					current = _mm_sha256msg1_epu32(current, msg[(i + 1) & 3]);
+					current = _mm_add_epi32(current, _mm_alignr_epi8(prev, msg[(i + 2) & 3], 4));
+					current = _mm_sha256msg2_epu32(current, prev);
+				}
+
+				__m128i rounds = _mm_add_epi32(current, _mm_loadu_si128((const __m128i *)&k[i * 4]));
+				state1 = _mm_sha256rnds2_epu32(state1, state0, rounds);
+				state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(rounds, 0x0E));
+			}
+
+			state0 = _mm_add_epi32(state0, abefSave);
+			state1 = _mm_add_epi32(state1, cdghSave);
+		}
+
+		//! Обратная перестановка в порядок ABCD/EFGH
+		tmp = _mm_shuffle_epi32(state0, 0x1B);
+		state1 = _mm_shuffle_epi32(state1, 0xB1);
+		state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+		state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+		_mm_storeu_si128((__m128i *)&state[0], state0);
+		_mm_storeu_si128((__m128i *)&state[4], state1);
+	}
+#endif
+
+	//----------------------------------------------------------------------------------
+	void Compress(const uchar *data, const size_t &blocks)
+	{
+#if defined(ORION_CPU_X86)
+		if (m_UseSha)
+		{
+			CompressSha(m_State, data, blocks);
+			return;
+		}
+#endif
+
+		CompressPortable(m_State, data, blocks);
+	}
+
+	//----------------------------------------------------------------------------------
+public:
+	CSha256()
+	{
+		static const quint32 iv[8] =
+		{
+			0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+		};
+
+		memcpy(m_State, iv, sizeof(m_State));
+
+		m_UseSha = CCpuFeatures::HasSha();
+	}
+
+	~CSha256() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Update Добавить данные
+	 * @param data Данные
+	 * @param size Размер данных
+	 */
+	void Update(const uchar *data, size_t size)
+	{
+		m_Length += size;
+
+		if (m_BufferSize)
+		{
+			size_t take = qMin(size, (size_t)(64 - m_BufferSize));
+			memcpy(m_Buffer + m_BufferSize, data, take);
+			m_BufferSize += (int)take;
+			data += take;
+			size -= take;
+
+			if (m_BufferSize < 64)
+				return;
+
+			Compress(m_Buffer, 1);
+			m_BufferSize = 0;
+		}
+
+		size_t blocks = size / 64;
+
+		if (blocks)
+		{
+			Compress(data, blocks);
+			data += blocks * 64;
+			size -= blocks * 64;
+		}
+
+		if (size)
+		{
+			memcpy(m_Buffer, data, size);
+			m_BufferSize = (int)size;
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Finalize Завершить вычисление
+	 * @return 32 байта хэша
+	 */
+	QByteArray Finalize()
+	{
+		quint64 bitLength = m_Length * 8;
+		uchar padding[72];
+		memset(padding, 0, sizeof(padding));
+		padding[0] = 0x80;
+
+		size_t padSize = (m_BufferSize < 56 ? 56 - m_BufferSize : 120 - m_BufferSize);
+
+		for (int i = 0; i < 8; i++)
+			padding[padSize + i] = (uchar)(bitLength >> (56 - i * 8));
+
+		Update(padding, padSize + 8);
+
+		QByteArray result(32, 0);
+
+		for (int i = 0; i < 8; i++)
+		{
+			result[i * 4] = (char)(m_State[i] >> 24);
+			result[i * 4 + 1] = (char)(m_State[i] >> 16);
+			result[i * 4 + 2] = (char)(m_State[i] >> 8);
+			result[i * 4 + 3] = (char)m_State[i];
+		}
+
+		return result;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // SHA256_H
+//----------------------------------------------------------------------------------
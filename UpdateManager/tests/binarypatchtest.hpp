@@ -0,0 +1,226 @@
+/**
+@file BinaryPatchTest.hpp
+
+@brief Применение патчей bsdiff: построенных здесь же по тройкам control, и поврежденных
+
+Патч собирается так же, как его собирает сервер: diff - разность нового и исходного файла на
+участках x, extra - новые байты участков y, блоки сжаты qCompress.
+**/
+//----------------------------------------------------------------------------------
+#ifndef BINARYPATCHTEST_H
+#define BINARYPATCHTEST_H
+//----------------------------------------------------------------------------------
+#include <QtTest>
+#include <QBuffer>
+#include "../binarypatch.hpp"
+//----------------------------------------------------------------------------------
+class CBinaryPatchTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	//----------------------------------------------------------------------------------
+	//! Число в записи bsdiff: младший байт первым, знак в старшем бите
+	static QByteArray Offset(const qint64 &value)
+	{
+		quint64 magnitude = (quint64)(value < 0 ? -value : value);
+		QByteArray result(8, 0);
+
+		for (int i = 0; i < 8; i++, magnitude >>= 8)
+			result[i] = (char)(magnitude & 0xFF);
+
+		if (value < 0)
+			result[7] = (char)(result[7] | 0x80);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Patch Построить патч
+	 * @param source Исходный файл
+	 * @param target Новый файл
+	 * @param control Тройки (x, y, z) подряд
+	 * @return Патч
+	 */
+	static QByteArray Patch(const QByteArray &source, const QByteArray &target, const QVector<qint64> &control)
+	{
+		QByteArray controlBlock;
+		QByteArray diff;
+		QByteArray extra;
+		qint64 newPosition = 0;
+		qint64 oldPosition = 0;
+
+		for (int i = 0; i + 2 < control.size(); i += 3)
+		{
+			controlBlock += Offset(control[i]) + Offset(control[i + 1]) + Offset(control[i + 2]);
+
+			for (qint64 j = 0; j < control[i]; j++)
+			{
+				qint64 oldIndex = oldPosition + j;
+				char value = target[(int)(newPosition + j)];
+
+				if (oldIndex >= 0 && oldIndex < source.size())
+					value = (char)(value - source[(int)oldIndex]);
+
+				diff.append(value);
+			}
+
+			newPosition += control[i];
+			oldPosition += control[i];
+
+			extra += target.mid((int)newPosition, (int)control[i + 1]);
+
+			newPosition += control[i + 1];
+			oldPosition += control[i + 2];
+		}
+
+		QByteArray compressedControl = qCompress(controlBlock);
+		QByteArray compressedDiff = qCompress(diff);
+
+		return QByteArray("ORPATCH1") + Offset(compressedControl.size()) + Offset(compressedDiff.size()) + Offset(target.size()) + compressedControl + compressedDiff + qCompress(extra);
+	}
+
+	//----------------------------------------------------------------------------------
+	static bool ApplyPatch(const QByteArray &source, const QByteArray &patch, QByteArray &output)
+	{
+		QBuffer buffer(&output);
+		buffer.open(QIODevice::WriteOnly);
+
+		return CBinaryPatch::Apply((const uchar *)source.constData(), source.size(), patch, buffer);
+	}
+
+private slots:
+	//----------------------------------------------------------------------------------
+	void Apply_data()
+	{
+		QTest::addColumn<QByteArray>("source");
+		QTest::addColumn<QByteArray>("target");
+		QTest::addColumn<QVector<qint64>>("control");
+
+		QTest::newRow("diff and extra")
+			<< QByteArray("The quick brown fox jumps over the lazy dog")
+			<< QByteArray("The quick brown cat jumps over the LAZY dog!!")
+			<< (QVector<qint64>() << 16 << 3 << 3 << 24 << 2 << 0);
+
+		QTest::newRow("seek back")
+			<< QByteArray("abcdef")
+			<< QByteArray("abcabcdef")
+			<< (QVector<qint64>() << 3 << 0 << -3 << 6 << 0 << 0);
+
+		QTest::newRow("beyond source")
+			<< QByteArray("abc")
+			<< QByteArray("abcdef")
+			<< (QVector<qint64>() << 6 << 0 << 0);
+
+		QTest::newRow("extra only")
+			<< QByteArray("old")
+			<< QByteArray("entirely new")
+			<< (QVector<qint64>() << 0 << 12 << 0);
+
+		QTest::newRow("empty target")
+			<< QByteArray("old")
+			<< QByteArray()
+			<< QVector<qint64>();
+	}
+
+	//----------------------------------------------------------------------------------
+	void Apply()
+	{
+		QFETCH(QByteArray, source);
+		QFETCH(QByteArray, target);
+		QFETCH(QVector<qint64>, control);
+
+		QByteArray output;
+
+		QVERIFY(ApplyPatch(source, Patch(source, target, control), output));
+		QCOMPARE(output, target);
+	}
+
+	//----------------------------------------------------------------------------------
+	void RejectDamaged()
+	{
+		QByteArray source("The quick brown fox jumps over the lazy dog");
+		QByteArray target("The quick brown cat jumps over the LAZY dog!!");
+		QByteArray patch = Patch(source, target, QVector<qint64>() << 16 << 3 << 3 << 24 << 2 << 0);
+		QByteArray output;
+
+		QVERIFY(!ApplyPatch(source, patch.left(31), output));
+
+		QByteArray damaged = patch;
+		damaged[0] = 'X';
+		QVERIFY(!ApplyPatch(source, damaged, output));
+
+		//! Блок extra обрезан
+		QVERIFY(!ApplyPatch(source, patch.left(patch.size() - 1), output));
+
+		//! Размер нового файла меньше, чем описывает control
+		damaged = patch;
+		damaged.replace(24, 8, Offset(40));
+		QVERIFY(!ApplyPatch(source, damaged, output));
+
+		//! Control кончился раньше нового файла
+		damaged = patch;
+		damaged.replace(24, 8, Offset(target.size() + 1));
+		QVERIFY(!ApplyPatch(source, damaged, output));
+
+		//! Длина блока control за концом патча
+		damaged = patch;
+		damaged.replace(8, 8, Offset(patch.size()));
+		QVERIFY(!ApplyPatch(source, damaged, output));
+	}
+
+	//----------------------------------------------------------------------------------
+	void RejectOverBudget()
+	{
+		QByteArray source("abc");
+		QByteArray patch = Patch(source, QByteArray("abcdef"), QVector<qint64>() << 6 << 0 << 0);
+		QByteArray output;
+
+		//! Заголовок qCompress блока control обещает больше, чем можно развернуть
+		patch[32] = (char)0x7F;
+
+		QVERIFY(!ApplyPatch(source, patch, output));
+	}
+
+	//----------------------------------------------------------------------------------
+	void ApplyFile()
+	{
+		QTemporaryDir directory;
+		QVERIFY(directory.isValid());
+
+		QByteArray source("The quick brown fox jumps over the lazy dog");
+		QByteArray target("The quick brown cat jumps over the LAZY dog!!");
+		QByteArray patch = Patch(source, target, QVector<qint64>() << 16 << 3 << 3 << 24 << 2 << 0);
+
+		QFile sourceFile(directory.filePath("source"));
+		QVERIFY(sourceFile.open(QIODevice::WriteOnly));
+		sourceFile.write(source);
+		sourceFile.close();
+
+		QFile patchFile(directory.filePath("patch"));
+		QVERIFY(patchFile.open(QIODevice::WriteOnly));
+		patchFile.write(patch);
+		patchFile.close();
+
+		QString outputPath = directory.filePath("output");
+
+		QVERIFY(CBinaryPatch::ApplyFile(sourceFile.fileName(), patchFile.fileName(), outputPath));
+
+		QFile output(outputPath);
+		QVERIFY(output.open(QIODevice::ReadOnly));
+		QCOMPARE(output.readAll(), target);
+		output.close();
+
+		//! Поврежденный патч не оставляет результата
+		QVERIFY(patchFile.open(QIODevice::WriteOnly));
+		patchFile.write(patch.left(patch.size() - 1));
+		patchFile.close();
+
+		QVERIFY(!CBinaryPatch::ApplyFile(sourceFile.fileName(), patchFile.fileName(), outputPath));
+		QVERIFY(!QFile::exists(outputPath));
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // BINARYPATCHTEST_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,155 @@
+/**
+@file BlockSyncTest.hpp
+
+@brief Поиск блоков карты в локальном файле: сдвиг, измененный блок, короткий последний блок
+
+Карта строится здесь же по формату BlockSync.hpp (скользящая сумма и первые 16 байт BLAKE3).
+**/
+//----------------------------------------------------------------------------------
+#ifndef BLOCKSYNCTEST_H
+#define BLOCKSYNCTEST_H
+//----------------------------------------------------------------------------------
+#include <QtTest>
+#include "../blocksync.hpp"
+//----------------------------------------------------------------------------------
+class CBlockSyncTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	enum { BLOCK_SIZE = 64 };
+
+	//----------------------------------------------------------------------------------
+	//! Данные без повторяющихся блоков
+	static QByteArray Random(const int &size, quint32 seed)
+	{
+		QByteArray data(size, 0);
+
+		for (int i = 0; i < size; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			data[i] = (char)(seed >> 16);
+		}
+
+		return data;
+	}
+
+	//----------------------------------------------------------------------------------
+	static QByteArray Number(quint64 value, const int &size)
+	{
+		QByteArray result(size, 0);
+
+		for (int i = 0; i < size; i++, value >>= 8)
+			result[i] = (char)(value & 0xFF);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	static CBlockMap Map(const QByteArray &file, const int &blockSize)
+	{
+		QByteArray data = QByteArray("ORBLKMAP") + Number(blockSize, 4) + Number(file.size(), 8);
+
+		for (int offset = 0; offset < file.size(); offset += blockSize)
+		{
+			const uchar *block = (const uchar *)file.constData() + offset;
+			int length = qMin(blockSize, file.size() - offset);
+
+			data += Number(CBlockSync::Rolling(block, length), 4);
+			data += CBlake3::Hash(block, length).left(CBlockMap::STRONG_SIZE);
+		}
+
+		CBlockMap map;
+		map.Parse(data);
+
+		return map;
+	}
+
+	//----------------------------------------------------------------------------------
+	static QVector<qint64> Match(const QByteArray &local, const CBlockMap &map)
+	{
+		return CBlockSync::Match((const uchar *)local.constData(), local.size(), map);
+	}
+
+private slots:
+	//----------------------------------------------------------------------------------
+	void Parse()
+	{
+		QByteArray file = Random(BLOCK_SIZE * 4 + 20, 1);
+		CBlockMap map = Map(file, BLOCK_SIZE);
+
+		QCOMPARE(map.Count(), 5);
+		QCOMPARE(map.BlockSize(), (qint64)BLOCK_SIZE);
+		QCOMPARE(map.FileSize(), (qint64)file.size());
+		QCOMPARE(map.BlockLength(4), (qint64)20);
+
+		//! Записей меньше, чем блоков в файле
+		QByteArray data = QByteArray("ORBLKMAP") + Number(BLOCK_SIZE, 4) + Number(file.size(), 8) + QByteArray(20 * 4, 0);
+		QVERIFY(!map.Parse(data));
+		QVERIFY(!map.Parse(QByteArray("ORBLKMAP")));
+		QVERIFY(!map.Parse(QByteArray("ORBLKMAP") + Number(0, 4) + Number(0, 8)));
+	}
+
+	//----------------------------------------------------------------------------------
+	void Rolling()
+	{
+		//! Сумма, сдвинутая на байт, совпадает с посчитанной заново (так ее сдвигает Match)
+		QByteArray data = Random(BLOCK_SIZE + 1, 2);
+		const uchar *bytes = (const uchar *)data.constData();
+
+		quint32 sum = CBlockSync::Rolling(bytes, BLOCK_SIZE);
+		quint32 a = sum & 0xFFFF;
+		quint32 b = sum >> 16;
+
+		a = (a - bytes[0] + bytes[BLOCK_SIZE]) & 0xFFFF;
+		b = (b - (quint32)BLOCK_SIZE * bytes[0] + a) & 0xFFFF;
+
+		QCOMPARE(a | (b << 16), CBlockSync::Rolling(bytes + 1, BLOCK_SIZE));
+	}
+
+	//----------------------------------------------------------------------------------
+	void MatchSame()
+	{
+		QByteArray file = Random(BLOCK_SIZE * 4 + 20, 3);
+
+		QCOMPARE(Match(file, Map(file, BLOCK_SIZE)), QVector<qint64>() << 0 << 64 << 128 << 192 << 256);
+	}
+
+	//----------------------------------------------------------------------------------
+	void MatchShifted()
+	{
+		QByteArray file = Random(BLOCK_SIZE * 4 + 20, 4);
+		CBlockMap map = Map(file, BLOCK_SIZE);
+
+		//! Перед данными вставлены 3 байта, блок 2 изменен: блок 3 находится скользящей суммой,
+		//! короткий последний - в конце файла
+		QByteArray local = QByteArray("xyz") + file;
+		local[3 + 2 * BLOCK_SIZE + 10] = (char)(local[3 + 2 * BLOCK_SIZE + 10] ^ 0xFF);
+
+		QCOMPARE(Match(local, map), QVector<qint64>() << 3 << 67 << -1 << 195 << 259);
+	}
+
+	//----------------------------------------------------------------------------------
+	void MatchMissing()
+	{
+		QByteArray file = Random(BLOCK_SIZE * 2, 5);
+		CBlockMap map = Map(file, BLOCK_SIZE);
+
+		QCOMPARE(Match(Random(BLOCK_SIZE * 2, 6), map), QVector<qint64>() << -1 << -1);
+		QCOMPARE(Match(file.left(BLOCK_SIZE - 1), map), QVector<qint64>() << -1 << -1);
+		QCOMPARE(Match(QByteArray(), map), QVector<qint64>() << -1 << -1);
+	}
+
+	//----------------------------------------------------------------------------------
+	void MatchRepeated()
+	{
+		//! Одинаковые блоки берутся из одного места
+		QByteArray block = Random(BLOCK_SIZE, 7);
+		QByteArray file = block + block + block;
+
+		QCOMPARE(Match(block, Map(file, BLOCK_SIZE)), QVector<qint64>() << 0 << 0 << 0);
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // BLOCKSYNCTEST_H
+//----------------------------------------------------------------------------------
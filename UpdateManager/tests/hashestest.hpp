@@ -0,0 +1,134 @@
+/**
+@file HashesTest.hpp
+
+@brief Контрольные суммы: CRC32, SHA-256 и BLAKE3 на известных значениях
+
+Значения BLAKE3 - из эталонной реализации (входные данные как в ее тестах: байт i равен i % 251).
+Длины выбраны у границ фрагмента (1024 байта); 3 МБ - несколько поддеревьев, они считаются в пуле потоков.
+**/
+//----------------------------------------------------------------------------------
+#ifndef HASHESTEST_H
+#define HASHESTEST_H
+//----------------------------------------------------------------------------------
+#include <QtTest>
+#include "../hashcalculator.hpp"
+//----------------------------------------------------------------------------------
+class CHashesTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	//----------------------------------------------------------------------------------
+	static QByteArray Pattern(const int &size)
+	{
+		QByteArray data(size, 0);
+
+		for (int i = 0; i < size; i++)
+			data[i] = (char)(i % 251);
+
+		return data;
+	}
+
+	//----------------------------------------------------------------------------------
+	static QString Hash(const QByteArray &data, const HASH_ALGORITHM &algorithm)
+	{
+		return CHashCalculator::HashData((const uchar *)data.constData(), data.size(), algorithm);
+	}
+
+private slots:
+	//----------------------------------------------------------------------------------
+	void Crc32()
+	{
+		QCOMPARE(Hash(QByteArray("123456789"), HA_CRC32), QString("CBF43926"));
+		QCOMPARE(Hash(Pattern(1000), HA_CRC32), QString("721746A6"));
+		QCOMPARE(Hash(QByteArray(), HA_CRC32), QString("00000000"));
+	}
+
+	//----------------------------------------------------------------------------------
+	void Sha256()
+	{
+		QCOMPARE(Hash(QByteArray(), HA_SHA256), QString("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"));
+		QCOMPARE(Hash(QByteArray("abc"), HA_SHA256), QString("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+		QCOMPARE(Hash(QByteArray("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"), HA_SHA256), QString("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+		QCOMPARE(Hash(Pattern(1000), HA_SHA256), QString("4e4c294b331f7a2099a379bec34b9f9fc03dc46ab465d998f4d683da53487e6d"));
+	}
+
+	//----------------------------------------------------------------------------------
+	void Sha256Parts()
+	{
+		QByteArray data = Pattern(1000);
+		CSha256 sha;
+
+		//! Части разной длины проходят через буфер неполного блока
+		for (int position = 0, step = 1; position < data.size(); position += step, step = step * 2 + 1)
+			sha.Update((const uchar *)data.constData() + position, (size_t)qMin(step, data.size() - position));
+
+		QCOMPARE(QString::fromLatin1(sha.Finalize().toHex()), QString("4e4c294b331f7a2099a379bec34b9f9fc03dc46ab465d998f4d683da53487e6d"));
+	}
+
+	//----------------------------------------------------------------------------------
+	void Blake3_data()
+	{
+		QTest::addColumn<int>("size");
+		QTest::addColumn<QString>("hash");
+
+		QTest::newRow("empty") << 0 << QString("af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262");
+		QTest::newRow("3") << 3 << QString("e1be4d7a8ab5560aa4199eea339849ba8e293d55ca0a81006726d184519e647f");
+		QTest::newRow("1024") << 1024 << QString("42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7");
+		QTest::newRow("1025") << 1025 << QString("d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444");
+		QTest::newRow("4096") << 4096 << QString("015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969");
+		QTest::newRow("65537") << 65537 << QString("7c99f9840a73dfcb6e5bfe4ff6d1558acab7e015640790c26411818bdbe17eca");
+		QTest::newRow("3M+7") << (3 * 1024 * 1024 + 7) << QString("8f3f67e881a256c8a2cc45cce1a0b500a1dd0500623fe5363fe7f77518267c5a");
+	}
+
+	//----------------------------------------------------------------------------------
+	void Blake3()
+	{
+		QFETCH(int, size);
+		QFETCH(QString, hash);
+
+		QByteArray data = Pattern(size);
+
+		QCOMPARE(Hash(data, HA_BLAKE3), hash);
+
+		//! Без пула потоков результат тот же
+		QCOMPARE(QString::fromLatin1(CBlake3::Hash((const uchar *)data.constData(), data.size(), false).toHex()), hash);
+	}
+
+	//----------------------------------------------------------------------------------
+	void HashFileStopped()
+	{
+		QTemporaryDir directory;
+		QVERIFY(directory.isValid());
+
+		QByteArray data = Pattern(3 * 1024 * 1024 + 7);
+		QFile file(directory.filePath("data"));
+		QVERIFY(file.open(QIODevice::WriteOnly));
+		file.write(data);
+		file.close();
+		QVERIFY(file.open(QIODevice::ReadOnly));
+
+		//! По частям с проверкой отмены - тот же результат, что и целиком
+		COperation operation;
+
+		QCOMPARE(CHashCalculator::HashFile(file, HA_BLAKE3, nullptr, &operation), Hash(data, HA_BLAKE3));
+		QCOMPARE(CHashCalculator::HashFile(file, HA_SHA256, nullptr, &operation), Hash(data, HA_SHA256));
+		QCOMPARE(CHashCalculator::HashFile(file, HA_CRC32, nullptr, &operation), Hash(data, HA_CRC32));
+
+		operation.Cancel();
+
+		QCOMPARE(CHashCalculator::HashFile(file, HA_BLAKE3, nullptr, &operation), QString(""));
+		QCOMPARE(CHashCalculator::HashFile(file, HA_SHA256, nullptr, &operation), QString(""));
+
+		file.close();
+	}
+
+	//----------------------------------------------------------------------------------
+	void Blake3Text()
+	{
+		QCOMPARE(Hash(QByteArray("abc"), HA_BLAKE3), QString("6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85"));
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // HASHESTEST_H
+//----------------------------------------------------------------------------------
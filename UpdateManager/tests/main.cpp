@@ -0,0 +1,38 @@
+/**
+@file main.cpp
+
+@brief Модульные тесты компонентов UpdateManager, не требующих сети и интерфейса
+**/
+//----------------------------------------------------------------------------------
+#include <QCoreApplication>
+#include <QtTest>
+#include "hashestest.hpp"
+#include "peversionreadertest.hpp"
+#include "binarypatchtest.hpp"
+#include "blocksynctest.hpp"
+#include "progressqueuetest.hpp"
+//----------------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	QCoreApplication application(argc, argv);
+
+	int result = 0;
+
+	CHashesTest hashes;
+	result |= QTest::qExec(&hashes, argc, argv);
+
+	CPEVersionReaderTest peVersionReader;
+	result |= QTest::qExec(&peVersionReader, argc, argv);
+
+	CBinaryPatchTest binaryPatch;
+	result |= QTest::qExec(&binaryPatch, argc, argv);
+
+	CBlockSyncTest blockSync;
+	result |= QTest::qExec(&blockSync, argc, argv);
+
+	CProgressQueueTest progressQueue;
+	result |= QTest::qExec(&progressQueue, argc, argv);
+
+	return result;
+}
+//----------------------------------------------------------------------------------
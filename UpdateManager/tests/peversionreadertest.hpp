@@ -0,0 +1,209 @@
+/**
+@file PEVersionReaderTest.hpp
+
+@brief Чтение версии из синтетического PE образа (PE32 и PE32+) и отказ на поврежденных образах
+
+Образ содержит одну секцию .rsrc (RVA 0x1000, в файле с 0x200) с каталогом ресурсов
+RT_VERSION -> 1 -> 0x409 и VS_VERSIONINFO версии 1.2.3.4.
+**/
+//----------------------------------------------------------------------------------
+#ifndef PEVERSIONREADERTEST_H
+#define PEVERSIONREADERTEST_H
+//----------------------------------------------------------------------------------
+#include <QtTest>
+#include "../peversionreader.hpp"
+//----------------------------------------------------------------------------------
+class CPEVersionReaderTest : public QObject
+{
+	Q_OBJECT
+
+private:
+	enum
+	{
+		PE_OFFSET = 0x80,
+		SECTION_RVA = 0x1000,
+		SECTION_OFFSET = 0x200,
+		SECTION_SIZE = 0x200,
+		IMAGE_SIZE = SECTION_OFFSET + SECTION_SIZE
+	};
+
+	//----------------------------------------------------------------------------------
+	static void Put16(QByteArray &image, const int &offset, const quint16 &value)
+	{
+		qToLittleEndian<quint16>(value, (uchar *)image.data() + offset);
+	}
+
+	static void Put32(QByteArray &image, const int &offset, const quint32 &value)
+	{
+		qToLittleEndian<quint32>(value, (uchar *)image.data() + offset);
+	}
+
+	//----------------------------------------------------------------------------------
+	static QByteArray Image(const bool &pe32plus)
+	{
+		QByteArray image(IMAGE_SIZE, 0);
+
+		//! IMAGE_DOS_HEADER
+		image[0] = 'M';
+		image[1] = 'Z';
+		Put32(image, 0x3C, PE_OFFSET);
+
+		//! Сигнатура и IMAGE_FILE_HEADER
+		int optionalSize = (pe32plus ? 0xF0 : 0xE0);
+
+		Put32(image, PE_OFFSET, 0x00004550);
+		Put16(image, PE_OFFSET + 4, (pe32plus ? 0x8664 : 0x014C));
+		Put16(image, PE_OFFSET + 6, 1);
+		Put16(image, PE_OFFSET + 20, optionalSize);
+
+		//! IMAGE_OPTIONAL_HEADER: количество каталогов и каталог ресурсов (индекс 2)
+		int optional = PE_OFFSET + 24;
+		int directories = optional + (pe32plus ? 108 : 92);
+
+		Put16(image, optional, (pe32plus ? 0x20B : 0x10B));
+		Put32(image, directories, 16);
+		Put32(image, directories + 4 + 2 * 8, SECTION_RVA);
+		Put32(image, directories + 4 + 2 * 8 + 4, SECTION_SIZE);
+
+		//! IMAGE_SECTION_HEADER
+		int section = optional + optionalSize;
+
+		memcpy(image.data() + section, ".rsrc", 5);
+		Put32(image, section + 8, SECTION_SIZE);
+		Put32(image, section + 12, SECTION_RVA);
+		Put32(image, section + 16, SECTION_SIZE);
+		Put32(image, section + 20, SECTION_OFFSET);
+
+		//! Каталоги ресурсов: тип, имя, язык (по одной числовой записи)
+		int base = SECTION_OFFSET;
+
+		Put16(image, base + 14, 1);
+		Put32(image, base + 16, 16);
+		Put32(image, base + 20, 0x80000000 | 0x18);
+
+		Put16(image, base + 0x18 + 14, 1);
+		Put32(image, base + 0x28, 1);
+		Put32(image, base + 0x2C, 0x80000000 | 0x30);
+
+		Put16(image, base + 0x30 + 14, 1);
+		Put32(image, base + 0x40, 0x409);
+		Put32(image, base + 0x44, 0x48);
+
+		//! IMAGE_RESOURCE_DATA_ENTRY
+		Put32(image, base + 0x48, SECTION_RVA + 0x60);
+		Put32(image, base + 0x4C, 92);
+
+		//! VS_VERSIONINFO: заголовок, L"VS_VERSION_INFO", выравнивание до 4, VS_FIXEDFILEINFO
+		int info = base + 0x60;
+		const char *key = "VS_VERSION_INFO";
+
+		Put16(image, info, 92);
+		Put16(image, info + 2, 52);
+
+		for (int i = 0; key[i]; i++)
+			Put16(image, info + 6 + i * 2, (quint16)key[i]);
+
+		Put32(image, info + 40, 0xFEEF04BD);
+		Put32(image, info + 40 + 4, 0x00010000);
+		Put32(image, info + 40 + 8, 0x00010002);
+		Put32(image, info + 40 + 12, 0x00030004);
+
+		return image;
+	}
+
+	//----------------------------------------------------------------------------------
+	static bool Read(const QByteArray &image, QString &version)
+	{
+		quint16 parts[4] = { 0, 0, 0, 0 };
+
+		if (!CPEVersionReader::ReadVersion((const uchar *)image.constData(), image.size(), parts))
+			return false;
+
+		version = QString("%1.%2.%3.%4").arg(parts[0]).arg(parts[1]).arg(parts[2]).arg(parts[3]);
+
+		return true;
+	}
+
+private slots:
+	//----------------------------------------------------------------------------------
+	void ReadVersion_data()
+	{
+		QTest::addColumn<bool>("pe32plus");
+
+		QTest::newRow("PE32") << false;
+		QTest::newRow("PE32+") << true;
+	}
+
+	//----------------------------------------------------------------------------------
+	void ReadVersion()
+	{
+		QFETCH(bool, pe32plus);
+
+		QString version;
+
+		QVERIFY(Read(Image(pe32plus), version));
+		QCOMPARE(version, QString("1.2.3.4"));
+	}
+
+	//----------------------------------------------------------------------------------
+	void ReadFileVersion()
+	{
+		QTemporaryDir directory;
+		QVERIFY(directory.isValid());
+
+		QFile file(directory.filePath("client.exe"));
+		QVERIFY(file.open(QIODevice::WriteOnly));
+		file.write(Image(false));
+		file.close();
+
+		QString version;
+
+		QVERIFY(CPEVersionReader::ReadFileVersion(file.fileName(), version));
+		QCOMPARE(version, QString("1.2.3.4"));
+	}
+
+	//----------------------------------------------------------------------------------
+	void RejectDamaged()
+	{
+		QString version;
+		QByteArray image = Image(false);
+
+		QVERIFY(!Read(QByteArray(), version));
+
+		//! Обрезанный образ: ресурсы за концом файла
+		QVERIFY(!Read(image.left(SECTION_OFFSET), version));
+
+		//! Не PE
+		QByteArray damaged = image;
+		damaged[0] = 'X';
+		QVERIFY(!Read(damaged, version));
+
+		//! Заголовок PE за концом файла
+		damaged = image;
+		Put32(damaged, 0x3C, IMAGE_SIZE);
+		QVERIFY(!Read(damaged, version));
+
+		//! Слишком много секций
+		damaged = image;
+		Put16(damaged, PE_OFFSET + 6, 0xFFFF);
+		QVERIFY(!Read(damaged, version));
+
+		//! Нет RT_VERSION
+		damaged = image;
+		Put32(damaged, SECTION_OFFSET + 16, 3);
+		QVERIFY(!Read(damaged, version));
+
+		//! Каталог ссылается за пределы секции
+		damaged = image;
+		Put32(damaged, SECTION_OFFSET + 20, 0x80000000 | 0x7FFFFFF0);
+		QVERIFY(!Read(damaged, version));
+
+		//! Неверная сигнатура VS_FIXEDFILEINFO
+		damaged = image;
+		Put32(damaged, SECTION_OFFSET + 0x60 + 40, 0);
+		QVERIFY(!Read(damaged, version));
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // PEVERSIONREADERTEST_H
+//----------------------------------------------------------------------------------
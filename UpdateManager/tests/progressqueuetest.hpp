@@ -0,0 +1,172 @@
+/**
+@file ProgressQueueTest.hpp
+
+@brief Очередь без блокировок: порядок, переполнение, переход через конец кольца, несколько писателей;
+очередь прогресса: последнее значение операции при переполнении, операции не смешиваются
+**/
+//----------------------------------------------------------------------------------
+#ifndef PROGRESSQUEUETEST_H
+#define PROGRESSQUEUETEST_H
+//----------------------------------------------------------------------------------
+#include <QtTest>
+#include <QtConcurrent>
+#include "../progressqueue.hpp"
+//----------------------------------------------------------------------------------
+class CProgressQueueTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	//----------------------------------------------------------------------------------
+	void Overflow()
+	{
+		CMpscQueue<int, 4> queue;
+		int value = 0;
+
+		QVERIFY(!queue.Pop(value));
+
+		for (int i = 0; i < 4; i++)
+			QVERIFY(queue.Push(i));
+
+		QVERIFY(!queue.Push(4));
+
+		for (int i = 0; i < 4; i++)
+		{
+			QVERIFY(queue.Pop(value));
+			QCOMPARE(value, i);
+		}
+
+		QVERIFY(!queue.Pop(value));
+	}
+
+	//----------------------------------------------------------------------------------
+	void Wraparound()
+	{
+		CMpscQueue<int, 4> queue;
+		int next = 0;
+		int expected = 0;
+		int value = 0;
+
+		//! Чтение отстает от записи на 1-3 элемента, позиции много раз проходят конец кольца
+		for (int round = 0; round < 100; round++)
+		{
+			while (queue.Push(next))
+				next++;
+
+			QCOMPARE(next - expected, 4);
+
+			for (int i = 0; i < 1 + round % 3; i++)
+			{
+				QVERIFY(queue.Pop(value));
+				QCOMPARE(value, expected++);
+			}
+		}
+
+		while (queue.Pop(value))
+			QCOMPARE(value, expected++);
+
+		QCOMPARE(expected, next);
+	}
+
+	//----------------------------------------------------------------------------------
+	void ManyWriters()
+	{
+		enum { WRITERS = 4, COUNT = 20000 };
+
+		QScopedPointer<CMpscQueue<int, 256>> queue(new CMpscQueue<int, 256>());
+		CMpscQueue<int, 256> *queuePointer = queue.data();
+		QList<QFuture<void>> writers;
+
+		for (int writer = 0; writer < WRITERS; writer++)
+		{
+			writers.push_back(QtConcurrent::run([queuePointer, writer]()
+			{
+				for (int i = 0; i < COUNT; i++)
+				{
+					while (!queuePointer->Push(writer * COUNT + i))
+						QThread::yieldCurrentThread();
+				}
+			}));
+		}
+
+		//! Каждый писатель виден читателю в своем порядке, ни одно значение не теряется
+		QVector<int> last(WRITERS, -1);
+		bool ordered = true;
+		int received = 0;
+		int value = 0;
+
+		while (received < WRITERS * COUNT)
+		{
+			if (!queue->Pop(value))
+			{
+				QThread::yieldCurrentThread();
+				continue;
+			}
+
+			int writer = value / COUNT;
+
+			ordered = (ordered && value % COUNT > last[writer]);
+			last[writer] = value % COUNT;
+			received++;
+		}
+
+		for (QFuture<void> &writer : writers)
+			writer.waitForFinished();
+
+		QVERIFY(ordered);
+		QVERIFY(!queue->Pop(value));
+	}
+
+	//----------------------------------------------------------------------------------
+	void LatestPerOperation()
+	{
+		QScopedPointer<CProgressQueue> queue(new CProgressQueue());
+		QHash<quint32, CProgressEvent> latest;
+
+		queue->Publish(CProgressEvent(1, 100, 1000));
+		queue->Publish(CProgressEvent(2, 10, 50));
+		queue->Publish(CProgressEvent(2, 20, 70));
+		queue->Publish(CProgressEvent(3, -1, 5));
+
+		QCOMPARE(queue->Drain(latest), 4);
+		QCOMPARE(latest.size(), 3);
+
+		//! Завершенная операция не поднимает прогресс другой
+		QCOMPARE(latest[1].Percent, 100);
+		QCOMPARE(latest[2].Percent, 20);
+		QCOMPARE(latest[2].Bytes, (qint64)70);
+		QCOMPARE(latest[3].Percent, -1);
+
+		latest.clear();
+		QCOMPARE(queue->Drain(latest), 0);
+		QVERIFY(latest.isEmpty());
+	}
+
+	//----------------------------------------------------------------------------------
+	void OverflowKeepsLatest()
+	{
+		QScopedPointer<CProgressQueue> queue(new CProgressQueue());
+		QHash<quint32, CProgressEvent> latest;
+
+		//! Очередь заполнена ранними событиями, последние уходят в ячейку переполнения
+		for (int i = 0; i < 1024; i++)
+			queue->Publish(CProgressEvent(7, 1, i));
+
+		queue->Publish(CProgressEvent(7, 50, 2000));
+		queue->Publish(CProgressEvent(7, 99, 3000));
+
+		QCOMPARE(queue->Drain(latest), 1025);
+		QCOMPARE(latest.size(), 1);
+		QCOMPARE(latest[7].Percent, 99);
+
+		//! После чтения очередь снова принимает события
+		latest.clear();
+		queue->Publish(CProgressEvent(8, 5, 10));
+
+		QCOMPARE(queue->Drain(latest), 1);
+		QCOMPARE(latest[8].Percent, 5);
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // PROGRESSQUEUETEST_H
+//----------------------------------------------------------------------------------
@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Unit tests of the UpdateManager components
+# that need neither network nor interface
+#
+#-------------------------------------------------
+
+QT       += core concurrent testlib
+QT       -= gui
+
+CONFIG   += c++11
+
+# The tested headers are portable; only the operation
+# cancel path closes WinINet handles on Windows
+win32: LIBS += -lwininet
+
+TARGET = UpdateManagerTests
+TEMPLATE = app
+CONFIG += console testcase
+CONFIG -= app_bundle
+
+SOURCES += $$PWD/main.cpp
+
+HEADERS += \
+    $$PWD/hashestest.hpp \
+    $$PWD/peversionreadertest.hpp \
+    $$PWD/binarypatchtest.hpp \
+    $$PWD/blocksynctest.hpp \
+    $$PWD/progressqueuetest.hpp
@@ -0,0 +1,323 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+Построение бинарного патча ORPATCH1 (формат - BinaryPatch.hpp) для манифеста сервера обновлений.
+
+Разность строится по схеме bsdiff (суффиксный массив исходного файла, приблизительные совпадения),
+блоки сжимаются так же, как qCompress: 4 байта размера (старший первым) и поток zlib.
+
+    makepatch.py <исходный файл> <новый файл> <патч> [--hashalgo crc32|sha256|blake3]
+
+После записи выводится элемент <patch> для манифеста. Нужен только Python 3; для BLAKE3 -
+пакет blake3. Поиск написан на Python и рассчитан на файлы в десятки мегабайт: для больших
+файлов лаунчер использует поблочную синхронизацию (BlockSync.hpp), а патч все равно
+отверг бы по MAX_EXPANDED_SIZE.
+"""
+import argparse
+import hashlib
+import os
+import struct
+import sys
+import zlib
+
+#! Как MAX_EXPANDED_SIZE в BinaryPatch.hpp: больший патч лаунчер не применяет
+MAX_EXPANDED_SIZE = 128 * 1024 * 1024
+
+
+def offset(value):
+    """Число в записи bsdiff: младший байт первым, знак в старшем бите."""
+    data = bytearray(struct.pack('<Q', abs(value)))
+
+    if value < 0:
+        data[7] |= 0x80
+
+    return bytes(data)
+
+
+def qcompress(data):
+    """Блок в формате qCompress (пустые данные - один заголовок)."""
+    if not data:
+        return b'\0\0\0\0'
+
+    return struct.pack('>I', len(data)) + zlib.compress(data)
+
+
+def suffix_array(data):
+    """Суффиксный массив с пустым суффиксом (удвоением префиксов, досортировываются только группы равных)."""
+    size = len(data)
+    length = 8
+    index = sorted(range(size + 1), key=lambda i: data[i:i + length])
+
+    #! Ранг суффикса - начало его группы в массиве; группы из нескольких суффиксов еще не упорядочены
+    rank = [0] * (size + 1)
+    groups = []
+    start = 0
+
+    for i in range(1, size + 2):
+        if i == size + 1 or data[index[i]:index[i] + length] != data[index[start]:index[start] + length]:
+            for j in range(start, i):
+                rank[index[j]] = start
+
+            if i - start > 1:
+                groups.append((start, i))
+
+            start = i
+
+    while groups:
+        #! Суффиксы группы совпадают в первых length байтах, порядок задает ранг суффикса через length
+        keys = {}
+
+        for start, end in groups:
+            for j in range(start, end):
+                keys[index[j]] = rank[index[j] + length]
+
+        split = []
+
+        for start, end in groups:
+            index[start:end] = sorted(index[start:end], key=keys.__getitem__)
+            first = start
+
+            for i in range(start + 1, end + 1):
+                if i == end or keys[index[i]] != keys[index[first]]:
+                    for j in range(first, i):
+                        rank[index[j]] = first
+
+                    if i - first > 1:
+                        split.append((first, i))
+
+                    first = i
+
+        groups = split
+        length *= 2
+
+    return index
+
+
+def match_length(old, old_position, new, new_position):
+    """Длина общего начала old[old_position:] и new[new_position:]."""
+    length = 0
+    window = 64
+    limit = min(len(old) - old_position, len(new) - new_position)
+
+    #! Сначала сравниваются растущие окна, потом побайтно внутри первого различающегося
+    while length < limit:
+        count = min(window, limit - length)
+
+        if old[old_position + length:old_position + length + count] != new[new_position + length:new_position + length + count]:
+            break
+
+        length += count
+        window *= 2
+
+    while length < limit and old[old_position + length] == new[new_position + length]:
+        length += 1
+
+    return length
+
+
+def less(old, old_position, new, new_position):
+    """old[old_position:] < new[new_position:] (как memcmp в bsdiff)."""
+    length = match_length(old, old_position, new, new_position)
+    limit = min(len(old) - old_position, len(new) - new_position)
+
+    if length == limit:
+        return False
+
+    return old[old_position + length] < new[new_position + length]
+
+
+def search(index, old, new, new_position):
+    """Самое длинное совпадение new[new_position:] в исходном файле: (длина, позиция)."""
+    start = 0
+    end = len(old)
+
+    while end - start >= 2:
+        middle = start + (end - start) // 2
+
+        if less(old, index[middle], new, new_position):
+            start = middle
+        else:
+            end = middle
+
+    first = match_length(old, index[start], new, new_position)
+    second = match_length(old, index[end], new, new_position)
+
+    if first > second:
+        return first, index[start]
+
+    return second, index[end]
+
+
+def diff(old, new):
+    """Тройки control, блок diff и блок extra (алгоритм bsdiff 4)."""
+    index = suffix_array(old)
+    old_size = len(old)
+    new_size = len(new)
+
+    control = bytearray()
+    diff_block = bytearray()
+    extra_block = bytearray()
+
+    scan = 0
+    length = 0
+    position = 0
+    last_scan = 0
+    last_position = 0
+    last_offset = 0
+
+    while scan < new_size:
+        old_score = 0
+        scan += length
+        scsc = scan
+
+        while scan < new_size:
+            length, position = search(index, old, new, scan)
+
+            while scsc < scan + length:
+                if scsc + last_offset < old_size and old[scsc + last_offset] == new[scsc]:
+                    old_score += 1
+
+                scsc += 1
+
+            if (length == old_score and length != 0) or length > old_score + 8:
+                break
+
+            if scan + last_offset < old_size and old[scan + last_offset] == new[scan]:
+                old_score -= 1
+
+            scan += 1
+
+        if length == old_score and scan != new_size:
+            continue
+
+        #! Продление вперед от прошлого совпадения
+        score = 0
+        best = 0
+        forward = 0
+        i = 0
+
+        while last_scan + i < scan and last_position + i < old_size:
+            if old[last_position + i] == new[last_scan + i]:
+                score += 1
+
+            i += 1
+
+            if score * 2 - i > best * 2 - forward:
+                best = score
+                forward = i
+
+        #! Продление назад от нового совпадения
+        backward = 0
+
+        if scan < new_size:
+            score = 0
+            best = 0
+            i = 1
+
+            while scan >= last_scan + i and position >= i:
+                if old[position - i] == new[scan - i]:
+                    score += 1
+
+                if score * 2 - i > best * 2 - backward:
+                    best = score
+                    backward = i
+
+                i += 1
+
+        #! Продления перекрываются - делим перекрытие
+        if last_scan + forward > scan - backward:
+            overlap = (last_scan + forward) - (scan - backward)
+            score = 0
+            best = 0
+            split = 0
+
+            for i in range(overlap):
+                if new[last_scan + forward - overlap + i] == old[last_position + forward - overlap + i]:
+                    score += 1
+
+                if new[scan - backward + i] == old[position - backward + i]:
+                    score -= 1
+
+                if score > best:
+                    best = score
+                    split = i + 1
+
+            forward += split - overlap
+            backward -= split
+
+        for i in range(forward):
+            diff_block.append((new[last_scan + i] - old[last_position + i]) & 0xFF)
+
+        extra_block += new[last_scan + forward:scan - backward]
+
+        control += offset(forward)
+        control += offset((scan - backward) - (last_scan + forward))
+        control += offset((position - backward) - (last_position + forward))
+
+        last_scan = scan - backward
+        last_position = position - backward
+        last_offset = position - scan
+
+    return bytes(control), bytes(diff_block), bytes(extra_block)
+
+
+def make_patch(old, new):
+    """Патч ORPATCH1."""
+    control, diff_block, extra_block = diff(old, new)
+
+    if len(control) + len(diff_block) + len(extra_block) > MAX_EXPANDED_SIZE:
+        raise ValueError('expanded patch exceeds %d bytes, the launcher would reject it' % MAX_EXPANDED_SIZE)
+
+    compressed_control = qcompress(control)
+    compressed_diff = qcompress(diff_block)
+
+    return (b'ORPATCH1' + offset(len(compressed_control)) + offset(len(compressed_diff)) + offset(len(new)) +
+            compressed_control + compressed_diff + qcompress(extra_block))
+
+
+def file_hash(data, algorithm):
+    """Контрольная сумма в том виде, в котором она указывается в манифесте."""
+    if algorithm == 'sha256':
+        return hashlib.sha256(data).hexdigest()
+
+    if algorithm == 'blake3':
+        import blake3
+
+        return blake3.blake3(data).hexdigest()
+
+    return '%08X' % (zlib.crc32(data) & 0xFFFFFFFF)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build an ORPATCH1 binary patch for the update manifest')
+    parser.add_argument('source', help='file of the previous version')
+    parser.add_argument('target', help='file of the new version')
+    parser.add_argument('patch', help='patch to write')
+    parser.add_argument('--hashalgo', choices=['crc32', 'sha256', 'blake3'], default='crc32',
+                        help='hashalgo of the file in the manifest (fromhash is printed with it)')
+    arguments = parser.parse_args()
+
+    with open(arguments.source, 'rb') as file:
+        old = file.read()
+
+    with open(arguments.target, 'rb') as file:
+        new = file.read()
+
+    try:
+        patch = make_patch(old, new)
+    except ValueError as error:
+        sys.stderr.write('%s\n' % error)
+        return 1
+
+    with open(arguments.patch, 'wb') as file:
+        file.write(patch)
+
+    print('<patch name="%s" fromhash="%s" filename="%s" size="%d"/>' % (
+        os.path.basename(arguments.target), file_hash(old, arguments.hashalgo),
+        os.path.basename(arguments.patch), len(patch)))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
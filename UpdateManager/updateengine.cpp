@@ -0,0 +1,121 @@
+/**
+@file UpdateEngine.cpp
+
+@brief Обновление клиента без интерфейса
+**/
+//----------------------------------------------------------------------------------
+#include "updateengine.h"
+//----------------------------------------------------------------------------------
+CUpdateEngine::CUpdateEngine(const QString &directory, const QStringList &params)
+: m_Directory(directory), m_Params(params.size() >= 3 ? params : DefaultParams())
+{
+}
+//----------------------------------------------------------------------------------
+CUpdateEngine::~CUpdateEngine()
+{
+}
+//----------------------------------------------------------------------------------
+QStringList CUpdateEngine::DefaultParams()
+{
+	return QStringList() << "www.orionuo.com" << "/Downloads/" << "OrionUpdate.html" << "OrionUpdateTree.xml";
+}
+//----------------------------------------------------------------------------------
+QList<CUpdateInfo> CUpdateEngine::CheckUpdates(const COperation &operation)
+{
+	m_Updates.clear();
+	m_Backups.clear();
+
+	CUpdateManager<CUpdateEngine>::CheckUpdatesTree(m_Params, this, m_Directory, false, operation);
+
+	return m_Updates;
+}
+//----------------------------------------------------------------------------------
+QList<CUpdateInfo> CUpdateEngine::Update(const COperation &operation)
+{
+	QList<CUpdateInfo> list;
+
+	for (const CUpdateInfo &info : CheckUpdates(operation))
+	{
+		if (info.UODir == "yes")
+			list.push_back(info);
+	}
+
+	m_Plan = CUpdatePlan();
+	m_Failed.clear();
+
+	if (list.isEmpty())
+		return m_Failed;
+
+	CUpdateManager<CUpdateEngine>::PlanUpdates(m_Params, this, list, m_Directory, QCoreApplication::applicationDirPath(), operation);
+
+	if (m_Plan.Actions.size())
+		CUpdateManager<CUpdateEngine>::ExecutePlan(m_Params, this, m_Plan, operation);
+
+	return m_Failed;
+}
+//----------------------------------------------------------------------------------
+QList<CUpdateInfo> CUpdateEngine::Verify(QString &summary, const COperation &operation)
+{
+	m_Failed.clear();
+	m_Summary = "";
+
+	CUpdateManager<CUpdateEngine>::VerifyInstallation(m_Params, this, m_Directory, operation);
+
+	summary = m_Summary;
+
+	return m_Failed;
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_UpdatesListReceived(const QList<CUpdateInfo> &list)
+{
+	m_Updates = list;
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_BackupsListReceived(const QList<CBackupInfo> &list)
+{
+	m_Backups = list;
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_LastKnownUpdatesReceived(const QList<CUpdateInfo> &list, const QList<CBackupInfo> &backups)
+{
+	//! Проверка без кэша сразу идет на сервер, сохраненный результат не нужен
+	Q_UNUSED(list);
+	Q_UNUSED(backups);
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_FileReceived(const QByteArray &array, const QString &name)
+{
+	Q_UNUSED(array);
+	Q_UNUSED(name);
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_FileReceivedNotification(const QString &name)
+{
+	Q_UNUSED(name);
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_ChangelogReceived(const QString &str)
+{
+	Q_UNUSED(str);
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_AutoUpdateNotification()
+{
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_InstallationVerified(const QList<CUpdateInfo> &list, const QString &summary)
+{
+	m_Failed = list;
+	m_Summary = summary;
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_UpdatePlanReady(const CUpdatePlan &plan)
+{
+	m_Plan = plan;
+}
+//----------------------------------------------------------------------------------
+void CUpdateEngine::signal_UpdatePlanExecuted(const QList<CUpdateInfo> &failed)
+{
+	m_Failed = failed;
+}
+//----------------------------------------------------------------------------------
@@ -0,0 +1,98 @@
+/**
+@file UpdateEngine.h
+
+@brief Обновление клиента без интерфейса (консольные утилиты, замеры)
+
+Методы выполняются синхронно в вызывающем потоке и возвращают результат. Нужен QCoreApplication
+(файлы лаунчера ищутся рядом с приложением); окна и цикл событий не нужны.
+Прогресс передается через очередь операции:
+@code
+QSharedPointer<CProgressQueue> progress(new CProgressQueue());
+CUpdateEngine engine("C:/OrionUO");
+QList<CUpdateInfo> failed = engine.Update(COperation(0, progress));
+@endcode
+Очередь можно читать из другого потока, пока идет обновление (читатель должен быть один).
+**/
+//----------------------------------------------------------------------------------
+#ifndef UPDATEENGINE_H
+#define UPDATEENGINE_H
+//----------------------------------------------------------------------------------
+#include "updatemanager.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CUpdateEngine class
+ * Приемник CUpdateManager без Qt: signal_* - обычные методы, вызываемые в том же потоке
+ */
+class CUpdateEngine
+{
+private:
+	//! Директория клиента
+	QString m_Directory{ "" };
+
+	//! Параметры подключения [0] - host, [1] - path, [2] - page, [3] - корень дерева
+	QStringList m_Params;
+
+	//! Результаты последнего вызова
+	QList<CUpdateInfo> m_Updates;
+	QList<CBackupInfo> m_Backups;
+	CUpdatePlan m_Plan;
+	QList<CUpdateInfo> m_Failed;
+	QString m_Summary{ "" };
+
+public:
+	/**
+	 * @brief CUpdateEngine
+	 * @param directory Директория клиента
+	 * @param params Параметры подключения (пусто - сервер обновлений OrionUO)
+	 */
+	CUpdateEngine(const QString &directory, const QStringList &params = QStringList());
+	~CUpdateEngine();
+
+	//! Параметры подключения сервера обновлений OrionUO
+	static QStringList DefaultParams();
+
+	/**
+	 * @brief CheckUpdates Проверить клиент по манифесту сервера
+	 * @param operation Операция (отмена, срок, очередь прогресса)
+	 * @return Устаревшие файлы (пусто - клиент актуален или сервер недоступен)
+	 */
+	QList<CUpdateInfo> CheckUpdates(const COperation &operation = COperation());
+
+	/**
+	 * @brief Update Обновить файлы клиента (проверка, план, выполнение)
+	 * Файлы лаунчера не обновляются: их замена требует перезапуска лаунчера
+	 * @param operation Операция (отмена, срок, очередь прогресса)
+	 * @return Файлы, не прошедшие проверку после обновления
+	 */
+	QList<CUpdateInfo> Update(const COperation &operation = COperation());
+
+	/**
+	 * @brief Verify Проверить установленный клиент
+	 * @param summary Итог проверки
+	 * @param operation Операция (отмена, срок)
+	 * @return Файлы, которые нужно восстановить
+	 */
+	QList<CUpdateInfo> Verify(QString &summary, const COperation &operation = COperation());
+
+	//! Резервные версии из последней проверки
+	const QList<CBackupInfo> &Backups() const { return m_Backups; }
+
+	//! План последнего обновления
+	const CUpdatePlan &Plan() const { return m_Plan; }
+
+	//----------------------------------------------------------------------------------
+	//! Интерфейс приемника CUpdateManager
+	void signal_UpdatesListReceived(const QList<CUpdateInfo> &list);
+	void signal_BackupsListReceived(const QList<CBackupInfo> &list);
+	void signal_LastKnownUpdatesReceived(const QList<CUpdateInfo> &list, const QList<CBackupInfo> &backups);
+	void signal_FileReceived(const QByteArray &array, const QString &name);
+	void signal_FileReceivedNotification(const QString &name);
+	void signal_ChangelogReceived(const QString &str);
+	void signal_AutoUpdateNotification();
+	void signal_InstallationVerified(const QList<CUpdateInfo> &list, const QString &summary);
+	void signal_UpdatePlanReady(const CUpdatePlan &plan);
+	void signal_UpdatePlanExecuted(const QList<CUpdateInfo> &failed);
+};
+//----------------------------------------------------------------------------------
+#endif // UPDATEENGINE_H
+//----------------------------------------------------------------------------------
@@ -9,7 +9,31 @@
 #ifndef UPDATEINFO_H
 #define UPDATEINFO_H
 //----------------------------------------------------------------------------------
-#include <QListWidgetItem>
+#include <QString>
+#include <QList>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CPatchInfo class
+ * Бинарный патч к файлу от одной из предыдущих версий
+ */
+class CPatchInfo
+{
+public:
+	CPatchInfo() {}
+	~CPatchInfo() {}
+
+	//! Контрольная сумма исходного файла (тем же алгоритмом, что и у файла)
+	QString FromHash{ "" };
+
+	//! Версия исходного файла (если контрольная сумма не указана)
+	QString FromVersion{ "" };
+
+	//! Название патча на сервере
+	QString FileName{ "" };
+
+	//! Размер патча в байтах (-1 - не указан в манифесте)
+	qint64 Size{ -1 };
+};
 //----------------------------------------------------------------------------------
 /**
  * @brief The CUpdateInfo class
@@ -24,20 +48,38 @@ public:
 	//! Название файла для проверки
 	QString Name{ "" };
 
-	//! CRC32 файла
+	//! Контрольная сумма файла
 	QString Hash{ "" };
 
+	//! Алгоритм контрольной суммы (crc32, sha256, blake3), пусто - CRC32
+	QString HashAlgo{ "" };
+
 	//! Версия файла
 	QString Version{ "" };
 
 	//! Название архива с файлом (как называется на сервере)
 	QString ZipFileName{ "" };
 
+	//! Размер архива в байтах (-1 - не указан в манифесте)
+	qint64 ZipSize{ -1 };
+
+	//! Карта блоков файла на сервере (пусто - поблочная синхронизация недоступна)
+	QString BlockMapFileName{ "" };
+
+	//! Несжатый файл на сервере (для запросов Range)
+	QString RawFileName{ "" };
+
 	//! Примечание к обновлению
 	QString Notes{ "" };
 
 	//! В корневой директории
 	QString UODir{ "" };
+
+	//! Доступные патчи от предыдущих версий
+	QList<CPatchInfo> Patches;
+
+	//! Патч, подходящий к установленному файлу (индекс в Patches, -1 - качать архив целиком)
+	int Patch{ -1 };
 };
 //----------------------------------------------------------------------------------
 /**
@@ -55,6 +97,9 @@ public:
 
 	//! Название архива с файлом/файлами (как называется на сервере)
 	QString ZipFileName{ "" };
+
+	//! Локальный снимок (CInstallSnapshot), пусто - резервная версия на сервере
+	QString Snapshot{ "" };
 };
 //----------------------------------------------------------------------------------
 /**
@@ -74,51 +119,5 @@ public:
 	QString Description{ "" };
 };
 //----------------------------------------------------------------------------------
-/**
- * @brief The CUpdateInfoListWidgetItem class
- * Элемент QListWidget с информацией о обновлении
- */
-class CUpdateInfoListWidgetItem : public QListWidgetItem
-{
-public:
-	CUpdateInfoListWidgetItem(const CUpdateInfo &info)
-	: QListWidgetItem(), m_Info(info)
-	{
-		//! Отображаемый текст - имя файла
-		setText(info.Name);
-
-		//! Выбран галочкой в списке
-		//setCheckState(Qt::Checked);
-	}
-
-	virtual ~CUpdateInfoListWidgetItem() {}
-
-	//! Информация о обновлении
-	CUpdateInfo m_Info;
-};
-//----------------------------------------------------------------------------------
-/**
- * @brief The CBackupInfoListWidgetItem class
- * Элемент QListWidget с информацией о резервной версии
- */
-class CBackupInfoListWidgetItem : public QListWidgetItem
-{
-public:
-	CBackupInfoListWidgetItem(const CBackupInfo &backup)
-	: QListWidgetItem(), m_Backup(backup)
-	{
-		//! Отображаемый текст - имя файла
-		setText(backup.Name);
-
-		//! Выбран галочкой в списке
-		//setCheckState(Qt::Checked);
-	}
-
-	virtual ~CBackupInfoListWidgetItem() {}
-
-	//! Информация о обновлении
-	CBackupInfo m_Backup;
-};
-//----------------------------------------------------------------------------------
 #endif // UPDATEINFO_H
 //----------------------------------------------------------------------------------
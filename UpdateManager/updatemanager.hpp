@@ -11,10 +11,37 @@
 //----------------------------------------------------------------------------------
 #include <windows.h>
 #include <Wininet.h>
-#include <QXmlStreamReader>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QSet>
+#include <QTextDocumentFragment>
+#include <QThread>
+#include <QCoreApplication>
+#include <QtConcurrent>
 #include "qzipreader_p.h"
 #include "updateinfo.hpp"
+#include "manifestparser.hpp"
+#include "hashcalculator.hpp"
+#include "peversionreader.hpp"
+#include "installverifier.hpp"
+#include "merkletree.hpp"
+#include "backgroundpriority.hpp"
+#include "updateplanner.hpp"
+#include "manifestcache.hpp"
+#include "lastknownmanifest.hpp"
+#include "binarypatch.hpp"
+#include "blocksync.hpp"
+#include "packagecache.hpp"
+#include "updatenotifier.hpp"
+#include "installdedup.hpp"
+#include "installsnapshot.hpp"
+#include "selfupdate.hpp"
+#include "lancache.hpp"
+#include "changelogcache.hpp"
+#include "changelogarchive.hpp"
+#include "operation.hpp"
 
 #include <QDebug>
 //----------------------------------------------------------------------------------
@@ -24,17 +51,37 @@ enum REQUEST_TYPE
 	RT_CHECK_UPDATES = 0,	//! Запрос обновлений
 	RT_DOWNLOAD_FILE,		//! Скачивание файла
 	RT_AUTO_UPDATE,			//! Автоматическое обновление всех доступных файлов (запрос + проверка + скачка в случае необходимости)
-	RT_GET_CHANGELOG		//! Запрос истории изменений
+	RT_GET_CHANGELOG,		//! Запрос истории изменений
+	RT_VERIFY_INSTALL,		//! Проверка установленного клиента (запрос манифеста + опись директории + отчет)
+	RT_CHECK_TREE			//! Запрос обновлений по дереву манифеста (только измененные поддеревья)
 };
 //----------------------------------------------------------------------------------
 /**
  * @brief The CUpdateManager class
  * Шаблонный класс для взаимодействия с обновлениями
+ * Результаты передаются вызовом signal_* приемника T: у окна это сигналы Qt, у CUpdateEngine
+ * (UpdateEngine.h) - обычные методы, результат получается в том же потоке без интерфейса.
+ * Прогресс публикуется в очередь операции (COperation::Publish), а не сигналами.
  */
 template<typename T>
 class CUpdateManager
 {
 private:
+	//! Окно свежести манифеста в памяти (переключение между клиентами не делает запросов), мс
+	enum { MANIFEST_FRESHNESS_MS = 5 * 60 * 1000 };
+
+	//! Максимальный размер одного запроса Range при поблочной синхронизации
+	enum { MAX_RANGE_SIZE = 4 * 1024 * 1024 };
+
+	//! Совпавшие блоки между отсутствующими, которые выгоднее скачать, чем делать лишний запрос
+	enum { MAX_RANGE_GAP_BLOCKS = 4 };
+
+	//! Максимальный размер одного чтения из соединения
+	enum { READ_CHUNK_SIZE = 64 * 1024 };
+
+	//! Ограничение ответа, принимаемого в память, по умолчанию (манифест, история изменений, карты блоков)
+	enum { DEFAULT_MEMORY_LIMIT = 32 * 1024 * 1024 };
+
 	//! Приемник сигналов
 	T *m_Receiver{ nullptr };
 
@@ -53,13 +100,79 @@ private:
 	//! Список доступных обновлений (при RT_AUTO_UPDATE)
 	QList<CUpdateInfo> m_UpdateList;
 
+	//! Ограничитель чтения для фоновых проверок (nullptr - проверка запущена пользователем)
+	CIoThrottle *m_Throttle{ nullptr };
+
+	//! Разбор манифеста во время приема (nullptr - данные накапливаются в массиве)
+	CManifestParser *m_Parser{ nullptr };
+
+	//! Сколько ответа можно принять в память (массив или разбор манифеста), байт
+	qint64 m_MemoryLimit{ DEFAULT_MEMORY_LIMIT };
+
+	//! Проверки файлов на диске, запущенные во время приема манифеста
+	QList<QFuture<bool>> m_Checks;
+
+	//! Использовать свежий манифест из памяти вместо запроса
+	bool m_UseCache{ false };
+
+	//! Ограничение скорости приема, байт/с (0 - без ограничения)
+	qint64 m_RateLimit{ 0 };
+
+	//! Минимальный интервал опроса из последнего ответа сервера (Retry-After, Cache-Control: max-age), секунды (0 - не указан)
+	int m_PollHint{ 0 };
+
+	//! Дополнительные заголовки следующих запросов ("If-None-Match: ...\r\n")
+	QByteArray m_RequestHeaders;
+
+	//! Код ответа последнего запроса (0 - сервер не ответил)
+	int m_Status{ 0 };
+
+	//! Валидаторы из последнего ответа (ETag, Last-Modified)
+	QString m_ETag{ "" };
+	QString m_LastModified{ "" };
+
+	//! Часть общего прогресса, которую занимает выполнение плана (пакетное обновление нескольких установок), %
+	int m_ProgressOffset{ 0 };
+	int m_ProgressRange{ 100 };
+
+	//! Директория архивов, общих для всех установок пакетного обновления (пусто - архивы не разделяются)
+	QString m_SharedDirectory{ "" };
+
+	//! Отмена и срок выполнения (соединения регистрируются в ней на время запроса)
+	COperation m_Operation;
+
+	//! Принято с начала работы менеджера, байт
+	qint64 m_Received{ 0 };
+
+	//! Выполнение плана: объем плана, выполненных действий и текущего действия (m_PlanTotal == 0 - план не выполняется)
+	qint64 m_PlanTotal{ 0 };
+	qint64 m_PlanDone{ 0 };
+	qint64 m_PlanStep{ 0 };
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief PublishProgress Опубликовать прогресс в очередь операции
+	 * @param stepDone Выполненная часть текущего действия плана, байт
+	 */
+	void PublishProgress(const qint64 &stepDone)
+	{
+		int percent = -1;
+
+		if (m_PlanTotal > 0)
+			percent = m_ProgressOffset + (int)(((m_PlanDone + qMin(stepDone, m_PlanStep)) * m_ProgressRange) / m_PlanTotal);
+
+		m_Operation.Publish(percent, m_Received);
+	}
+
 	//----------------------------------------------------------------------------------
 	/**
 	 * @brief ReceiveData Получение данных
+	 * Данные пишутся в файл или отдаются разбору манифеста по частям, иначе накапливаются в массиве. В память принимается не больше m_MemoryLimit.
 	 * @param request Соединение с сервером
 	 * @param result Массив полученных данных
+	 * @return true если ответ получен целиком
 	 */
-	void ReceiveData(HINTERNET request, QByteArray &result)
+	bool ReceiveData(HINTERNET request, QByteArray &result)
 	{
 		//! Сохраняем в файл только если есть путь к файлу, запрос - скачка файла или запрос - автообновление и список обновлений уже есть
 		bool saveToFile = ((m_Type == RT_DOWNLOAD_FILE || (m_Type == RT_AUTO_UPDATE && m_UpdateList.length())) && m_FilePathToSave.length());
@@ -74,19 +187,63 @@ private:
 		DWORD size = 0;
 		InternetQueryDataAvailable(request, &size, 0, 0);
 
+		QElapsedTimer timer;
+		qint64 received = 0;
+		bool complete = true;
+		timer.start();
+
 		while (size)
 		{
-			QByteArray temp(size, 0);
+			if (m_Operation.Stopped())
+			{
+				complete = false;
+				break;
+			}
+
+			QByteArray temp((int)qMin(size, (DWORD)READ_CHUNK_SIZE), 0);
 			DWORD nbr = 0;
 
-			if (!InternetReadFile(request, temp.data(), size, &nbr))
+			if (!InternetReadFile(request, temp.data(), (DWORD)temp.size(), &nbr))
+			{
+				complete = false;
+				break;
+			}
+
+			temp.resize((int)nbr);
+			received += nbr;
+			m_Received += nbr;
+
+			PublishProgress(received);
+
+			//! Большой или враждебный ответ не должен раздувать память лаунчера
+			if (!saveToFile && received > m_MemoryLimit)
+			{
+				qDebug() << "Response exceeds the memory limit, receiving aborted:" << m_MemoryLimit;
+
+				result.clear();
+				complete = false;
 				break;
+			}
 
 			if (saveToFile)
 				file.write(temp);
+			else if (m_Parser != nullptr)
+			{
+				m_Parser->AddData(temp);
+				StartChecks(m_Parser->Manifest());
+			}
 			else
 				result.append(temp);
 
+			//! Фоновая загрузка не должна занимать весь канал
+			if (m_RateLimit > 0)
+			{
+				qint64 due = (received * 1000) / m_RateLimit - timer.elapsed();
+
+				if (due > 0)
+					QThread::msleep((unsigned long)due);
+			}
+
 			InternetQueryDataAvailable(request, &size, 0, 0);
 		}
 
@@ -95,288 +252,1846 @@ private:
 			file.close();
 
 			//! Автораспаковка
-			if (m_AutoUnzip)
+			if (m_AutoUnzip && complete)
+				ExtractArchive(m_FilePathToSave, m_Operation);
+		}
+
+		return complete;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ExtractArchive Распаковать архив в его директорию и удалить архив
+	 * Файл пишется рядом (".new") и заменяет прежний переименованием: имена, общие с другими
+	 * установками (CInstallDedup), при этом отделяются, а прерванная распаковка не оставляет
+	 * наполовину записанных файлов. Узлы дерева манифеста с файлами архива перестают считаться
+	 * синхронизированными. Распаковка идет по файлу, чтобы отмена не ждала конца большого архива.
+	 * @param filePath Путь к архиву
+	 * @param operation Операция (отмена прекращает распаковку после текущего файла)
+	 * @return true если распаковка прошла успешно
+	 */
+	static bool ExtractArchive(const QString &filePath, const COperation &operation)
+	{
+		QZipReader zipReader(filePath);
+
+		QString directoryPath = filePath;
+		int lastChar = qMax(directoryPath.lastIndexOf("/"), directoryPath.lastIndexOf("\\"));
+
+		if (lastChar != -1)
+			directoryPath.resize(lastChar);
+
+		bool result = (directoryPath.length() && zipReader.status() == QZipReader::NoError);
+		QDir directory(directoryPath);
+
+		if (result)
+		{
+			QStringList files;
+
+			for (const QZipReader::FileInfo &info : zipReader.fileInfoList())
+			{
+				if (info.isFile)
+					files.push_back(info.filePath);
+			}
+
+			CMerkleTreeState::Invalidate(CMerkleTreeState::StatePath(CInstallVerifier::InventoryPath(directoryPath)), files);
+		}
+
+		for (const QZipReader::FileInfo &info : zipReader.fileInfoList())
+		{
+			if (!result)
+				break;
+
+			if (operation.Stopped())
+			{
+				qDebug() << "Extraction cancelled:" << filePath;
+				result = false;
+				break;
+			}
+
+			if (info.isDir)
+			{
+				result = directory.mkpath(info.filePath);
+				continue;
+			}
+
+			if (!info.isFile)
+				continue;
+
+			QByteArray data = zipReader.fileData(info.filePath);
+
+			if (data.size() != info.size)
+			{
+				result = false;
+				break;
+			}
+
+			QString path = directory.filePath(info.filePath);
+			QString newPath = path + ".new";
+			QDir().mkpath(QFileInfo(path).absolutePath());
+
+			QFile file(newPath);
+
+			if (!file.open(QIODevice::WriteOnly))
+			{
+				result = false;
+				break;
+			}
+
+			result = (file.write(data) == data.size());
+			file.close();
+
+			if (result && info.permissions)
+				file.setPermissions(info.permissions);
+
+			//! Удаляется только это имя: общий с другой установкой файл остается ей
+			result = (result && (!QFile::exists(path) || QFile::remove(path)) && QFile::rename(newPath, path));
+
+			if (!result)
+				QFile::remove(newPath);
+		}
+
+		if (!result)
+			qDebug() << "Failed to unrar file:" << filePath;
+
+		zipReader.close();
+
+		QFile::remove(filePath);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ProbeSizes Уточнить неизвестные размеры архивов плана запросом HEAD
+	 * @param host Адрес хоста
+	 * @param path Путь к архивам
+	 * @param plan План
+	 */
+	void ProbeSizes(const QString &host, const QString &path, CUpdatePlan &plan)
+	{
+		for (CUpdateAction &action : plan.Actions)
+		{
+			if (m_Operation.Stopped())
+				break;
+
+			if ((action.Type == UAT_FETCH || action.Type == UAT_PATCH) && action.Size < 0)
+				Request("HEAD", host, path, action.ZipFileName, nullptr, &action.Size, "");
+		}
+
+		plan.UpdateTotals();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FetchArchive Скачать архив или патч в файл
+	 * @param host Адрес хоста
+	 * @param path Путь к архивам
+	 * @param page Название на сервере
+	 * @param filePath Путь для сохранения
+	 * @param cacheKey Ключ в хранилище пакетов (пусто - только с сервера, без сохранения)
+	 * @return true если файл получен
+	 */
+	bool FetchArchive(const QString &host, const QString &path, const QString &page, const QString &filePath, const QString &cacheKey)
+	{
+		if (CPackageCache::Instance().Get(cacheKey, filePath))
+			return true;
+
+		QByteArray unused;
+		QElapsedTimer timer;
+
+		m_FilePathToSave = filePath;
+		timer.start();
+
+		if (Download(host, path, page, unused))
+		{
+			//! Скорость ограниченной загрузки не отражает возможности канала
+			if (!m_RateLimit)
+				CThroughputMeter::Add(QFileInfo(filePath).size(), timer.elapsed());
+
+			CPackageCache::Instance().Put(cacheKey, filePath);
+
+			return true;
+		}
+
+		qDebug() << "Failed to download:" << page;
+		QFile::remove(filePath);
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FetchPackage Получить архив действия плана
+	 * При пакетном обновлении архив скачивается в общую директорию один раз и копируется каждой установке
+	 * @param host Адрес хоста
+	 * @param path Путь к архивам
+	 * @param action Скачивание архива
+	 * @param archivePath Путь для сохранения
+	 * @return true если архив получен
+	 */
+	bool FetchPackage(const QString &host, const QString &path, const CUpdateAction &action, const QString &archivePath)
+	{
+		if (!m_SharedDirectory.length())
+			return FetchArchive(host, path, action.ZipFileName, archivePath, CPackageCache::Key(action));
+
+		QString sharedPath = m_SharedDirectory + "/" + action.ZipFileName;
+
+		if (!QFile::exists(sharedPath) && !FetchArchive(host, path, action.ZipFileName, sharedPath, CPackageCache::Key(action)))
+			return false;
+
+		QFile::remove(archivePath);
+
+		return QFile::copy(sharedPath, archivePath);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief DownloadStored Скачать файл в m_FilePathToSave через хранилище пакетов
+	 * Резервные версии на сервере не меняются, поэтому ключ - адрес файла
+	 * @param host Адрес хоста
+	 * @param path Путь к файлу
+	 * @param page Название файла
+	 */
+	void DownloadStored(const QString &host, const QString &path, const QString &page)
+	{
+		QString key = CPackageCache::UrlKey(host, path, page);
+		bool autoUnzip = m_AutoUnzip;
+
+		if (!CPackageCache::Instance().Get(key, m_FilePathToSave))
+		{
+			QByteArray unused;
+
+			//! Распаковка удаляет архив, поэтому сначала сохраняем его в хранилище
+			m_AutoUnzip = false;
+
+			if (Download(host, path, page, unused))
+				CPackageCache::Instance().Put(key, m_FilePathToSave);
+
+			m_AutoUnzip = autoUnzip;
+		}
+
+		if (autoUnzip && QFile::exists(m_FilePathToSave))
+			ExtractArchive(m_FilePathToSave, m_Operation);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ApplyPatch Скачать патч, построить новый файл и заменить им установленный
+	 * @param host Адрес хоста
+	 * @param path Путь к патчам
+	 * @param action Действие плана (патч, файл, ожидаемый размер)
+	 * @param filePath Установленный файл
+	 * @return true если результат совпал с манифестом и файл заменен
+	 */
+	bool ApplyPatch(const QString &host, const QString &path, const CUpdateAction &action, const QString &filePath)
+	{
+		const CUpdateInfo &info = action.Files.first();
+		QString patchPath = filePath + ".patch";
+		QString newPath = filePath + ".new";
+
+		bool result = (FetchArchive(host, path, action.ZipFileName, patchPath, CPackageCache::Key(action)) && CBinaryPatch::ApplyFile(filePath, patchPath, newPath) && !NeedUpdate(info, newPath));
+
+		QFile::remove(patchPath);
+
+		if (result)
+			result = (QFile::remove(filePath) && QFile::rename(newPath, filePath));
+
+		QFile::remove(newPath);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SyncFile Собрать новую версию файла из совпавших локальных блоков и недостающих блоков с сервера
+	 * @param host Адрес хоста
+	 * @param path Путь к файлам на сервере
+	 * @param filePath Установленный файл
+	 * @param info Информация о файле из манифеста (карта блоков, несжатый файл, проверка результата)
+	 * @return true если результат совпал с манифестом и файл заменен
+	 */
+	bool SyncFile(const QString &host, const QString &path, const QString &filePath, const CUpdateInfo &info)
+	{
+		QByteArray mapData;
+		CBlockMap map;
+
+		//! Карта и блоки принимаются в память, а не в m_FilePathToSave
+		m_FilePathToSave = "";
+
+		if (!Download(host, path, info.BlockMapFileName, mapData) || !map.Parse(mapData))
+			return false;
+
+		mapData.clear();
+
+		QFile local(filePath);
+
+		if (!local.open(QIODevice::ReadOnly))
+			return false;
+
+		qint64 localSize = local.size();
+		uchar *localData = (localSize > 0 ? local.map(0, localSize) : nullptr);
+
+		if (localData == nullptr)
+			return false;
+
+		QVector<qint64> matches = CBlockSync::Match(localData, localSize, map);
+
+		QString newPath = filePath + ".new";
+		QFile output(newPath);
+		bool result = output.open(QIODevice::WriteOnly);
+		qint64 received = 0;
+
+		for (int i = 0; result && i < map.Count() && !m_Operation.Stopped(); )
+		{
+			if (matches[i] != -1)
+			{
+				result = (output.write((const char *)localData + matches[i], map.BlockLength(i)) == map.BlockLength(i));
+				i++;
+				continue;
+			}
+
+			//! Соседние недостающие блоки (и короткие промежутки совпавших) - одним запросом
+			int last = i;
+
+			for (int next = i + 1; next < map.Count() && next - last <= MAX_RANGE_GAP_BLOCKS + 1; next++)
 			{
-				QZipReader zipReader(m_FilePathToSave);
+				if (map.BlockOffset(next) + map.BlockLength(next) - map.BlockOffset(i) > MAX_RANGE_SIZE)
+					break;
+
+				if (matches[next] == -1)
+					last = next;
+			}
+
+			qint64 start = map.BlockOffset(i);
+			qint64 end = map.BlockOffset(last) + map.BlockLength(last) - 1;
+			QByteArray data;
+
+			result = (Request("GET", host, path, info.RawFileName, &data, nullptr, QString("%1-%2").arg(start).arg(end)) && data.size() == end - start + 1 && output.write(data) == data.size());
+
+			received += data.size();
+			i = last + 1;
+		}
+
+		output.close();
+		local.unmap(localData);
+		local.close();
+
+		result = (result && !m_Operation.Stopped() && !NeedUpdate(info, newPath) && QFile::remove(filePath) && QFile::rename(newPath, filePath));
+
+		QFile::remove(newPath);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FetchFromPeer Получить распакованный файл у соседа-зеркала в локальной сети и положить в хранилище
+	 * @param info Информация о файле из манифеста сервера обновлений (по ней проверяется полученный файл)
+	 * @return true если файл получен и совпал с манифестом
+	 */
+	bool FetchFromPeer(const CUpdateInfo &info)
+	{
+		QString key = CPackageCache::FileKey(info);
+
+		if (!key.length())
+			return false;
+
+		QString peer = CLanCache::Peer();
+
+		if (!peer.length())
+			return false;
+
+		QString partPath = CPackageCache::Directory() + "/lan.part";
+		QString filePath = m_FilePathToSave;
+		bool autoUnzip = m_AutoUnzip;
+		QByteArray unused;
+
+		QDir().mkpath(CPackageCache::Directory());
+		QFile::remove(partPath);
+
+		m_FilePathToSave = partPath;
+		m_AutoUnzip = false;
+
+		bool result = Download(peer, "/blob/", key, unused);
+
+		m_FilePathToSave = filePath;
+		m_AutoUnzip = autoUnzip;
+
+		//! Ответ (хотя бы 404) создает файл; его нет - сосед не ответил вовсе
+		if (!QFile::exists(partPath))
+			CLanCache::Forget();
+		else if (result && NeedUpdate(info, partPath))
+		{
+			qDebug() << "LAN cache server sent a damaged file:" << info.Name;
+			result = false;
+		}
+
+		if (result)
+			result = CPackageCache::Instance().Put(key, partPath);
+
+		QFile::remove(partPath);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief RevalidateChangelog Проверить сохраненную историю изменений на сервере и обновить ее (и архив записей)
+	 * @param host Адрес хоста
+	 * @param path Путь к странице
+	 * @param page Страница
+	 * @param cached Сохраненная страница (пусто - нет)
+	 * @param data Новая страница, если она изменилась
+	 * @return true если сервер прислал новую страницу
+	 */
+	bool RevalidateChangelog(const QString &host, const QString &path, const QString &page, const CChangelogEntry &cached, QByteArray &data)
+	{
+		m_RequestHeaders = cached.Validators();
+
+		bool result = Download(host, path, page, data);
+
+		m_RequestHeaders.clear();
+
+		if (m_Status == HTTP_STATUS_NOT_MODIFIED && !cached.Data.isEmpty())
+		{
+			CChangelogCache::Touch(page);
+			return false;
+		}
+
+		if (!result || data.isEmpty())
+			return false;
+
+		CChangelogEntry entry;
+		entry.Data = data;
+		entry.ETag = m_ETag;
+		entry.LastModified = m_LastModified;
+		entry.Time = QDateTime::currentMSecsSinceEpoch();
+
+		CChangelogCache::Save(page, entry);
+		CChangelogArchive::Instance().Update(page, data);
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief RenderChangelog Разобрать историю изменений по частям и отправить приемнику, новые разделы первыми
+	 * Разбор HTML выполняется здесь, в рабочем потоке; приемник только вставляет готовые части
+	 * @param receiver Приемник сигналов
+	 * @param request Номер запроса приемника
+	 * @param data Страница
+	 * @param operation Операция (после отмены части не отправляются)
+	 */
+	static void RenderChangelog(T *receiver, const int &request, const QByteArray &data, const COperation &operation)
+	{
+		QStringList parts = CChangelogCache::Split(CChangelogCache::Decode(data));
+
+		if (operation.IsCancelled())
+			return;
+
+		if (parts.isEmpty())
+			emit receiver->signal_ChangelogReceived("");
+
+		for (int i = 0; i < parts.size() && !operation.IsCancelled(); i++)
+			emit receiver->signal_ChangelogPartReceived(request, QTextDocumentFragment::fromHtml(parts.at(i)), i == 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief RestoreFiles Взять файлы архива из хранилища пакетов вместо скачивания
+	 * Недостающие в хранилище файлы запрашиваются у соседа-зеркала в локальной сети.
+	 * Архив лаунчера не восстанавливается: его файлы заменяются только вместе (InstallLauncher)
+	 * @param action Скачивание архива
+	 * @param copy false - только проверить, что все файлы есть в хранилище
+	 * @return true если все файлы архива есть (и скопированы)
+	 */
+	bool RestoreFiles(const CUpdateAction &action, const bool &copy)
+	{
+		if (action.KeepArchive || action.Files.isEmpty())
+			return false;
 
-				QString directoryPath = m_FilePathToSave;
-				int lastChar = qMax(directoryPath.lastIndexOf("/"), directoryPath.lastIndexOf("\\"));
+		CPackageCache &cache = CPackageCache::Instance();
+
+		for (const CUpdateInfo &info : action.Files)
+		{
+			if (!cache.Contains(CPackageCache::FileKey(info)) && !(copy && FetchFromPeer(info)))
+				return false;
+		}
+
+		if (!copy)
+			return true;
+
+		for (const CUpdateInfo &info : action.Files)
+		{
+			if (!cache.Get(CPackageCache::FileKey(info), action.Directory + "/" + info.Name))
+				return false;
+		}
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FetchFullArchive Скачать и распаковать архив файла, если патч или поблочная синхронизация не удались
+	 * @param host Адрес хоста
+	 * @param path Путь к архивам
+	 * @param directory Директория архива
+	 * @param info Информация о файле
+	 * @param extracted Уже распакованные архивы
+	 */
+	void FetchFullArchive(const QString &host, const QString &path, const QString &directory, const CUpdateInfo &info, QSet<QString> &extracted)
+	{
+		qDebug() << "Downloading full archive:" << info.ZipFileName;
+
+		QString fullPath = directory + "/" + info.ZipFileName;
+
+		CUpdateAction action;
+		action.ZipFileName = info.ZipFileName;
+		action.Files.push_back(info);
+
+		if (!extracted.contains(fullPath) && FetchArchive(host, path, info.ZipFileName, fullPath, CPackageCache::Key(action)))
+		{
+			ExtractArchive(fullPath, m_Operation);
+			extracted.insert(fullPath);
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Prefetch Заранее скачать архивы и патчи плана в хранилище пакетов
+	 * Скорость ограничена половиной измеренной скорости канала. Лишнее вытесняется из хранилища по бюджету.
+	 * @param host Адрес хоста
+	 * @param path Путь к архивам
+	 * @param plan План
+	 */
+	void Prefetch(const QString &host, const QString &path, const CUpdatePlan &plan)
+	{
+		REQUEST_TYPE type = m_Type;
+		bool autoUnzip = m_AutoUnzip;
+		m_Type = RT_DOWNLOAD_FILE;
+		m_AutoUnzip = false;
+		m_RateLimit = qMax((qint64)(CThroughputMeter::BytesPerSecond() / 2.0), (qint64)(32 * 1024));
+
+		for (const CUpdateAction &action : plan.Actions)
+		{
+			QString key = CPackageCache::Key(action);
+
+			if (m_Operation.Stopped())
+				break;
+
+			if (!key.length() || CPackageCache::Instance().Contains(key) || RestoreFiles(action, false))
+				continue;
+
+			QString partPath = CPackageCache::Directory() + "/prefetch.part";
+			QDir().mkpath(CPackageCache::Directory());
+
+			FetchArchive(host, path, action.ZipFileName, partPath, key);
+
+			QFile::remove(partPath);
+		}
+
+		m_Type = type;
+		m_AutoUnzip = autoUnzip;
+		m_RateLimit = 0;
+		m_FilePathToSave = "";
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief InstallLauncher Заменить файлы лаунчера файлами из архива (перезапуск - после выполнения плана)
+	 * @param action Скачивание архива лаунчера
+	 * @param archivePath Путь к архиву (удаляется)
+	 * @return true если файлы проверены и заменены
+	 */
+	bool InstallLauncher(const CUpdateAction &action, const QString &archivePath)
+	{
+		QString staging = CSelfUpdate::StagingDirectory(action.Directory);
+		QStringList files;
+
+		bool result = CSelfUpdate::Stage(archivePath, action.Directory, files);
+
+		//! Поврежденный архив не должен заменить работающий лаунчер
+		for (const CUpdateInfo &info : action.Files)
+		{
+			if (result && NeedUpdate(info, staging + "/" + info.Name))
+			{
+				qDebug() << "Staged launcher file failed verification:" << info.Name;
+				result = false;
+			}
+		}
+
+		result = (result && CSelfUpdate::Swap(action.Directory, files));
+
+		if (!result)
+			QDir(staging).removeRecursively();
+
+		QFile::remove(archivePath);
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief TakeSnapshots Сохранить файлы клиента, которые заменит план (для локального отката)
+	 * @param plan План
+	 */
+	void TakeSnapshots(const CUpdatePlan &plan)
+	{
+		QHash<QString, QStringList> files;
+
+		for (const CUpdateAction &action : plan.Actions)
+		{
+			if (action.Type != UAT_FETCH && action.Type != UAT_PATCH && action.Type != UAT_SYNC)
+				continue;
+
+			for (const CUpdateInfo &info : action.Files)
+			{
+				if (info.UODir == "yes")
+					files[action.Directory].push_back(info.Name);
+			}
+		}
+
+		for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+		{
+			QString version = "";
+			GetFileVersion(it.key() + "/OrionUO.exe", version);
+
+			CInstallSnapshot::Take(it.key(), it.value(), version.length() ? version : "unknown");
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief RunPlan Выполнить план обновления
+	 * @param host Адрес хоста
+	 * @param path Путь к архивам
+	 * @param plan План
+	 * @return Файлы, которые после распаковки все еще не соответствуют манифесту
+	 * (при отмене или истечении срока - и файлы невыполненных действий)
+	 */
+	QList<CUpdateInfo> RunPlan(const QString &host, const QString &path, const CUpdatePlan &plan)
+	{
+		QList<CUpdateInfo> failed;
+		QSet<QString> fetched;
+		QSet<QString> extracted;
+
+		//! Архивы сохраняются в файл без автораспаковки: распаковка - отдельное действие плана
+		REQUEST_TYPE type = m_Type;
+		bool autoUnzip = m_AutoUnzip;
+		m_Type = RT_DOWNLOAD_FILE;
+		m_AutoUnzip = false;
+
+		//! Прогресс считается по байтам, архивы неизвестного размера и остальные действия - по 1 Мб
+		m_PlanTotal = 0;
+		m_PlanDone = 0;
+
+		for (const CUpdateAction &action : plan.Actions)
+			m_PlanTotal += ((action.Type == UAT_FETCH || action.Type == UAT_PATCH) && action.Size >= 0 ? action.Size : 0x100000);
+
+		m_PlanTotal = qMax(m_PlanTotal, (qint64)1);
+
+		TakeSnapshots(plan);
+
+		for (const CUpdateAction &action : plan.Actions)
+		{
+			QString archivePath = action.Directory + "/" + action.ZipFileName;
+
+			m_PlanStep = ((action.Type == UAT_FETCH || action.Type == UAT_PATCH) && action.Size >= 0 ? action.Size : 0x100000);
+
+			//! Непроверенные файлы считаются неудачными, устаревшие найдет следующая проверка
+			if (m_Operation.Stopped())
+			{
+				if (action.Type == UAT_VERIFY)
+					failed.append(action.Files);
+
+				continue;
+			}
+
+			switch (action.Type)
+			{
+				case UAT_FETCH:
+				{
+					//! Архив мог быть уже получен вместо неподошедшего патча
+					if (extracted.contains(archivePath))
+						break;
+
+					//! Все файлы архива уже есть в хранилище - архив не нужен
+					if (RestoreFiles(action, true))
+						extracted.insert(archivePath);
+					else if (FetchPackage(host, path, action, archivePath))
+					{
+						fetched.insert(archivePath);
+
+						if (action.KeepArchive && !InstallLauncher(action, archivePath))
+							failed.append(action.Files);
+					}
+
+					break;
+				}
+				case UAT_EXTRACT:
+				{
+					if (fetched.contains(archivePath) && !extracted.contains(archivePath))
+					{
+						ExtractArchive(archivePath, m_Operation);
+						extracted.insert(archivePath);
+					}
+
+					break;
+				}
+				case UAT_PATCH:
+				{
+					const CUpdateInfo &info = action.Files.first();
+
+					if (RestoreFiles(action, true))
+						break;
+
+					if (!ApplyPatch(host, path, action, action.Directory + "/" + info.Name))
+						FetchFullArchive(host, path, action.Directory, info, extracted);
+
+					break;
+				}
+				case UAT_SYNC:
+				{
+					const CUpdateInfo &info = action.Files.first();
+					QString filePath = action.Directory + "/" + info.Name;
+
+					if (RestoreFiles(action, true))
+						break;
+
+					//! Без локальной копии блоки брать неоткуда, сжатый архив меньше несжатого файла
+					if (!QFile::exists(filePath) || !SyncFile(host, path, filePath, info))
+						FetchFullArchive(host, path, action.Directory, info, extracted);
+
+					break;
+				}
+				case UAT_VERIFY:
+				{
+					for (const CUpdateInfo &info : action.Files)
+					{
+						QString filePath = action.Directory + "/" + info.Name;
+
+						if (NeedUpdate(info, filePath))
+							failed.push_back(info);
+						else if (!CPackageCache::Instance().Contains(CPackageCache::FileKey(info)))
+							CPackageCache::Instance().Put(CPackageCache::FileKey(info), filePath);
+					}
+
+					break;
+				}
+				default:
+					break;
+			}
+
+			m_PlanDone += m_PlanStep;
+
+			PublishProgress(0);
+		}
+
+		m_PlanTotal = 0;
+		m_Type = type;
+		m_AutoUnzip = autoUnzip;
+		m_FilePathToSave = "";
+
+		return failed;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief NeedDiskCheck Нужно ли сверять файлы манифеста с диском
+	 * @return true для автообновления и проверки обновлений
+	 */
+	bool NeedDiskCheck() const
+	{
+		return (m_Type == RT_AUTO_UPDATE || m_Type == RT_CHECK_TREE);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ManifestFilePath Путь к файлу из манифеста на диске
+	 * @param manifest Манифест
+	 * @param index Индекс записи
+	 * @return Путь
+	 */
+	QString ManifestFilePath(const CCompactManifest &manifest, const int &index) const
+	{
+		const CManifestEntry &entry = manifest.Entry(index);
+
+		if (m_Type == RT_AUTO_UPDATE || entry.UODir)
+			return m_DirectoryToSave + "/" + manifest.String(entry.Name);
+
+		return QCoreApplication::applicationDirPath() + "/" + manifest.String(entry.Name);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief StartChecks Запуск проверки уже разобранных файлов, пока принимается остаток манифеста
+	 * Фоновые проверки выполняются после приема в своем потоке, чтобы не терять приоритет и ограничитель
+	 * @param manifest Манифест (разобранная часть)
+	 */
+	void StartChecks(const CCompactManifest &manifest)
+	{
+		if (!NeedDiskCheck() || m_Throttle != nullptr)
+			return;
+
+		//! Запись копируется в задачу: манифест продолжает заполняться в этом потоке
+		for (int i = m_Checks.size(); i < manifest.Size(); i++)
+			m_Checks.push_back(QtConcurrent::run(&CUpdateManager<T>::NeedUpdateEntry, manifest.Entry(i), ManifestFilePath(manifest, i), (CIoThrottle *)nullptr));
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief DownloadManifest Получение и разбор манифеста обновлений
+	 * @param host Адрес хоста
+	 * @param path Путь к странице
+	 * @param page Страница
+	 * @param updateList Сформированный список обновлений (для автообновления и проверки обновлений - только устаревшие файлы)
+	 * @param backupsList Список резервных версий
+	 * @return true если манифест получен целиком и сервер ответил кодом 200
+	 * (иначе списки не заполняются: в неполном манифесте часть файлов просто отсутствует)
+	 */
+	bool DownloadManifest(const QString &host, const QString &path, const QString &page, QList<CUpdateInfo> &updateList, QList<CBackupInfo> &backupsList)
+	{
+		QString key = host + path + page;
+		CCompactManifest manifest;
+		bool result = true;
+
+		m_Checks.clear();
+
+		if (m_UseCache && CManifestCache<CCompactManifest>::Instance().Get(key, manifest, MANIFEST_FRESHNESS_MS))
+			StartChecks(manifest);
+		else
+		{
+			QByteArray unused;
+			CManifestParser parser;
+
+			m_Parser = &parser;
+
+			result = Download(host, path, page, unused);
+			CPollSchedule::SetServerHint(m_PollHint);
+
+			m_Parser = nullptr;
+			parser.Finish();
+
+			manifest = parser.Manifest();
+
+			if (result)
+				CManifestCache<CCompactManifest>::Instance().Put(key, manifest);
+		}
+
+		//! Проверки уже разобранных файлов продолжают работу с копиями записей, их результаты не нужны
+		if (!result)
+		{
+			m_Checks.clear();
+			return false;
+		}
+
+		//! В CUpdateInfo разворачиваются только записи, которые уходят в интерфейс
+		for (int i = 0; i < manifest.Size(); i++)
+		{
+			if (m_Operation.Stopped())
+			{
+				m_Checks.clear();
+				updateList.clear();
+				return false;
+			}
+
+			if (!NeedDiskCheck())
+				updateList.push_back(manifest.Info(i));
+			else if (i < m_Checks.size() ? m_Checks[i].result() : NeedUpdateEntry(manifest.Entry(i), ManifestFilePath(manifest, i), m_Throttle))
+				updateList.push_back(manifest.Info(i));
+		}
+
+		m_Checks.clear();
+		backupsList.append(manifest.Backups());
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief TreeFilePath Путь к файлу из узла дерева на диске
+	 * @param info Информация о файле
+	 * @return Путь
+	 */
+	QString TreeFilePath(const CUpdateInfo &info) const
+	{
+		return (info.UODir == "yes" ? m_DirectoryToSave : QCoreApplication::applicationDirPath()) + "/" + info.Name;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief FetchTreeNode Получение и проверка узла дерева
+	 * Узел, хэш которого указан родителем, берется из памяти независимо от возраста:
+	 * совпадение хэша гарантирует совпадение содержимого. Корень - только в окне свежести.
+	 * @param host Адрес хоста
+	 * @param path Путь к узлам дерева
+	 * @param page Файл узла
+	 * @param expectedHash Хэш из родительского узла (пусто для корня)
+	 * @param node Узел
+	 * @return true если узел получен и соответствует хэшу
+	 */
+	bool FetchTreeNode(const QString &host, const QString &path, const QString &page, const QString &expectedHash, CMerkleNode &node)
+	{
+		QString key = host + path + page;
+		CManifestCache<CMerkleNode> &cache = CManifestCache<CMerkleNode>::Instance();
+
+		if (expectedHash.length())
+		{
+			if (cache.Get(key, node, -1) && CHashCalculator::Compare(expectedHash, node.Hash))
+				return true;
+		}
+		else if (m_UseCache && cache.Get(key, node, MANIFEST_FRESHNESS_MS))
+			return !node.Hash.isEmpty();
+
+		QByteArray data;
+		node = CMerkleNode();
+
+		bool downloaded = Download(host, path, page, data);
+
+		if (!expectedHash.length())
+			CPollSchedule::SetServerHint(m_PollHint);
+
+		if (!downloaded || !CMerkleNode::Parse(data, node) || !node.IsValid(expectedHash))
+		{
+			//! Отсутствие дерева на сервере тоже запоминаем, чтобы не запрашивать его при каждой смене клиента
+			if (!expectedHash.length())
+				cache.Put(key, CMerkleNode());
+
+			return false;
+		}
+
+		cache.Put(key, node);
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CheckTreeNode Проверка узла дерева манифеста
+	 * Спускаемся только в те поддеревья, хэш которых отличается от сохраненного состояния
+	 * @param host Адрес хоста
+	 * @param path Путь к узлам дерева
+	 * @param node Узел
+	 * @param state Состояние синхронизированных узлов
+	 * @param updateList Список обновлений
+	 * @return false если какой-то из узлов не удалось получить или он поврежден
+	 */
+	bool CheckTreeNode(const QString &host, const QString &path, const CMerkleNode &node, CMerkleTreeState &state, QList<CUpdateInfo> &updateList)
+	{
+		bool synced = true;
+		QStringList files;
+		QStringList dirs;
+
+		for (const CUpdateInfo &info : node.Files)
+		{
+			if (m_Operation.Stopped())
+				return false;
+
+			QString filePath = TreeFilePath(info);
+			files.push_back(filePath);
+
+			if (NeedUpdate(info, filePath, m_Throttle))
+			{
+				updateList.push_back(info);
+				synced = false;
+			}
+		}
+
+		for (const CMerkleDirInfo &dir : node.Dirs)
+		{
+			dirs.push_back(dir.Path);
+
+			if (state.IsSynced(dir.Path, dir.Hash))
+				continue;
+
+			CMerkleNode child;
+
+			if (!FetchTreeNode(host, path, dir.Manifest, dir.Hash, child) || child.Path != dir.Path)
+			{
+				qDebug() << "Invalid tree node:" << dir.Manifest;
+				return false;
+			}
+
+			if (!CheckTreeNode(host, path, child, state, updateList))
+				return false;
+
+			if (!state.IsSynced(dir.Path, dir.Hash))
+				synced = false;
+		}
+
+		//! Узел запоминаем только когда все его файлы и поддеревья совпадают с сервером
+		if (synced)
+			state.SetSynced(node.Path, node.Hash, files, dirs);
+		else
+			state.Reset(node.Path);
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CheckTree Проверка обновлений по дереву манифеста
+	 * @param host Адрес хоста
+	 * @param path Путь к странице
+	 * @param treePage Корень дерева (пусто - только плоский манифест)
+	 * @param page Плоский манифест (если дерево недоступно)
+	 * @return Список обновлений (тот же, что отправлен приемнику)
+	 */
+	QList<CUpdateInfo> CheckTree(const QString &host, const QString &path, const QString &treePage, const QString &page)
+	{
+		CMerkleNode root;
+		QString inventoryPath = CInstallVerifier::InventoryPath(m_DirectoryToSave);
+
+		if (treePage.length() && FetchTreeNode(host, path, treePage, "", root))
+		{
+			QString statePath = CMerkleTreeState::StatePath(inventoryPath);
+			CMerkleTreeState state;
+			state.Load(statePath);
+
+			QList<CUpdateInfo> updateList;
+
+			//! Совпадение корня (и файлов на диске с запомненными) - клиент соответствует релизу, сеть больше не нужна
+			if (state.IsSynced(root.Path, root.Hash) || CheckTreeNode(host, path, root, state, updateList))
+			{
+				state.Save(statePath);
+				CLastKnownManifest::Save(CLastKnownManifest::SnapshotPath(inventoryPath), updateList, root.Backups);
+
+				if (!m_Operation.IsCancelled())
+				{
+					emit m_Receiver->signal_BackupsListReceived(root.Backups);
+					emit m_Receiver->signal_UpdatesListReceived(updateList);
+				}
+
+				return updateList;
+			}
+
+			state.Save(statePath);
+		}
+
+		//! Сервер не публикует дерево или оно неполное - проверяем по плоскому манифесту
+		QList<CUpdateInfo> updateList;
+		QList<CBackupInfo> backupsList;
+
+		//! Сохраняем только ответ сервера: пустой список из-за ошибки сети не должен затереть последний известный
+		if (DownloadManifest(host, path, page, updateList, backupsList))
+			CLastKnownManifest::Save(CLastKnownManifest::SnapshotPath(inventoryPath), updateList, backupsList);
+
+		if (m_Operation.IsCancelled())
+			return QList<CUpdateInfo>();
+
+		emit m_Receiver->signal_BackupsListReceived(backupsList);
+		emit m_Receiver->signal_UpdatesListReceived(updateList);
+
+		return updateList;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ShowLastKnown Показать результат последней проверки, дошедшей до сервера
+	 * Сохраненный список отправляется сразу, без обращения к диску. Затем устаревшие файлы
+	 * сверяются с диском, и если какие-то из них с тех пор обновлены - список отправляется еще раз.
+	 * @return true если сохраненный результат найден
+	 */
+	bool ShowLastKnown()
+	{
+		CCompactManifest manifest;
+
+		if (!CLastKnownManifest::Load(CLastKnownManifest::SnapshotPath(CInstallVerifier::InventoryPath(m_DirectoryToSave)), manifest))
+			return false;
+
+		QList<CUpdateInfo> saved;
+		QList<CBackupInfo> backups = manifest.Backups();
+
+		for (int i = 0; i < manifest.Size(); i++)
+			saved.push_back(manifest.Info(i));
+
+		if (m_Operation.IsCancelled())
+			return false;
+
+		emit m_Receiver->signal_LastKnownUpdatesReceived(saved, backups);
+
+		QList<CUpdateInfo> updateList;
+
+		for (int i = 0; i < manifest.Size(); i++)
+		{
+			if (m_Operation.Stopped())
+				return true;
+
+			if (NeedUpdateEntry(manifest.Entry(i), ManifestFilePath(manifest, i), m_Throttle))
+				updateList.push_back(manifest.Info(i));
+		}
+
+		//! Сверка только отбрасывает файлы, поэтому список изменился, если он стал короче
+		if (updateList.size() != saved.size() && !m_Operation.IsCancelled())
+			emit m_Receiver->signal_LastKnownUpdatesReceived(updateList, backups);
+
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------
+public:
+	/**
+	 * @brief CUpdateManager Конструктор класса
+	 * @param receiver Приемник сигналов
+	 * @param type Тип запроса
+	 * @param filePathToSave Путь сохранения архива
+	 * @param autoUnzipAndDeleteZip Автораспаковка архива
+	 * @param directoryToSave Путь к директории для сохранения автообновлений
+	 */
+	CUpdateManager(T *receiver, const REQUEST_TYPE &type, const QString &filePathToSave, const bool &autoUnzipAndDeleteZip, const QString &directoryToSave)
+	: m_Receiver(receiver), m_Type(type), m_FilePathToSave(filePathToSave),
+	m_AutoUnzip(autoUnzipAndDeleteZip), m_DirectoryToSave(directoryToSave)
+	{
+	}
+
+	//----------------------------------------------------------------------------------
+	~CUpdateManager()
+	{
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief TestVersions Сверка версий
+	 * @param currentFileVersion Текущая версия файла
+	 * @param updateFileVersion Версия файла из обновления
+	 * @return true если необходимо обновить файл
+	 */
+	static bool TestVersions(const QString &currentFileVersion, const QString &updateFileVersion)
+	{
+		//! Недостающие части версии считаются нулями ("1.2" == "1.2.0.0")
+		return (CVersionKey::Pack(updateFileVersion) > CVersionKey::Pack(currentFileVersion));
+	}
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief NeedUpdate Проверка необходимости обновления файла
+	 * @param info Информация о файле из манифеста
+	 * @param path Путь к файлу на диске
+	 * @param throttle Ограничитель фонового чтения
+	 * @return true если файла нет, версия устарела или контрольная сумма не совпадает
+	 */
+	static bool NeedUpdate(const CUpdateInfo &info, const QString &path, CIoThrottle *throttle = nullptr)
+	{
+		QString hash = "";
+		QString version = "";
+
+		//! Контрольную сумму считаем только если она указана в манифесте
+		HASH_ALGORITHM algorithm = CHashCalculator::AlgorithmFromName(info.HashAlgo);
+
+		if (!info.Hash.length())
+		{
+			if (!QFile::exists(path))
+				return true;
+
+			GetFileVersion(path, version);
+		}
+		else if (!GetFileInfo(path, version, hash, algorithm, throttle))
+			return true;
+
+		if (info.Version.length() && TestVersions(version, info.Version))
+			return true;
+
+		if (info.Hash.length() && !CHashCalculator::Compare(info.Hash, hash))
+			return true;
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief NeedUpdateEntry Проверка необходимости обновления файла по записи компактного манифеста
+	 * Версии и контрольные суммы сравниваются как целые числа
+	 * @param entry Запись манифеста
+	 * @param path Путь к файлу на диске
+	 * @param throttle Ограничитель фонового чтения
+	 * @return true если файла нет, версия устарела или контрольная сумма не совпадает
+	 */
+	static bool NeedUpdateEntry(const CManifestEntry &entry, const QString &path, CIoThrottle *throttle)
+	{
+		QString hash = "";
+		QString version = "";
+
+		if (entry.Hash.IsEmpty())
+		{
+			if (!QFile::exists(path))
+				return true;
+
+			GetFileVersion(path, version);
+		}
+		else if (!GetFileInfo(path, version, hash, (HASH_ALGORITHM)entry.HashAlgo, throttle))
+			return true;
+
+		if (entry.HasVersion && CVersionKey::Pack(version) < entry.Version)
+			return true;
+
+		if (!entry.Hash.IsEmpty() && CHashKey::FromHex(hash) != entry.Hash)
+			return true;
+
+		return false;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SelectPatches Выбрать для каждого файла патч от установленной версии
+	 * @param list Устаревшие файлы
+	 * @param clientDirectory Директория клиента (uodir="yes")
+	 * @param launcherDirectory Директория лаунчера
+	 */
+	static void SelectPatches(QList<CUpdateInfo> &list, const QString &clientDirectory, const QString &launcherDirectory)
+	{
+		for (CUpdateInfo &info : list)
+		{
+			info.Patch = -1;
+
+			//! Без контрольной суммы результат патча нечем проверить
+			if (!info.Patches.size() || !info.Hash.length() || CUpdatePlanner::IsLauncher(info))
+				continue;
+
+			QString version = "";
+			QString hash = "";
+			QString filePath = (info.UODir == "yes" ? clientDirectory : launcherDirectory) + "/" + info.Name;
+
+			if (!GetFileInfo(filePath, version, hash, CHashCalculator::AlgorithmFromName(info.HashAlgo)))
+				continue;
+
+			for (int i = 0; i < info.Patches.size(); i++)
+			{
+				const CPatchInfo &patch = info.Patches.at(i);
+
+				if (patch.FromHash.length() ? CHashCalculator::Compare(patch.FromHash, hash) : (patch.FromVersion.length() && CVersionKey::Pack(patch.FromVersion) == CVersionKey::Pack(version)))
+				{
+					info.Patch = i;
+					break;
+				}
+			}
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CheckUpdates Функция проверки обновлений
+	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
+	 * @param receiver Приемнник сигналов
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void CheckUpdates(const QStringList &params, T *receiver, const COperation &operation)
+	{
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
+
+		if (params.size() >= 3)
+		{
+			CUpdateManager<T> manager(receiver, RT_CHECK_UPDATES, "", true, "");
+			manager.m_Operation = operation;
+
+			manager.ConnectToPage(params.at(0), params.at(1), params.at(2));
+		}
+		else
+		{
+			//! Защита от зависания, уведомим ресивера о окончании процедуры
+			emit receiver->signal_BackupsListReceived(QList<CBackupInfo>());
+			emit receiver->signal_UpdatesListReceived(QList<CUpdateInfo>());
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CheckUpdatesTree Функция проверки обновлений по дереву манифеста
+	 * Список обновлений уже сверен с файлами на диске. Если разрешен кэш, сначала без обращения
+	 * к сети показывается результат последней проверки (signal_LastKnownUpdatesReceived).
+	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page, [3] - корень дерева (необязательно)
+	 * @param receiver Приемнник сигналов
+	 * @param directory Директория клиента
+	 * @param useCache Взять манифест из памяти, если он получен недавно (смена клиента)
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void CheckUpdatesTree(const QStringList &params, T *receiver, const QString &directory, const bool &useCache, const COperation &operation)
+	{
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
+
+		if (params.size() >= 3)
+		{
+			CUpdateManager<T> manager(receiver, RT_CHECK_TREE, "", true, directory);
+			manager.m_UseCache = useCache;
+			manager.m_Operation = operation;
+
+			if (useCache)
+				manager.ShowLastKnown();
+
+			manager.CheckTree(params.at(0), params.at(1), params.value(3), params.at(2));
+		}
+		else
+			CheckUpdates(params, receiver, operation);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ShowLastKnownUpdates Показать результат последней проверки без обращения к сети
+	 * (signal_LastKnownUpdatesReceived: сразу сохраненный список, затем сверенный с диском, если он изменился)
+	 * @param receiver Приемнник сигналов
+	 * @param directory Директория клиента
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void ShowLastKnownUpdates(T *receiver, const QString &directory, const COperation &operation)
+	{
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
+
+		CUpdateManager<T> manager(receiver, RT_CHECK_TREE, "", true, directory);
+		manager.m_Operation = operation;
+
+		manager.ShowLastKnown();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief CheckUpdatesInBackground Фоновая проверка обновлений (по таймеру)
+	 * Выполняется с фоновым приоритетом ввода-вывода и процессора, чтение файлов
+	 * замедляется при росте задержек диска. Запускать через CBackgroundPriority::Pool().
+	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page, [3] - корень дерева (необязательно)
+	 * @param receiver Приемнник сигналов
+	 * @param directory Директория клиента
+	 * @param useCache Взять манифест из памяти, если он получен недавно (false - по уведомлению о новом выпуске)
+	 * @param predownload Заранее скачать найденные обновления в кэш (PackageCache.hpp)
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void CheckUpdatesInBackground(const QStringList &params, T *receiver, const QString &directory, const bool &useCache, const bool &predownload, const COperation &operation)
+	{
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
+
+		CBackgroundPriority priority;
+		CIoThrottle throttle;
+
+		if (params.size() >= 3)
+		{
+			CUpdateManager<T> manager(receiver, RT_CHECK_TREE, "", true, directory);
+			manager.m_Throttle = &throttle;
+			manager.m_UseCache = useCache;
+			manager.m_Operation = operation;
+
+			QList<CUpdateInfo> list = manager.CheckTree(params.at(0), params.at(1), params.value(3), params.at(2));
+
+			//! Пустой список может означать и недоступность сервера - кэш тогда не трогаем
+			if (predownload && list.size())
+			{
+				SelectPatches(list, directory, QCoreApplication::applicationDirPath());
+
+				manager.Prefetch(params.at(0), params.at(1), CUpdatePlanner::Build(list, directory, QCoreApplication::applicationDirPath()));
+			}
+		}
+		else
+			CheckUpdates(params, receiver, operation);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief DownloadFile Получение файла
+	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
+	 * @param receiver Приемнник сигналов
+	 * @param filePathToSave Путь для сохранения файла
+	 * @param autoUnzipAndDeleteZip Автоматическая распаковка файла
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void DownloadFile(const QStringList &params, T *receiver, const QString &filePathToSave, const bool &autoUnzipAndDeleteZip, const COperation &operation)
+	{
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
+
+		if (params.size() >= 3)
+		{
+			CUpdateManager<T> manager(receiver, RT_DOWNLOAD_FILE, filePathToSave, autoUnzipAndDeleteZip, "");
+			manager.m_Operation = operation;
+
+			manager.ConnectToPage(params.at(0), params.at(1), params.at(2));
+		}
+		else
+		{
+			//! Защита от зависания, уведомим ресивера о окончании процедуры
+			emit receiver->signal_FileReceivedNotification(filePathToSave);
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief GetChangelog Функция получения истории изменений
+	 * Сохраненная страница показывается сразу, затем проверяется на сервере (если не проверялась недавно)
+	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
+	 * @param receiver Приемнник сигналов
+	 * @param request Номер запроса приемника (части старых запросов приемник отбрасывает)
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void GetChangelog(const QStringList &params, T *receiver, const int &request, const COperation &operation)
+	{
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
+
+		if (params.size() >= 3)
+		{
+			CChangelogEntry cached;
+			bool loaded = CChangelogCache::Load(params.at(2), cached);
+
+			if (loaded)
+			{
+				RenderChangelog(receiver, request, cached.Data, operation);
+
+				//! Архив мог не застать эту страницу (первый запуск с архивом); неизменная страница не разбирается
+				CChangelogArchive::Instance().Update(params.at(2), cached.Data);
+			}
+
+			if (loaded && cached.Age() < CChangelogCache::FRESHNESS_MS)
+				return;
+
+			CUpdateManager<T> manager(receiver, RT_GET_CHANGELOG, "", true, "");
+			QByteArray data;
+
+			manager.m_Operation = operation;
+
+			if (manager.RevalidateChangelog(params.at(0), params.at(1), params.at(2), cached, data))
+				RenderChangelog(receiver, request, data, operation);
+			else if (!loaded && !operation.IsCancelled())
+				emit receiver->signal_ChangelogReceived("");
+		}
+		else
+		{
+			//! Защита от зависания, уведомим ресивера о окончании процедуры
+			emit receiver->signal_ChangelogReceived("");
+		}
+	}
 
-				if (lastChar != -1)
-					directoryPath.resize(lastChar);
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief PrefetchChangelogs Обновить сохраненные истории изменений (все языки) в фоне
+	 * @param params Параметры подключения [0] - host, [1] - path, [2...] - страницы
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void PrefetchChangelogs(const QStringList &params, const COperation &operation)
+	{
+		for (int i = 2; i < params.size() && !operation.Stopped(); i++)
+		{
+			CChangelogEntry cached;
 
-				if (!directoryPath.length() || !zipReader.extractAll(directoryPath))
-					qDebug() << "Failed to unrar file:" << m_FilePathToSave;
+			if (CChangelogCache::Load(params.at(i), cached) && cached.Age() < CChangelogCache::FRESHNESS_MS)
+				continue;
 
-				zipReader.close();
+			CUpdateManager<T> manager(nullptr, RT_GET_CHANGELOG, "", true, "");
+			QByteArray data;
 
-				QFile::remove(m_FilePathToSave);
-			}
+			manager.m_Operation = operation;
+			manager.RevalidateChangelog(params.at(0), params.at(1), params.at(i), cached, data);
 		}
 	}
 
 	//----------------------------------------------------------------------------------
 	/**
-	 * @brief ParseXML Обработка XML кода страницы
-	 * @param xml Данные
-	 * @param updateList Сформированный список обновлений
+	 * @brief AutoUpdate Автоматическое обновление
+	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
+	 * @param receiver Приемнник сигналов
+	 * @param directoryToSave Путь к директории для сохранения файлов
+	 * @param operation Операция (отмена, срок выполнения)
 	 */
-	void ParseXML(const QString &xml, QList<CUpdateInfo> &updateList, QList<CBackupInfo> &backupsList)
+	static void AutoUpdate(const QStringList &params, T *receiver, const QString &directoryToSave, const COperation &operation)
 	{
-		//qDebug() << "ParseXML (type:" << m_Type << "):\n" << xml;
-
-//! Макрос для считывания XML данных в поля структуры CUpdateInfo
-#define ReadMetaValue(var, name) \
-	if (attributes.hasAttribute(name)) \
-		info.var = attributes.value(name).toString()
-
-//! Макрос для считывания XML данных в поля структуры CBackupInfo
-#define ReadMetaValueB(var, name) \
-	if (attributes.hasAttribute(name)) \
-		backup.var = attributes.value(name).toString()
-
-		QXmlStreamReader reader(xml);
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
 
-		while (!reader.atEnd() && !reader.hasError())
+		if (params.size() >= 3)
 		{
-			if (reader.isStartElement())
-			{
-				QXmlStreamAttributes attributes = reader.attributes();
-
-				if (reader.name().toString().trimmed().toLower() == "meta")
-				{
-					CUpdateInfo info;
-
-					ReadMetaValue(Name, "name");
-
-					//! Добавляем только если есть имя
-					if (info.Name.length())
-					{
-						ReadMetaValue(Version, "version");
-						ReadMetaValue(Hash, "hash");
-						ReadMetaValue(ZipFileName, "filename");
-						ReadMetaValue(Notes, "updatenotes");
-						ReadMetaValue(UODir, "uodir");
-
-						//! Проверка файла при автообновлении
-						if (m_Type == RT_AUTO_UPDATE)
-						{
-							QString crc32 = "";
-							QString version = "";
+			CUpdateManager<T> manager(receiver, RT_AUTO_UPDATE, "", true, directoryToSave);
+			manager.m_Operation = operation;
 
-							bool wantUpdate = !GetFileInfo(m_DirectoryToSave + "/" + info.Name, version, crc32);
+			manager.ConnectToPage(params.at(0), params.at(1), params.at(2));
+		}
+		else
+		{
+			//! Защита от зависания, уведомим ресивера о окончании процедуры
+			emit receiver->signal_AutoUpdateNotification();
+		}
+	}
 
-							if (info.Version.length() && TestVersions(version, info.Version))
-								wantUpdate = true;
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief PlanUpdates Построение плана обновления (размеры архивов уточняются запросом HEAD)
+	 * @param params Параметры подключения [0] - host, [1] - path
+	 * @param receiver Приемнник сигналов
+	 * @param list Устаревшие файлы
+	 * @param clientDirectory Директория клиента
+	 * @param launcherDirectory Директория лаунчера
+	 * @param operation Операция (отмена, срок выполнения)
+	 */
+	static void PlanUpdates(const QStringList &params, T *receiver, const QList<CUpdateInfo> &list, const QString &clientDirectory, const QString &launcherDirectory, const COperation &operation)
+	{
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
 
-							if (info.Hash.length() && info.Hash != crc32)
-								wantUpdate = true;
+		QList<CUpdateInfo> files = list;
+		SelectPatches(files, clientDirectory, launcherDirectory);
 
-							if (wantUpdate)
-								updateList.push_back(info);
-						}
-						else
-							updateList.push_back(info);
-					}
-					else
-					{
-						CBackupInfo backup;
-						ReadMetaValueB(Name, "backup");
+		CUpdatePlan plan = CUpdatePlanner::Build(files, clientDirectory, launcherDirectory);
 
-						if (backup.Name.length())
-						{
-							ReadMetaValueB(ZipFileName, "filename");
-							backupsList.push_back(backup);
-						}
-					}
-				}
-			}
+		if (params.size() >= 2)
+		{
+			CUpdateManager<T> manager(receiver, RT_DOWNLOAD_FILE, "", false, "");
+			manager.m_Operation = operation;
 
-			reader.readNext();
+			manager.ProbeSizes(params.at(0), params.at(1), plan);
 		}
+
+		if (!operation.IsCancelled())
+			emit receiver->signal_UpdatePlanReady(plan);
 	}
 
 	//----------------------------------------------------------------------------------
-public:
 	/**
-	 * @brief CUpdateManager Конструктор класса
-	 * @param receiver Приемник сигналов
-	 * @param type Тип запроса
-	 * @param filePathToSave Путь сохранения архива
-	 * @param autoUnzipAndDeleteZip Автораспаковка архива
-	 * @param directoryToSave Путь к директории для сохранения автообновлений
+	 * @brief ExecutePlan Выполнение плана обновления
+	 * @param params Параметры подключения [0] - host, [1] - path
+	 * @param receiver Приемнник сигналов
+	 * @param plan План
+	 * @param operation Операция (отмена, срок выполнения)
 	 */
-	CUpdateManager(T *receiver, const REQUEST_TYPE &type, const QString &filePathToSave, const bool &autoUnzipAndDeleteZip, const QString &directoryToSave)
-	: m_Receiver(receiver), m_Type(type), m_FilePathToSave(filePathToSave),
-	m_AutoUnzip(autoUnzipAndDeleteZip), m_DirectoryToSave(directoryToSave)
+	static void ExecutePlan(const QStringList &params, T *receiver, const CUpdatePlan &plan, const COperation &operation)
 	{
-	}
+		if (receiver == nullptr || operation.IsCancelled())
+			return;
 
-	//----------------------------------------------------------------------------------
-	~CUpdateManager()
-	{
+		if (params.size() >= 2)
+		{
+			CUpdateManager<T> manager(receiver, RT_DOWNLOAD_FILE, "", false, "");
+			manager.m_Operation = operation;
+
+			QList<CUpdateInfo> failed = manager.RunPlan(params.at(0), params.at(1), plan);
+
+			if (!operation.IsCancelled())
+				emit receiver->signal_UpdatePlanExecuted(failed);
+		}
+		else
+		{
+			//! Защита от зависания, уведомим ресивера о окончании процедуры
+			emit receiver->signal_UpdatePlanExecuted(QList<CUpdateInfo>());
+		}
 	}
 
 	//----------------------------------------------------------------------------------
 	/**
-	 * @brief TestVersions Сверка версий
-	 * @param currentFileVersion Текущая версия файла
-	 * @param updateFileVersion Версия файла из обновления
-	 * @return true если необходимо обновить файл
+	 * @brief OutdatedFiles Файлы клиента, не соответствующие манифесту
+	 * @param list Файлы манифеста
+	 * @param directory Директория клиента
+	 * @param operation Операция (после отмены сверка прекращается)
+	 * @return Устаревшие файлы
 	 */
-	static bool TestVersions(const QString &currentFileVersion, const QString &updateFileVersion)
+	static QList<CUpdateInfo> OutdatedFiles(const QList<CUpdateInfo> &list, const QString &directory, const COperation &operation)
 	{
-		QStringList currentVersionList = currentFileVersion.split('.');
-		QStringList updateVersionList = updateFileVersion.split('.');
-		int count = currentVersionList.size();
-
-		if (count != updateVersionList.size())
-			return true;
+		QList<CUpdateInfo> outdated;
 
-		for (int i = 0; i < count; i++)
+		for (const CUpdateInfo &info : list)
 		{
-			int currentVersionInt = currentVersionList[i].toInt();
-			int updateVersionInt = updateVersionList[i].toInt();
+			if (operation.Stopped())
+				break;
 
-			if (updateVersionInt > currentVersionInt)
-				return true;
-			else if (updateVersionInt < currentVersionInt)
-				return false;
+			if (NeedUpdate(info, directory + "/" + info.Name))
+				outdated.push_back(info);
 		}
 
-		return false;
+		return outdated;
 	}
+
 	//----------------------------------------------------------------------------------
 	/**
-	 * @brief CheckUpdates Функция проверки обновлений
+	 * @brief UpdateAllInstalls Обновление всех установок клиента за один проход
+	 * Манифест запрашивается один раз, установки сверяются с ним параллельно, каждый архив скачивается
+	 * один раз и распаковывается во все установки, которым он нужен. Файлы лаунчера не обновляются:
+	 * для них нужен перезапуск, это делает обычное обновление.
 	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
 	 * @param receiver Приемнник сигналов
+	 * @param directories Директории клиентов
+	 * @param operation Операция (отмена, срок выполнения)
 	 */
-	static void CheckUpdates(const QStringList &params, T *receiver)
+	static void UpdateAllInstalls(const QStringList &params, T *receiver, const QStringList &directories, const COperation &operation)
 	{
-		if (receiver == nullptr)
+		if (receiver == nullptr || operation.IsCancelled())
 			return;
 
-		if (params.size() >= 3)
+		QList<CInstallUpdateResult> results;
+
+		if (params.size() < 3 || directories.isEmpty())
 		{
-			CUpdateManager<T> manager(receiver, RT_CHECK_UPDATES, "", true, "");
+			//! Защита от зависания, уведомим ресивера о окончании процедуры
+			emit receiver->signal_InstallsUpdated(results);
+			return;
+		}
 
-			manager.ConnectToPage(params.at(0), params.at(1), params.at(2));
+		CUpdateManager<T> manager(receiver, RT_CHECK_UPDATES, "", false, "");
+		manager.m_UseCache = true;
+		manager.m_Operation = operation;
+
+		QList<CUpdateInfo> manifest;
+		QList<CBackupInfo> backups;
+
+		if (!manager.DownloadManifest(params.at(0), params.at(1), params.at(2), manifest, backups))
+		{
+			if (!operation.IsCancelled())
+				emit receiver->signal_InstallsUpdated(results);
+
+			return;
 		}
-		else
+
+		QList<CUpdateInfo> clientFiles;
+
+		for (const CUpdateInfo &info : manifest)
 		{
-			//! Защита от зависания, уведомим ресивера о окончании процедуры
-			emit receiver->signal_BackupsListReceived(QList<CBackupInfo>());
-			emit receiver->signal_UpdatesListReceived(QList<CUpdateInfo>());
+			if (info.UODir == "yes")
+				clientFiles.push_back(info);
+		}
+
+		QList<QFuture<QList<CUpdateInfo>>> diffs;
+
+		for (const QString &directory : directories)
+			diffs.push_back(QtConcurrent::run(&CUpdateManager<T>::OutdatedFiles, clientFiles, directory, operation));
+
+		QString launcherDirectory = QCoreApplication::applicationDirPath();
+
+		manager.m_SharedDirectory = CPackageCache::Directory() + "/batch";
+		QDir(manager.m_SharedDirectory).removeRecursively();
+		QDir().mkpath(manager.m_SharedDirectory);
+
+		for (int i = 0; i < directories.size(); i++)
+		{
+			//! Сверки остальных установок прекращаются сами, их результаты не нужны
+			if (operation.Stopped())
+			{
+				diffs[i].waitForFinished();
+				continue;
+			}
+
+			CInstallUpdateResult result;
+			result.Directory = directories.at(i);
+
+			QList<CUpdateInfo> list = diffs[i].result();
+			result.Outdated = list.size();
+
+			manager.m_ProgressOffset = (i * 100) / directories.size();
+			manager.m_ProgressRange = ((i + 1) * 100) / directories.size() - manager.m_ProgressOffset;
+
+			if (list.size())
+			{
+				SelectPatches(list, directories.at(i), launcherDirectory);
+
+				result.Failed = manager.RunPlan(params.at(0), params.at(1), CUpdatePlanner::Build(list, directories.at(i), launcherDirectory)).size();
+			}
+
+			results.push_back(result);
+
+			operation.Publish(manager.m_ProgressOffset + manager.m_ProgressRange, manager.m_Received);
 		}
+
+		QDir(manager.m_SharedDirectory).removeRecursively();
+
+		if (!operation.IsCancelled())
+			emit receiver->signal_InstallsUpdated(results);
 	}
 
 	//----------------------------------------------------------------------------------
 	/**
-	 * @brief DownloadFile Получение файла
-	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
+	 * @brief RestoreSnapshot Откат установки клиента к локальному снимку
 	 * @param receiver Приемнник сигналов
-	 * @param filePathToSave Путь для сохранения файла
-	 * @param autoUnzipAndDeleteZip Автоматическая распаковка файла
+	 * @param directory Директория клиента
+	 * @param id Идентификатор снимка
+	 * @param operation Операция (начатый откат не прерывается, отмена только не отправляет результат)
 	 */
-	static void DownloadFile(const QStringList &params, T *receiver, const QString &filePathToSave, const bool &autoUnzipAndDeleteZip)
+	static void RestoreSnapshot(T *receiver, const QString &directory, const QString &id, const COperation &operation)
 	{
-		if (receiver == nullptr)
+		if (receiver == nullptr || operation.IsCancelled())
 			return;
 
-		if (params.size() >= 3)
-		{
-			CUpdateManager<T> manager(receiver, RT_DOWNLOAD_FILE, filePathToSave, autoUnzipAndDeleteZip, "");
+		if (!CInstallSnapshot::Restore(directory, id))
+			qDebug() << "Snapshot was not fully restored:" << id;
 
-			manager.ConnectToPage(params.at(0), params.at(1), params.at(2));
-		}
-		else
-		{
-			//! Защита от зависания, уведомим ресивера о окончании процедуры
-			emit receiver->signal_FileReceivedNotification(filePathToSave);
-		}
+		if (!operation.IsCancelled())
+			emit receiver->signal_FileReceivedNotification(directory);
 	}
 
 	//----------------------------------------------------------------------------------
 	/**
-	 * @brief GetChangelog Функция получения истории изменений
-	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
+	 * @brief DeduplicateInstalls Объединение одинаковых файлов установок клиента
 	 * @param receiver Приемнник сигналов
+	 * @param directories Директории клиентов
+	 * @param operation Операция (отмена прерывает поиск и хэширование, связанные файлы остаются связанными)
 	 */
-	static void GetChangelog(const QStringList &params, T *receiver)
+	static void DeduplicateInstalls(T *receiver, const QStringList &directories, const COperation &operation)
 	{
-		if (receiver == nullptr)
+		if (receiver == nullptr || operation.IsCancelled())
 			return;
 
-		if (params.size() >= 3)
-		{
-			CUpdateManager<T> manager(receiver, RT_GET_CHANGELOG, "", true, "");
+		CBackgroundPriority priority;
 
-			manager.ConnectToPage(params.at(0), params.at(1), params.at(2));
-		}
-		else
-		{
-			//! Защита от зависания, уведомим ресивера о окончании процедуры
-			emit receiver->signal_ChangelogReceived("");
-		}
+		QString summary = CInstallDedup::Run(directories, operation).Summary();
+
+		if (!operation.IsCancelled())
+			emit receiver->signal_InstallsDeduplicated(summary);
 	}
 
 	//----------------------------------------------------------------------------------
 	/**
-	 * @brief AutoUpdate Автоматическое обновление
+	 * @brief VerifyInstallation Проверка установленного клиента
 	 * @param params Параметры подключения [0] - host, [1] - path, [2] - page
 	 * @param receiver Приемнник сигналов
-	 * @param directoryToSave Путь к директории для сохранения файлов
+	 * @param directory Директория клиента
+	 * @param operation Операция (отмена, срок выполнения)
 	 */
-	static void AutoUpdate(const QStringList &params, T *receiver, const QString &directoryToSave)
+	static void VerifyInstallation(const QStringList &params, T *receiver, const QString &directory, const COperation &operation)
 	{
-		if (receiver == nullptr)
+		if (receiver == nullptr || operation.IsCancelled())
 			return;
 
 		if (params.size() >= 3)
 		{
-			CUpdateManager<T> manager(receiver, RT_AUTO_UPDATE, "", true, directoryToSave);
+			CUpdateManager<T> manager(receiver, RT_VERIFY_INSTALL, "", true, directory);
+			manager.m_Operation = operation;
 
 			manager.ConnectToPage(params.at(0), params.at(1), params.at(2));
 		}
 		else
 		{
 			//! Защита от зависания, уведомим ресивера о окончании процедуры
-			emit receiver->signal_AutoUpdateNotification();
+			emit receiver->signal_InstallationVerified(QList<CUpdateInfo>(), "");
 		}
 	}
 
 	//----------------------------------------------------------------------------------
 	/**
-	 * @brief ConnectToPage Подключение к страничке
+	 * @brief Download Получение страницы
 	 * @param host Адрес хоста ("www.somehost.ru")
 	 * @param path Путь к странице ("/Downloads/")
 	 * @param page Страница ("Update.html")
+	 * @param result Массив полученных данных
+	 * @return true если сервер ответил кодом 200
 	 */
-	void ConnectToPage(const QString &host, const QString &path, const QString &page)
+	bool Download(const QString &host, const QString &path, const QString &page, QByteArray &result)
 	{
-		QByteArray result;
+		return Request("GET", host, path, page, &result, nullptr, "");
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Request HTTP запрос
+	 * @param verb Метод ("GET", "HEAD")
+	 * @param host Адрес хоста (можно с портом: "192.168.1.10:8090")
+	 * @param path Путь к странице
+	 * @param page Страница
+	 * @param result Массив полученных данных (nullptr - тело не читается)
+	 * @param contentLength Размер из заголовка Content-Length (nullptr - не нужен, -1 если не указан)
+	 * @param range Диапазон байт ("0-4095", пусто - весь файл)
+	 * @return true если сервер ответил кодом 200 (для диапазона - 206)
+	 */
+	bool Request(const char *verb, const QString &host, const QString &path, const QString &page, QByteArray *result, qint64 *contentLength, const QString &range)
+	{
+		bool ok = false;
+
+		m_Status = 0;
+
+		if (m_Operation.Stopped())
+			return false;
 
 		HINTERNET session = InternetOpen(NULL, INTERNET_OPEN_TYPE_PRECONFIG, 0, 0, 0);
 
 		if (session)
 		{
-			HINTERNET connect = InternetConnectA(session, host.toLocal8Bit(), INTERNET_DEFAULT_HTTP_PORT, 0, 0, INTERNET_SERVICE_HTTP, 0, 1);
+			//! Заблокированный вызов WinINet не проверяет срок сам - ограничиваем его таймаутами
+			qint64 remaining = m_Operation.Remaining();
+
+			if (remaining >= 0)
+			{
+				DWORD timeout = (DWORD)qMax(remaining, (qint64)1);
+
+				InternetSetOptionA(session, INTERNET_OPTION_CONNECT_TIMEOUT, &timeout, sizeof(timeout));
+				InternetSetOptionA(session, INTERNET_OPTION_SEND_TIMEOUT, &timeout, sizeof(timeout));
+				InternetSetOptionA(session, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeout, sizeof(timeout));
+			}
+
+			//! Сосед-зеркало в локальной сети указывается с портом ("192.168.1.10:8090")
+			QString hostName = host;
+			INTERNET_PORT port = INTERNET_DEFAULT_HTTP_PORT;
+			int colon = host.lastIndexOf(':');
+
+			if (colon != -1)
+			{
+				port = (INTERNET_PORT)host.mid(colon + 1).toUShort();
+				hostName = host.left(colon);
+			}
+
+			HINTERNET connect = InternetConnectA(session, hostName.toLocal8Bit(), port, 0, 0, INTERNET_SERVICE_HTTP, 0, 1);
 
 			if (connect)
 			{
-				HINTERNET request = HttpOpenRequestA(connect, "GET", (path + page).toLocal8Bit(), HTTP_VERSIONA, 0, 0, INTERNET_FLAG_KEEP_CONNECTION | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD, 1);
+				HINTERNET request = HttpOpenRequestA(connect, verb, (path + page).toLocal8Bit(), HTTP_VERSIONA, 0, 0, INTERNET_FLAG_KEEP_CONNECTION | INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD, 1);
+
+				//! Отмена закрывает запрос из другого потока, прерывая отправку и чтение
+				if (request && !m_Operation.Attach(request))
+				{
+					InternetCloseHandle(request);
+					request = NULL;
+				}
 
 				if (request)
 				{
-					if (HttpSendRequest(request, 0, 0, 0, 0))
+					QByteArray headers = (range.length() ? "Range: bytes=" + range.toLatin1() + "\r\n" : QByteArray()) + m_RequestHeaders;
+
+					if (HttpSendRequestA(request, headers.length() ? headers.constData() : 0, (DWORD)headers.length(), 0, 0))
 					{
-						ReceiveData(request, result);
+						DWORD status = 0;
+						DWORD statusSize = sizeof(status);
+
+						if (HttpQueryInfoA(request, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &status, &statusSize, 0))
+						{
+							ok = (status == (range.length() ? HTTP_STATUS_PARTIAL_CONTENT : HTTP_STATUS_OK));
+							m_Status = (int)status;
+						}
+
+						//! Валидаторы для условных запросов (If-None-Match / If-Modified-Since)
+						char validator[256] = { 0 };
+						DWORD validatorSize = sizeof(validator) - 1;
+
+						m_ETag = (HttpQueryInfoA(request, HTTP_QUERY_ETAG, validator, &validatorSize, 0) ? QString::fromLatin1(validator).trimmed() : QString());
+
+						memset(validator, 0, sizeof(validator));
+						validatorSize = sizeof(validator) - 1;
+
+						m_LastModified = (HttpQueryInfoA(request, HTTP_QUERY_LAST_MODIFIED, validator, &validatorSize, 0) ? QString::fromLatin1(validator).trimmed() : QString());
+
+						//! Подсказка сервера, когда приходить снова
+						char retryAfter[64] = { 0 };
+						DWORD retryAfterSize = sizeof(retryAfter) - 1;
+						char cacheControl[256] = { 0 };
+						DWORD cacheControlSize = sizeof(cacheControl) - 1;
+
+						if (!HttpQueryInfoA(request, HTTP_QUERY_RETRY_AFTER, retryAfter, &retryAfterSize, 0))
+							retryAfter[0] = 0;
+
+						if (!HttpQueryInfoA(request, HTTP_QUERY_CACHE_CONTROL, cacheControl, &cacheControlSize, 0))
+							cacheControl[0] = 0;
+
+						m_PollHint = CPollSchedule::ParseServerHint(QByteArray(retryAfter), QByteArray(cacheControl));
+
+						if (contentLength != nullptr)
+						{
+							DWORD length = 0;
+							DWORD lengthSize = sizeof(length);
+
+							if (ok && HttpQueryInfoA(request, HTTP_QUERY_CONTENT_LENGTH | HTTP_QUERY_FLAG_NUMBER, &length, &lengthSize, 0))
+								*contentLength = (qint64)length;
+							else
+								*contentLength = -1;
+						}
+
+						//! Сервер без поддержки Range вернул бы весь файл целиком - такой ответ не принимаем
+						if (result != nullptr && (ok || !range.length()))
+							ok = (ReceiveData(request, *result) && ok);
 					}
 					else
 						qDebug() << "HttpSendRequest error";
 
-					InternetCloseHandle(request);
+					if (m_Operation.Detach(request))
+						InternetCloseHandle(request);
 				}
 				else
 					qDebug() << "Request error";
@@ -393,18 +2108,43 @@ public:
 			qDebug() << "Session error";
 		}
 
+		return ok;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ConnectToPage Подключение к страничке
+	 * @param host Адрес хоста ("www.somehost.ru")
+	 * @param path Путь к странице ("/Downloads/")
+	 * @param page Страница ("Update.html")
+	 */
+	void ConnectToPage(const QString &host, const QString &path, const QString &page)
+	{
+		QByteArray result;
+		QList<CUpdateInfo> updateList;
+		QList<CBackupInfo> backupsList;
+
+		bool manifestReceived = false;
+
+		//! Манифест разбирается по мере получения, остальные запросы накапливают данные
+		if (m_Type == RT_CHECK_UPDATES || m_Type == RT_VERIFY_INSTALL || (m_Type == RT_AUTO_UPDATE && !m_UpdateList.length()))
+			manifestReceived = DownloadManifest(host, path, page, updateList, backupsList);
+		else if (m_Type == RT_DOWNLOAD_FILE && m_FilePathToSave.length())
+			DownloadStored(host, path, page);
+		else
+			Download(host, path, page, result);
+
 		//qDebug() <<result.data();
 
+		//! Отмененная операция результат не отправляет (автообновление тоже не продолжается)
+		if (m_Operation.IsCancelled())
+			return;
+
 		//! В зависимости от типа производим определенные операции
 		switch (m_Type)
 		{
 			case RT_CHECK_UPDATES:
 			{
-				QList<CUpdateInfo> updateList;
-				QList<CBackupInfo> backupsList;
-
-				ParseXML(result, updateList, backupsList);
-
 				emit m_Receiver->signal_BackupsListReceived(backupsList);
 				emit m_Receiver->signal_UpdatesListReceived(updateList);
 
@@ -421,9 +2161,33 @@ public:
 
 				break;
 			}
-			case RT_GET_CHANGELOG:
+			case RT_VERIFY_INSTALL:
 			{
-				emit m_Receiver->signal_ChangelogReceived( QString::fromLocal8Bit(result) );
+				//! Без манифеста (или с его частью, если вышел срок) нельзя отличить поврежденные файлы от нормальных
+				if (!updateList.size() || m_Operation.Stopped())
+				{
+					emit m_Receiver->signal_InstallationVerified(QList<CUpdateInfo>(), "");
+					break;
+				}
+
+				CVerifyReport report = CInstallVerifier::Verify(m_DirectoryToSave, updateList, &TestVersions, m_Operation);
+
+				//! Прерванная проверка отчета не дает: отмененная ничего не отправляет, по сроку - пустой результат
+				if (m_Operation.Stopped())
+				{
+					if (!m_Operation.IsCancelled())
+						emit m_Receiver->signal_InstallationVerified(QList<CUpdateInfo>(), "");
+
+					break;
+				}
+
+				report.Save(QDir::currentPath() + "/VerifyReport.xml");
+
+				//! Поврежденные файлы могли лежать в уже синхронизированных узлах дерева
+				if (report.RepairList.size())
+					QFile::remove(CMerkleTreeState::StatePath(CInstallVerifier::InventoryPath(m_DirectoryToSave)));
+
+				emit m_Receiver->signal_InstallationVerified(report.RepairList, report.Summary());
 
 				break;
 			}
@@ -432,20 +2196,14 @@ public:
 				//! Обрабатываем только первый вызов автообновления
 				if (!m_UpdateList.length())
 				{
-					QList<CBackupInfo> backupsList;
-					ParseXML(result, m_UpdateList, backupsList);
-
-					int updatesSize = m_UpdateList.size();
+					m_UpdateList = updateList;
 
-					for (int i = 0; i < updatesSize; i++)
+					//! Без полного манифеста обновлять нечего: план по его части оставил бы клиент несогласованным
+					if (manifestReceived)
 					{
-						const CUpdateInfo &info = m_UpdateList[i];
-
-						m_FilePathToSave = m_DirectoryToSave + "/" + info.ZipFileName;
-
-						ConnectToPage(host, path, info.ZipFileName);
-
-						emit m_Receiver->signal_AutoUpdateProgress((i * 100) / updatesSize);
+						//! При автообновлении все файлы лежат в одной директории
+						SelectPatches(m_UpdateList, m_DirectoryToSave, m_DirectoryToSave);
+						RunPlan(host, path, CUpdatePlanner::Build(m_UpdateList, m_DirectoryToSave, m_DirectoryToSave));
 					}
 
 					emit m_Receiver->signal_AutoUpdateNotification();
@@ -463,134 +2221,58 @@ public:
 	 * @brief GetFileInfo Получить информацию о файле
 	 * @param path Путь к файлу
 	 * @param version Версия файла
-	 * @param crc32 CRC32 файла
+	 * @param hash Контрольная сумма файла
+	 * @param algorithm Алгоритм контрольной суммы
+	 * @param throttle Ограничитель фонового чтения (файл читается порциями вместо отображения)
 	 * @return true если файл открылся для чтения, false если файла нет или не открылся
 	 */
-	static bool GetFileInfo(const QString &path, QString &version, QString &crc32)
-	{
-		//! Таблица для CRC32, можно заменить на генерацию
-		const uint crcTable[256] =
-		{
-			0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA,
-			0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
-			0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988,
-			0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
-			0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE,
-			0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
-			0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC,
-			0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
-			0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172,
-			0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
-			0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940,
-			0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
-			0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116,
-			0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
-			0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924,
-			0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
-			0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A,
-			0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
-			0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818,
-			0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
-			0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E,
-			0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
-			0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C,
-			0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
-			0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2,
-			0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
-			0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0,
-			0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
-			0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086,
-			0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
-			0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4,
-			0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
-			0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A,
-			0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
-			0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8,
-			0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
-			0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE,
-			0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
-			0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC,
-			0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
-			0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252,
-			0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
-			0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60,
-			0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
-			0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236,
-			0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
-			0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04,
-			0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
-			0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A,
-			0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
-			0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38,
-			0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
-			0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E,
-			0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
-			0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C,
-			0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
-			0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2,
-			0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
-			0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0,
-			0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
-			0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6,
-			0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
-			0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94,
-			0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D
-		};
-
+	static bool GetFileInfo(const QString &path, QString &version, QString &hash, const HASH_ALGORITHM &algorithm = HA_CRC32, CIoThrottle *throttle = nullptr)
+	{
 		QFile file(path);
 
 		version = "";
-		crc32 = "";
+		hash = "";
 
 		if (!file.open(QIODevice::ReadOnly))
 			return false;
 
-		uint crc = 0xFFFFFFFF;
-
-		QByteArray fileData = file.readAll();
-		file.close();
-
-		//! Вычисляем CRC32 файла
-		for (const uchar &c : fileData)
-			crc = (crc >> 8) ^ crcTable[(crc & 0xFF) ^ c];
-
-		crc32.sprintf("%08X", (crc ^ 0xFFFFFFFF));
-
-		DWORD dummy = 0;
-		DWORD dwSize = GetFileVersionInfoSizeA(path.toLocal8Bit(), &dummy);
+		//! Одно отображение файла используется и для контрольной суммы, и для версии
+		qint64 size = file.size();
+		uchar *data = (size > 0 && throttle == nullptr ? file.map(0, size) : nullptr);
 
-		//! Получаем версию файла
-		if (dwSize > 0)
+		if (data != nullptr)
 		{
-			QByteArray lpVersionInfo(dwSize, 0);
+			hash = CHashCalculator::HashData(data, size, algorithm);
 
-			if (GetFileVersionInfoA(path.toLocal8Bit(), 0, dwSize, lpVersionInfo.data()))
-			{
-				UINT uLen = 0;
-				VS_FIXEDFILEINFO *lpFfi = NULL;
+			quint16 parts[4] = { 0, 0, 0, 0 };
 
-				VerQueryValue(lpVersionInfo.data(), L"\\", (LPVOID *)&lpFfi, &uLen);
+			if (CPEVersionReader::ReadVersion(data, size, parts))
+				version.sprintf("%i.%i.%i.%i", parts[0], parts[1], parts[2], parts[3]);
 
-				DWORD dwFileVersionMS = 0;
-				DWORD dwFileVersionLS = 0;
+			file.unmap(data);
+			file.close();
 
-				if (lpFfi != NULL)
-				{
-					dwFileVersionMS = lpFfi->dwFileVersionMS;
-					dwFileVersionLS = lpFfi->dwFileVersionLS;
-				}
+			return true;
+		}
 
-				int dwLeftMost = (int)HIWORD(dwFileVersionMS);
-				int dwSecondLeft = (int)LOWORD(dwFileVersionMS);
-				int dwSecondRight = (int)HIWORD(dwFileVersionLS);
-				int dwRightMost = (int)LOWORD(dwFileVersionLS);
+		hash = CHashCalculator::HashFile(file, algorithm, throttle);
+		file.close();
 
-				version.sprintf("%i.%i.%i.%i", dwLeftMost, dwSecondLeft, dwSecondRight, dwRightMost);
-			}
-		}
+		GetFileVersion(path, version);
 
 		return true;
 	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief GetFileVersion Получить версию файла из ресурсов
+	 * @param path Путь к файлу
+	 * @param version Версия файла (пустая строка если версии нет)
+	 */
+	static void GetFileVersion(const QString &path, QString &version)
+	{
+		CPEVersionReader::ReadFileVersion(path, version);
+	}
 };
 //----------------------------------------------------------------------------------
 #endif // UPDATEMANAGER_H
@@ -0,0 +1,441 @@
+/**
+@file UpdateNotifier.hpp
+
+@brief Уведомления о выходе обновлений (подписка) и расписание опроса со случайным разбросом
+
+Подписка - GET на настраиваемый адрес с заголовком "Accept: text/event-stream":
+@code
+HTTP/1.1 200 OK                       HTTP/1.1 200 OK
+Content-Type: text/event-stream       Content-Type: text/plain
+
+id: 7f3a...                           7f3a...
+event: release
+data: 7f3a...
+@endcode
+Слева - server-sent events: соединение держится открытым, каждое событие "release" (или без типа)
+означает новый выпуск. Справа - long-poll: сервер держит запрос, пока выпуск не сменится
+с переданного в ?last=, и отвечает идентификатором нового выпуска (204 - ничего не произошло).
+В обоих режимах первым сервер сообщает текущий выпуск (без ?last= long-poll отвечает сразу).
+**/
+//----------------------------------------------------------------------------------
+#ifndef UPDATENOTIFIER_H
+#define UPDATENOTIFIER_H
+//----------------------------------------------------------------------------------
+#include <windows.h>
+#include <Wininet.h>
+#include <random>
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QLocale>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QThreadPool>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include <QDebug>
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CPollSchedule class
+ * Интервал опроса: растет вдвое, пока обновлений нет, сбрасывается при новом выпуске,
+ * не меньше подсказки сервера (Retry-After / Cache-Control: max-age), со случайным разбросом ±25%
+ */
+class CPollSchedule
+{
+private:
+	//! Начальный интервал, мс
+	enum { BASE_INTERVAL_MS = 15 * 60 * 1000 };
+
+	//! Максимальный интервал (и интервал при активной подписке), мс
+	enum { MAX_INTERVAL_MS = 2 * 60 * 60 * 1000 };
+
+	//! Текущий интервал без разброса, мс
+	int m_Interval{ BASE_INTERVAL_MS };
+
+	//----------------------------------------------------------------------------------
+	static QAtomicInt &ServerHint()
+	{
+		static QAtomicInt hint(0);
+		return hint;
+	}
+
+public:
+	CPollSchedule() {}
+	~CPollSchedule() {}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Jitter Случайное значение в диапазоне [value * 3/4, value * 5/4]
+	 * У каждого лаунчера свой генератор: одновременно запущенные лаунчеры расходятся во времени
+	 * @param value Значение
+	 * @return Значение с разбросом
+	 */
+	static int Jitter(const int &value)
+	{
+		static QMutex mutex;
+		static std::mt19937 generator((unsigned int)(std::random_device()() ^ (unsigned int)QDateTime::currentMSecsSinceEpoch() ^ (unsigned int)GetCurrentProcessId()));
+
+		QMutexLocker locker(&mutex);
+
+		return (int)std::uniform_int_distribution<qint64>(value * 3LL / 4, value * 5LL / 4)(generator);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief ParseServerHint Минимальный интервал опроса из заголовков ответа
+	 * @param retryAfter Retry-After: секунды или дата HTTP ("Wed, 21 Oct 2026 07:28:00 GMT")
+	 * @param cacheControl Cache-Control (учитывается max-age)
+	 * @return Секунды (0 - подсказки нет)
+	 */
+	static int ParseServerHint(const QByteArray &retryAfter, const QByteArray &cacheControl)
+	{
+		int seconds = 0;
+		QByteArray value = retryAfter.trimmed();
+
+		if (value.length())
+		{
+			bool number = false;
+			seconds = value.toInt(&number);
+
+			if (!number)
+			{
+				QDateTime date = QLocale::c().toDateTime(QString::fromLatin1(value), "ddd, dd MMM yyyy HH:mm:ss 'GMT'");
+				date.setTimeSpec(Qt::UTC);
+
+				seconds = (date.isValid() ? (int)qMax(QDateTime::currentDateTimeUtc().secsTo(date), (qint64)0) : 0);
+			}
+		}
+
+		for (const QByteArray &directive : cacheControl.split(','))
+		{
+			QByteArray item = directive.trimmed().toLower();
+
+			if (item.startsWith("max-age="))
+				seconds = qMax(seconds, item.mid(8).toInt());
+		}
+
+		return qMax(seconds, 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief SetServerHint Запомнить минимальный интервал опроса, указанный сервером
+	 * @param seconds Секунды (0 - подсказки нет)
+	 */
+	static void SetServerHint(const int &seconds)
+	{
+		ServerHint().store(qBound(0, seconds, (int)(MAX_INTERVAL_MS / 1000)));
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Вышел новый выпуск - опрашиваем снова с начального интервала
+	void Reset()
+	{
+		m_Interval = BASE_INTERVAL_MS;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Ничего не изменилось - следующий опрос вдвое позже
+	void Backoff()
+	{
+		m_Interval = qMin(m_Interval * 2, (int)MAX_INTERVAL_MS);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Next Интервал до следующего опроса
+	 * @param subscribed Подписка активна (опрос нужен только как страховка)
+	 * @return Интервал, мс
+	 */
+	int Next(const bool &subscribed) const
+	{
+		int interval = (subscribed ? (int)MAX_INTERVAL_MS : m_Interval);
+
+		return Jitter(qMax(interval, ServerHint().load() * 1000));
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CUpdateNotifier class
+ * Постоянное соединение с адресом уведомлений в отдельном потоке (Pool()).
+ * При обрыве - переподключение с экспоненциальной паузой и разбросом.
+ */
+template<typename T>
+class CUpdateNotifier
+{
+private:
+	//! Минимальная пауза перед переподключением, мс
+	enum { MIN_RETRY_MS = 5 * 1000 };
+
+	//! Максимальная пауза перед переподключением, мс
+	enum { MAX_RETRY_MS = 10 * 60 * 1000 };
+
+	//! Время ожидания ответа на запрос long-poll / события, мс
+	enum { RECEIVE_TIMEOUT_MS = 15 * 60 * 1000 };
+
+	//! Разброс запуска проверки после уведомления (все лаунчеры получают его одновременно), мс
+	enum { NOTIFY_SPREAD_MS = 60 * 1000 };
+
+	//! Максимальный размер непрочитанного ответа (строки события или ответа long-poll), байт
+	enum { MAX_BUFFER_SIZE = 64 * 1024 };
+
+	//----------------------------------------------------------------------------------
+	static QMutex &Mutex()
+	{
+		static QMutex mutex;
+		return mutex;
+	}
+
+	//! Открытая сессия (закрывается из Stop, чтобы прервать ожидание)
+	static HINTERNET &Session()
+	{
+		static HINTERNET session = NULL;
+		return session;
+	}
+
+	static QAtomicInt &Stopped()
+	{
+		static QAtomicInt stopped(0);
+		return stopped;
+	}
+
+	static QAtomicInt &Subscribed()
+	{
+		static QAtomicInt subscribed(0);
+		return subscribed;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Пауза, прерываемая Stop
+	static void Sleep(const int &ms)
+	{
+		for (int i = 0; i < ms && !Stopped().load(); i += 100)
+			QThread::msleep(100);
+	}
+
+	//----------------------------------------------------------------------------------
+	static void Notify(T *receiver, const QByteArray &release, QByteArray &lastRelease)
+	{
+		if (release.isEmpty() || release == lastRelease)
+			return;
+
+		bool first = lastRelease.isEmpty();
+		lastRelease = release;
+
+		//! Первое значение после подключения - текущий выпуск, а не новый
+		if (first)
+			return;
+
+		Sleep(CPollSchedule::Jitter(NOTIFY_SPREAD_MS / 2));
+
+		//! Проверка и сигнал под тем же мьютексом, что и Stop: после Stop приемник больше не трогаем
+		QMutexLocker locker(&Mutex());
+
+		if (!Stopped().load())
+			emit receiver->signal_UpdatesNotification();
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Listen Одно подключение к адресу уведомлений
+	 * @param url Адрес
+	 * @param receiver Приемник сигналов
+	 * @param lastRelease Последний известный выпуск
+	 * @return true если сервер ответил (подписка поддерживается)
+	 */
+	static bool Listen(const QString &url, T *receiver, QByteArray &lastRelease)
+	{
+		QUrl requestUrl(url);
+
+		if (lastRelease.length())
+		{
+			QUrlQuery query(requestUrl);
+			query.addQueryItem("last", QString::fromLatin1(lastRelease));
+			requestUrl.setQuery(query);
+		}
+
+		HINTERNET session = InternetOpen(NULL, INTERNET_OPEN_TYPE_PRECONFIG, 0, 0, 0);
+
+		if (!session)
+			return false;
+
+		DWORD timeout = RECEIVE_TIMEOUT_MS;
+		InternetSetOption(session, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeout, sizeof(timeout));
+
+		{
+			QMutexLocker locker(&Mutex());
+
+			if (Stopped().load())
+			{
+				InternetCloseHandle(session);
+				return false;
+			}
+
+			Session() = session;
+		}
+
+		QByteArray headers = "Accept: text/event-stream\r\nCache-Control: no-cache\r\n";
+		bool result = false;
+
+		HINTERNET request = InternetOpenUrlA(session, requestUrl.toEncoded().constData(), headers.constData(), (DWORD)headers.length(), INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE, 0);
+
+		if (request)
+		{
+			DWORD status = 0;
+			DWORD statusSize = sizeof(status);
+			char contentType[128] = { 0 };
+			DWORD contentTypeSize = sizeof(contentType) - 1;
+
+			HttpQueryInfoA(request, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &status, &statusSize, 0);
+			bool eventStream = (HttpQueryInfoA(request, HTTP_QUERY_CONTENT_TYPE, contentType, &contentTypeSize, 0) && QByteArray(contentType).trimmed().startsWith("text/event-stream"));
+
+			result = (status == HTTP_STATUS_OK || status == HTTP_STATUS_NO_CONTENT);
+
+			if (status == HTTP_STATUS_OK)
+			{
+				Subscribed().store(1);
+
+				QByteArray buffer;
+				QByteArray event;
+				QByteArray data;
+				char temp[4096];
+				DWORD nbr = 0;
+
+				while (!Stopped().load() && InternetReadFile(request, temp, sizeof(temp), &nbr) && nbr)
+				{
+					buffer.append(temp, (int)nbr);
+
+					if (buffer.size() > MAX_BUFFER_SIZE)
+					{
+						qDebug() << "Updates notification response is too long, reconnecting";
+						buffer.clear();
+						break;
+					}
+
+					if (!eventStream)
+						continue;
+
+					//! Событие заканчивается пустой строкой, нас интересуют поля event и data
+					for (int end = buffer.indexOf('\n'); end != -1; end = buffer.indexOf('\n'))
+					{
+						QByteArray line = buffer.left(end).trimmed();
+						buffer.remove(0, end + 1);
+
+						if (line.startsWith("data:"))
+							data = line.mid(5).trimmed();
+						else if (line.startsWith("event:"))
+							event = line.mid(6).trimmed();
+						else if (line.isEmpty())
+						{
+							if (event.isEmpty() || event == "release")
+								Notify(receiver, data, lastRelease);
+
+							event.clear();
+							data.clear();
+						}
+					}
+				}
+
+				if (!eventStream)
+					Notify(receiver, buffer.trimmed(), lastRelease);
+			}
+
+			InternetCloseHandle(request);
+		}
+
+		{
+			QMutexLocker locker(&Mutex());
+
+			if (Session() != NULL)
+				InternetCloseHandle(Session());
+
+			Session() = NULL;
+		}
+
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	static QThreadPool *CreatePool()
+	{
+		QThreadPool *pool = new QThreadPool();
+		pool->setMaxThreadCount(1);
+
+		return pool;
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	//! Отдельный поток для постоянного соединения (не занимает общий пул и фоновые проверки)
+	static QThreadPool *Pool()
+	{
+		static QThreadPool *pool = CreatePool();
+
+		return pool;
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Подписка активна (соединение установлено и сервер ответил)
+	static bool IsSubscribed()
+	{
+		return (Subscribed().load() != 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Run Поддерживать подписку до вызова Stop. Запускать через Pool().
+	 * @param url Адрес уведомлений ("http://localhost:8080/notify")
+	 * @param receiver Приемник сигналов (signal_UpdatesNotification)
+	 */
+	static void Run(const QString &url, T *receiver)
+	{
+		if (receiver == nullptr || !url.length())
+			return;
+
+		QByteArray lastRelease;
+		int retry = MIN_RETRY_MS;
+
+		while (!Stopped().load())
+		{
+			QElapsedTimer timer;
+			timer.start();
+
+			bool answered = Listen(url, receiver, lastRelease);
+			Subscribed().store(answered ? 1 : 0);
+
+			//! Ответ после долгого ожидания - нормальная работа long-poll, переподключаемся сразу
+			if (answered && timer.elapsed() > MIN_RETRY_MS)
+			{
+				retry = MIN_RETRY_MS;
+				continue;
+			}
+
+			if (!answered)
+				qDebug() << "Updates notification endpoint is unavailable, retry in" << retry / 1000 << "s";
+
+			Sleep(CPollSchedule::Jitter(retry));
+			retry = qMin(retry * 2, (int)MAX_RETRY_MS);
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	//! Остановить подписку (прерывает ожидание ответа сервера); после возврата сигналов больше не будет
+	static void Stop()
+	{
+		QMutexLocker locker(&Mutex());
+
+		Stopped().store(1);
+
+		if (Session() != NULL)
+		{
+			InternetCloseHandle(Session());
+			Session() = NULL;
+		}
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // UPDATENOTIFIER_H
+//----------------------------------------------------------------------------------
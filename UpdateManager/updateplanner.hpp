@@ -0,0 +1,391 @@
+/**
+@file UpdatePlanner.hpp
+
+@brief План применения обновлений: уникальные архивы, порядок действий, оценка объема и времени
+**/
+//----------------------------------------------------------------------------------
+#ifndef UPDATEPLANNER_H
+#define UPDATEPLANNER_H
+//----------------------------------------------------------------------------------
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QString>
+#include "updateinfo.hpp"
+//----------------------------------------------------------------------------------
+//! Тип действия плана
+enum UPDATE_ACTION_TYPE
+{
+	UAT_FETCH = 0,	//! Скачать архив
+	UAT_EXTRACT,	//! Распаковать архив
+	UAT_VERIFY,		//! Проверить распакованные файлы
+	UAT_PATCH,		//! Скачать и применить патч (при ошибке - скачать архив файла целиком)
+	UAT_SYNC		//! Получить только отличающиеся блоки файла (при ошибке - скачать архив файла целиком)
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CUpdateAction class
+ * Действие плана обновления
+ */
+class CUpdateAction
+{
+public:
+	CUpdateAction() {}
+	~CUpdateAction() {}
+
+	//! Тип действия
+	UPDATE_ACTION_TYPE Type{ UAT_FETCH };
+
+	//! Название архива (или патча) на сервере
+	QString ZipFileName{ "" };
+
+	//! Директория для архива и распакованных файлов
+	QString Directory{ "" };
+
+	//! Размер архива в байтах (-1 - неизвестен)
+	qint64 Size{ -1 };
+
+	//! Архив не распаковывается на место (файлы запущенного лаунчера заменяются переименованием, CSelfUpdate)
+	bool KeepArchive{ false };
+
+	//! Файлы архива (для проверки)
+	QList<CUpdateInfo> Files;
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CThroughputMeter class
+ * Измеренная скорость скачивания (скользящее среднее по всем загрузкам процесса)
+ */
+class CThroughputMeter
+{
+private:
+	//! Скорость, пока ничего не скачивалось, байт/с
+	enum { DEFAULT_BYTES_PER_SECOND = 256 * 1024 };
+
+	static QMutex &Mutex()
+	{
+		static QMutex mutex;
+		return mutex;
+	}
+
+	static double &Value()
+	{
+		static double value = 0.0;
+		return value;
+	}
+
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Add Учесть завершенную загрузку
+	 * @param bytes Получено байт
+	 * @param elapsedMs Время загрузки, мс
+	 */
+	static void Add(const qint64 &bytes, const qint64 &elapsedMs)
+	{
+		//! Мелкие файлы измеряют задержку, а не скорость
+		if (bytes < 64 * 1024 || elapsedMs <= 0)
+			return;
+
+		double speed = (double)bytes * 1000.0 / (double)elapsedMs;
+
+		QMutexLocker locker(&Mutex());
+		double &value = Value();
+
+		value = (value > 0.0 ? value * 0.7 + speed * 0.3 : speed);
+	}
+
+	//----------------------------------------------------------------------------------
+	static double BytesPerSecond()
+	{
+		QMutexLocker locker(&Mutex());
+
+		return (Value() > 0.0 ? Value() : (double)DEFAULT_BYTES_PER_SECOND);
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CUpdatePlan class
+ * Упорядоченный список действий с оценкой объема и времени
+ */
+class CUpdatePlan
+{
+public:
+	CUpdatePlan() {}
+	~CUpdatePlan() {}
+
+	//! Действия в порядке выполнения
+	QList<CUpdateAction> Actions;
+
+	//! Количество уникальных архивов
+	int ArchivesCount{ 0 };
+
+	//! Количество патчей
+	int PatchesCount{ 0 };
+
+	//! Количество файлов, синхронизируемых поблочно (объем заранее неизвестен)
+	int SyncCount{ 0 };
+
+	//! Суммарный размер архивов и патчей с известным размером
+	qint64 TotalBytes{ 0 };
+
+	//! Количество архивов и патчей с неизвестным размером
+	int UnknownSizes{ 0 };
+
+	//! В плане есть обновление лаунчера
+	bool LauncherUpdate{ false };
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief EstimatedSeconds Оценка времени по измеренной скорости
+	 * @return Секунды (архивы неизвестного размера не учитываются)
+	 */
+	int EstimatedSeconds() const
+	{
+		return (int)((double)TotalBytes / CThroughputMeter::BytesPerSecond()) + 1;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Summary Краткое описание для пользователя
+	 * @return Текст
+	 */
+	QString Summary() const
+	{
+		QString text = "";
+		text.sprintf("%i archive(s), %.1f MB, about %i s", ArchivesCount, (double)TotalBytes / 1048576.0, EstimatedSeconds());
+
+		if (PatchesCount)
+			text.replace(" archive(s),", QString(" archive(s), %1 patch(es),").arg(PatchesCount));
+
+		if (UnknownSizes)
+			text += QString(" (size of %1 download(s) is unknown)").arg(UnknownSizes);
+
+		if (SyncCount)
+			text += QString(", %1 file(s) will download only changed blocks").arg(SyncCount);
+
+		return text;
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief UpdateTotals Пересчитать объем после уточнения размеров
+	 */
+	void UpdateTotals()
+	{
+		ArchivesCount = 0;
+		PatchesCount = 0;
+		SyncCount = 0;
+		TotalBytes = 0;
+		UnknownSizes = 0;
+
+		for (const CUpdateAction &action : Actions)
+		{
+			if (action.Type == UAT_FETCH)
+				ArchivesCount++;
+			else if (action.Type == UAT_PATCH)
+				PatchesCount++;
+			else
+			{
+				if (action.Type == UAT_SYNC)
+					SyncCount++;
+
+				continue;
+			}
+
+			if (action.Size < 0)
+				UnknownSizes++;
+			else
+				TotalBytes += action.Size;
+		}
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CInstallUpdateResult class
+ * Результат обновления одной установки клиента при пакетном обновлении
+ */
+class CInstallUpdateResult
+{
+public:
+	CInstallUpdateResult() {}
+	~CInstallUpdateResult() {}
+
+	//! Директория клиента
+	QString Directory{ "" };
+
+	//! Количество устаревших файлов до обновления
+	int Outdated{ 0 };
+
+	//! Количество файлов, не прошедших проверку после обновления
+	int Failed{ 0 };
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Summary Краткое описание для пользователя
+	 * @return Текст
+	 */
+	QString Summary() const
+	{
+		if (!Outdated)
+			return Directory + ": up to date";
+		else if (Failed)
+			return QString("%1: %2 of %3 file(s) failed verification").arg(Directory).arg(Failed).arg(Outdated);
+
+		return QString("%1: %2 file(s) updated").arg(Directory).arg(Outdated);
+	}
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CUpdatePlanner class
+ * Построение плана обновления по списку устаревших файлов
+ */
+class CUpdatePlanner
+{
+public:
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief IsLauncher Файл - сам лаунчер
+	 * @param info Информация о файле
+	 * @return true для OrionLauncher.exe вне директории клиента
+	 */
+	static bool IsLauncher(const CUpdateInfo &info)
+	{
+		return (info.UODir != "yes" && info.Name == "OrionLauncher.exe");
+	}
+
+	//----------------------------------------------------------------------------------
+	/**
+	 * @brief Build Построить план
+	 * Файлы из одного архива дают одно скачивание и одну распаковку, архив лаунчера
+	 * скачивается последним и не распаковывается, проверка файлов идет после всех распаковок.
+	 * Файлы с выбранным патчем (CUpdateInfo::Patch) обновляются патчем, файлы с картой блоков -
+	 * поблочно; и то, и другое выполняется до скачивания архивов.
+	 * @param files Устаревшие файлы
+	 * @param clientDirectory Директория клиента (uodir="yes")
+	 * @param launcherDirectory Директория лаунчера
+	 * @return План
+	 */
+	static CUpdatePlan Build(const QList<CUpdateInfo> &files, const QString &clientDirectory, const QString &launcherDirectory)
+	{
+		CUpdatePlan plan;
+		QList<CUpdateAction> archives;
+		QList<CUpdateAction> deltas;
+		QHash<QString, int> index;
+		int launcherArchive = -1;
+
+		for (const CUpdateInfo &info : files)
+		{
+			if (!info.ZipFileName.length())
+				continue;
+
+			QString directory = (info.UODir == "yes" ? clientDirectory : launcherDirectory);
+
+			//! Запущенный лаунчер не патчим: его файлы заменяются переименованием из архива
+			if (info.Patch >= 0 && info.Patch < info.Patches.size() && !IsLauncher(info))
+			{
+				const CPatchInfo &patchInfo = info.Patches.at(info.Patch);
+
+				CUpdateAction patch;
+				patch.Type = UAT_PATCH;
+				patch.ZipFileName = patchInfo.FileName;
+				patch.Directory = directory;
+				patch.Size = patchInfo.Size;
+				patch.Files.push_back(info);
+
+				deltas.push_back(patch);
+
+				continue;
+			}
+
+			//! Без контрольной суммы собранный по блокам файл нечем проверить
+			if (info.BlockMapFileName.length() && info.RawFileName.length() && info.Hash.length() && !IsLauncher(info))
+			{
+				CUpdateAction sync;
+				sync.Type = UAT_SYNC;
+				sync.ZipFileName = info.BlockMapFileName;
+				sync.Directory = directory;
+				sync.Files.push_back(info);
+
+				deltas.push_back(sync);
+
+				continue;
+			}
+
+			QString key = (directory + "/" + info.ZipFileName).toLower();
+			auto it = index.constFind(key);
+			int position = 0;
+
+			if (it == index.constEnd())
+			{
+				CUpdateAction action;
+				action.Type = UAT_FETCH;
+				action.ZipFileName = info.ZipFileName;
+				action.Directory = directory;
+
+				position = archives.size();
+				index.insert(key, position);
+				archives.push_back(action);
+			}
+			else
+				position = it.value();
+
+			CUpdateAction &archive = archives[position];
+			archive.Files.push_back(info);
+
+			if (info.ZipSize >= 0)
+				archive.Size = qMax(archive.Size, info.ZipSize);
+
+			if (IsLauncher(info))
+			{
+				archive.KeepArchive = true;
+				launcherArchive = position;
+				plan.LauncherUpdate = true;
+			}
+		}
+
+		//! Лаунчер перезапускается после обновления, поэтому его архив - последний
+		if (launcherArchive != -1)
+			archives.move(launcherArchive, archives.size() - 1);
+
+		plan.Actions.append(deltas);
+
+		for (const CUpdateAction &archive : archives)
+		{
+			//! Список файлов остается у скачивания: по нему строится ключ в хранилище пакетов
+			CUpdateAction fetch = archive;
+			plan.Actions.push_back(fetch);
+
+			if (!archive.KeepArchive)
+			{
+				CUpdateAction extract = fetch;
+				extract.Type = UAT_EXTRACT;
+				plan.Actions.push_back(extract);
+			}
+		}
+
+		for (const CUpdateAction &archive : archives)
+		{
+			if (archive.KeepArchive)
+				continue;
+
+			CUpdateAction verify = archive;
+			verify.Type = UAT_VERIFY;
+			plan.Actions.push_back(verify);
+		}
+
+		for (const CUpdateAction &delta : deltas)
+		{
+			CUpdateAction verify = delta;
+			verify.Type = UAT_VERIFY;
+			plan.Actions.push_back(verify);
+		}
+
+		plan.UpdateTotals();
+
+		return plan;
+	}
+};
+//----------------------------------------------------------------------------------
+#endif // UPDATEPLANNER_H
+//----------------------------------------------------------------------------------
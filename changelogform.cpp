@@ -10,28 +10,158 @@
 #include "changelogform.h"
 #include "ui_changelogform.h"
 #include <QDesktopServices>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QtConcurrent>
+//----------------------------------------------------------------------------------
+//! Срок запроса истории изменений, мс
+static const qint64 CHANGELOG_TIMEOUT = 60 * 1000;
 //----------------------------------------------------------------------------------
 ChangelogForm::ChangelogForm(QWidget *parent)
 : QMainWindow(parent), ui(new Ui::ChangelogForm)
 {
 	ui->setupUi(this);
 
+	qRegisterMetaType<QTextDocumentFragment>("QTextDocumentFragment");
+
 	connect(this, SIGNAL(signal_ChangelogReceived(QString)), this, SLOT(slot_ChangelogReceived(QString)));
+	connect(this, SIGNAL(signal_ChangelogPartReceived(int, QTextDocumentFragment, bool)), this, SLOT(slot_ChangelogPartReceived(int, QTextDocumentFragment, bool)));
+	connect(&m_PartsTimer, SIGNAL(timeout()), this, SLOT(slot_OnPartsTimer()));
 	connect(ui->tb_Log, SIGNAL(anchorClicked(QUrl)), this, SLOT(slot_StartLink(QUrl)));
 }
 //----------------------------------------------------------------------------------
 ChangelogForm::~ChangelogForm()
 {
+	//! Запрос не должен отправлять части удаленной форме: ждем его завершения без ограничения
+	m_Operations.CancelAll();
+
 	delete ui;
 }
 //----------------------------------------------------------------------------------
+void ChangelogForm::ShowChangelog(const QStringList &params)
+{
+	m_Params = params;
+
+	int request = StartRequest();
+
+	m_Operation.Cancel();
+
+	COperation operation(CHANGELOG_TIMEOUT);
+
+	m_Operation = m_Operations.Add(operation, QtConcurrent::run(&CUpdateManager<ChangelogForm>::GetChangelog, params, this, request, operation));
+}
+//----------------------------------------------------------------------------------
+int ChangelogForm::StartRequest()
+{
+	m_Parts.clear();
+	m_PartsTimer.stop();
+	m_ShowingEntry = false;
+
+	ui->tb_Log->setHtml("Loading...");
+
+	return ++m_Request;
+}
+//----------------------------------------------------------------------------------
 void ChangelogForm::slot_ChangelogReceived(QString str)
 {
+	m_Parts.clear();
+	m_PartsTimer.stop();
+
 	ui->tb_Log->setHtml(str);
 }
 //----------------------------------------------------------------------------------
+void ChangelogForm::slot_ChangelogPartReceived(int request, QTextDocumentFragment part, bool first)
+{
+	if (request != m_Request)
+		return;
+
+	//! Новая версия страницы (сохраненная изменилась на сервере) - показываем заново
+	if (first)
+	{
+		m_Parts.clear();
+		ui->tb_Log->clear();
+	}
+
+	m_Parts.push_back(part);
+
+	if (first)
+		slot_OnPartsTimer();
+	else if (!m_PartsTimer.isActive())
+		m_PartsTimer.start(0);
+}
+//----------------------------------------------------------------------------------
+void ChangelogForm::slot_OnPartsTimer()
+{
+	if (m_Parts.isEmpty())
+	{
+		m_PartsTimer.stop();
+		return;
+	}
+
+	QTextCursor cursor(ui->tb_Log->document());
+	cursor.movePosition(QTextCursor::End);
+	cursor.insertFragment(m_Parts.takeFirst());
+
+	if (m_Parts.isEmpty())
+		m_PartsTimer.stop();
+}
+//----------------------------------------------------------------------------------
 void ChangelogForm::slot_StartLink(QUrl url)
 {
 	QDesktopServices::openUrl(url);
 }
 //----------------------------------------------------------------------------------
+void ChangelogForm::on_le_Search_textChanged(const QString &text)
+{
+	ui->lw_SearchResults->clear();
+	ui->lw_SearchResults->setVisible(!text.trimmed().isEmpty());
+
+	if (text.trimmed().isEmpty())
+	{
+		//! Поиск закончен - возвращаем страницу (она сохранена, сеть не нужна)
+		if (m_ShowingEntry)
+			ShowChangelog(m_Params);
+
+		return;
+	}
+
+	for (const CChangelogArchiveEntry &entry : CChangelogArchive::Instance().Search(m_Params.value(2), text, 200))
+	{
+		QListWidgetItem *item = new QListWidgetItem(entry.Title, ui->lw_SearchResults);
+		item->setData(Qt::UserRole, entry.Id);
+	}
+
+	if (ui->lw_SearchResults->count())
+		ui->lw_SearchResults->setCurrentRow(0);
+}
+//----------------------------------------------------------------------------------
+void ChangelogForm::on_lw_SearchResults_currentRowChanged(int row)
+{
+	QListWidgetItem *item = ui->lw_SearchResults->item(row);
+
+	if (item == nullptr)
+		return;
+
+	if (!m_ShowingEntry)
+	{
+		QTextCursor cursor = ui->tb_Log->document()->find(item->text(), 0, QTextDocument::FindCaseSensitively);
+
+		//! Раздел на странице - прокручиваем к нему, чтобы заголовок был вверху окна
+		if (!cursor.isNull())
+		{
+			ui->tb_Log->setTextCursor(cursor);
+			ui->tb_Log->verticalScrollBar()->setValue(ui->tb_Log->verticalScrollBar()->value() + ui->tb_Log->cursorRect().top());
+
+			return;
+		}
+	}
+
+	//! Раздела нет на странице (удален с сервера или страница еще не загружена) - показываем запись архива
+	m_Parts.clear();
+	m_PartsTimer.stop();
+	m_ShowingEntry = true;
+	m_Request++;
+
+	ui->tb_Log->setHtml(CChangelogArchive::Instance().EntryHtml(item->data(Qt::UserRole).toInt()));
+}
+//----------------------------------------------------------------------------------
@@ -11,6 +11,8 @@
 #define CHANGELOGFORM_H
 //----------------------------------------------------------------------------------
 #include <QMainWindow>
+#include <QTextDocumentFragment>
+#include <QTimer>
 #include <QUrl>
 #include "UpdateManager/updatemanager.hpp"
 //----------------------------------------------------------------------------------
@@ -27,21 +29,50 @@ public:
 	explicit ChangelogForm(QWidget *parent = 0);
 	~ChangelogForm();
 
+	void ShowChangelog(const QStringList &params);
+
 private slots:
 	void slot_ChangelogReceived(QString str);
+	void slot_ChangelogPartReceived(int request, QTextDocumentFragment part, bool first);
+	void slot_OnPartsTimer();
 	void slot_StartLink(QUrl url);
+	void on_le_Search_textChanged(const QString &text);
+	void on_lw_SearchResults_currentRowChanged(int row);
 
 signals:
 	void signal_UpdatesListReceived(QList<CUpdateInfo>);
 	void signal_BackupsListReceived(QList<CBackupInfo>);
 	void signal_ChangelogReceived(QString);
+	void signal_ChangelogPartReceived(int, QTextDocumentFragment, bool);
 	void signal_FileReceived(QByteArray, QString);
 	void signal_FileReceivedNotification(QString);
-	void signal_AutoUpdateProgress(int);
 	void signal_AutoUpdateNotification();
+	void signal_InstallationVerified(QList<CUpdateInfo>, QString);
 
 private:
 	Ui::ChangelogForm *ui;
+
+	//! Номер текущего запроса истории изменений
+	int m_Request{ 0 };
+
+	//! Полученные, но еще не вставленные части (вставляются по одной, чтобы окно успевало отрисоваться)
+	QList<QTextDocumentFragment> m_Parts;
+
+	QTimer m_PartsTimer;
+
+	//! Параметры подключения показанной страницы ([2] - страница, она же язык архива)
+	QStringList m_Params;
+
+	//! Вместо страницы показана запись архива (раздела нет в показанной странице)
+	bool m_ShowingEntry{ false };
+
+	//! Текущий запрос истории изменений (новый запрос отменяет предыдущий)
+	COperation m_Operation;
+
+	//! Запросы, которые еще могут выполняться (ожидаются при удалении формы)
+	COperationList m_Operations;
+
+	int StartRequest();
 };
 //----------------------------------------------------------------------------------
 #endif // CHANGELOGFORM_H
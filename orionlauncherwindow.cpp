@@ -10,6 +10,7 @@
 #include "orionlauncherwindow.h"
 #include "ProxyListItem.h"
 #include "ServerListItem.h"
+#include "UpdateInfoListItem.h"
 #include "qzipreader_p.h"
 #include "ui_orionlauncherwindow.h"
 #include <QDebug>
@@ -24,6 +25,17 @@
 #include <windows.h>
 
 OrionLauncherWindow *g_OrionLauncherWindow = nullptr;
+
+// Update operation deadlines, ms (0 - no deadline: downloads the user started
+// run until done or cancelled, stalls are bounded by WinINet timeouts)
+static const qint64 CHECK_TIMEOUT = 5 * 60 * 1000;
+static const qint64 BACKGROUND_CHECK_TIMEOUT = 30 * 60 * 1000;
+static const qint64 VERIFY_TIMEOUT = 30 * 60 * 1000;
+static const qint64 PLAN_TIMEOUT = 2 * 60 * 1000;
+static const qint64 PREFETCH_CHANGELOGS_TIMEOUT = 5 * 60 * 1000;
+
+// How often the progress bar takes the progress published by operations, ms
+static const int PROGRESS_INTERVAL = 100;
 //----------------------------------------------------------------------------------
 OrionLauncherWindow::OrionLauncherWindow(QWidget *parent)
     : QMainWindow(parent), ui(new Ui::OrionLauncherWindow) {
@@ -33,19 +45,42 @@ OrionLauncherWindow::OrionLauncherWindow(QWidget *parent)
 
   qRegisterMetaType<QList<CUpdateInfo>>("QList<CUpdateInfo>");
   qRegisterMetaType<QList<CBackupInfo>>("QList<CBackupInfo>");
+  qRegisterMetaType<CUpdatePlan>("CUpdatePlan");
+  qRegisterMetaType<QList<CInstallUpdateResult>>("QList<CInstallUpdateResult>");
 
   connect(this, SIGNAL(signal_UpdatesListReceived(QList<CUpdateInfo>)), this,
           SLOT(slot_UpdatesListReceived(QList<CUpdateInfo>)));
   connect(this, SIGNAL(signal_BackupsListReceived(QList<CBackupInfo>)), this,
           SLOT(slot_BackupsListReceived(QList<CBackupInfo>)));
+  connect(this,
+          SIGNAL(signal_LastKnownUpdatesReceived(QList<CUpdateInfo>,
+                                                 QList<CBackupInfo>)),
+          this,
+          SLOT(slot_LastKnownUpdatesReceived(QList<CUpdateInfo>,
+                                             QList<CBackupInfo>)));
   connect(this, SIGNAL(signal_FileReceived(QByteArray, QString)), this,
           SLOT(slot_FileReceived(QByteArray, QString)));
   connect(this, SIGNAL(signal_FileReceivedNotification(QString)), this,
           SLOT(slot_FileReceivedNotification(QString)));
+  connect(this,
+          SIGNAL(signal_InstallationVerified(QList<CUpdateInfo>, QString)),
+          this, SLOT(slot_InstallationVerified(QList<CUpdateInfo>, QString)));
+  connect(this, SIGNAL(signal_UpdatePlanReady(CUpdatePlan)), this,
+          SLOT(slot_UpdatePlanReady(CUpdatePlan)));
+  connect(this, SIGNAL(signal_UpdatePlanExecuted(QList<CUpdateInfo>)), this,
+          SLOT(slot_UpdatePlanExecuted(QList<CUpdateInfo>)));
+  connect(this, SIGNAL(signal_UpdatesNotification()), this,
+          SLOT(slot_UpdatesNotification()));
+  connect(this, SIGNAL(signal_InstallsUpdated(QList<CInstallUpdateResult>)),
+          this, SLOT(slot_InstallsUpdated(QList<CInstallUpdateResult>)));
+  connect(this, SIGNAL(signal_InstallsDeduplicated(QString)), this,
+          SLOT(slot_InstallsDeduplicated(QString)));
   connect(&m_UpdatesTimer, SIGNAL(timeout()), this,
           SLOT(slot_OnUpdatesTimer()));
   connect(&m_CheckClientCuoTimer, SIGNAL(timeout()), this,
           SLOT(slot_OnCheckClientCuoTimer()));
+  connect(&m_ProgressTimer, SIGNAL(timeout()), this,
+          SLOT(slot_OnProgressTimer()));
 
   setFixedSize(size());
 
@@ -55,14 +90,23 @@ OrionLauncherWindow::OrionLauncherWindow(QWidget *parent)
   ui->tw_Main->setCurrentIndex(0);
   ui->tw_Server->setCurrentIndex(0);
 
+  for (const QString &argument : qApp->arguments()) {
+    if (argument.startsWith("--tab="))
+      ui->tw_Main->setCurrentIndex(argument.mid(6).toInt());
+  }
+
+  CSelfUpdate::Cleanup(qApp->applicationDirPath());
+
+  CLanCache::SetPeer(m_LanCachePeer);
+  UpdateLanCacheServer();
+
   UpdateOAFecturesCode();
   UpdateOrionFecturesCode();
 
-  QString crc32 = "";
   QString version = "";
 
-  CUpdateManager<OrionLauncherWindow>::GetFileInfo(qApp->applicationFilePath(),
-                                                   version, crc32);
+  CUpdateManager<OrionLauncherWindow>::GetFileVersion(
+      qApp->applicationFilePath(), version);
 
   setWindowTitle("Orion launcher " + version);
 
@@ -73,11 +117,47 @@ OrionLauncherWindow::OrionLauncherWindow(QWidget *parent)
 
   on_cb_OrionPath_currentIndexChanged(ui->cb_OrionPath->currentIndex());
 
-  m_UpdatesTimer.start(15 * 60 * 1000);
+  m_UpdatesTimer.setSingleShot(true);
+  m_UpdatesTimer.start(m_PollSchedule.Next(false));
   m_CheckClientCuoTimer.start(1000);
+
+  if (m_UpdatesNotifyUrl.length())
+    QtConcurrent::run(CUpdateNotifier<OrionLauncherWindow>::Pool(),
+                      &CUpdateNotifier<OrionLauncherWindow>::Run,
+                      m_UpdatesNotifyUrl, this);
+
+  QStringList changelogs = QStringList() << "www.orionuo.com"
+                                         << "/Downloads/";
+
+  for (int i = 0; i < ui->cb_ChangelogLanguage->count(); i++)
+    changelogs << ("OrionChangelog" + ui->cb_ChangelogLanguage->itemText(i) +
+                   ".html");
+
+  COperation prefetch = NewOperation(PREFETCH_CHANGELOGS_TIMEOUT);
+
+  m_Operations.Add(
+      prefetch,
+      QtConcurrent::run(
+          CBackgroundPriority::Pool(),
+          &CUpdateManager<OrionLauncherWindow>::PrefetchChangelogs, changelogs,
+          prefetch));
 }
 //----------------------------------------------------------------------------------
 OrionLauncherWindow::~OrionLauncherWindow() {
+  // Nothing may emit to this window (or the changelog form) once it is gone,
+  // so wait for work that cannot be interrupted however long it takes
+  m_Operations.CancelAll();
+
+  // Stop() returns only once no notification is being emitted, so the wait
+  // just lets the subscription close its connection
+  CUpdateNotifier<OrionLauncherWindow>::Stop();
+  CUpdateNotifier<OrionLauncherWindow>::Pool()->waitForDone(3000);
+
+  if (m_LanCacheServer != nullptr) {
+    delete m_LanCacheServer;
+    m_LanCacheServer = nullptr;
+  }
+
   g_OrionLauncherWindow = nullptr;
 
   delete ui;
@@ -92,7 +172,20 @@ OrionLauncherWindow::~OrionLauncherWindow() {
 //----------------------------------------------------------------------------------
 void OrionLauncherWindow::slot_OnUpdatesTimer() {
   if (ui->cb_CheckUpdates->isChecked())
-    on_pb_CheckUpdates_clicked();
+    StartUpdatesCheck(true, true);
+
+  m_UpdatesTimer.start(m_PollSchedule.Next(
+      CUpdateNotifier<OrionLauncherWindow>::IsSubscribed()));
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::slot_UpdatesNotification() {
+  m_PollSchedule.Reset();
+
+  if (ui->cb_CheckUpdates->isChecked())
+    StartUpdatesCheck(true, false);
+
+  m_UpdatesTimer.start(m_PollSchedule.Next(
+      CUpdateNotifier<OrionLauncherWindow>::IsSubscribed()));
 }
 //----------------------------------------------------------------------------------
 void OrionLauncherWindow::slot_OnCheckClientCuoTimer() {
@@ -469,6 +562,18 @@ void OrionLauncherWindow::SaveServerList() {
                            QString::number(ui->lw_ServerList->currentRow()));
     writter.writeAttribute("checkupdates",
                            BoolToText(ui->cb_CheckUpdates->isChecked()));
+    writter.writeAttribute("predownloadupdates",
+                           BoolToText(ui->cb_PredownloadUpdates->isChecked()));
+    writter.writeAttribute("updatesnotifyurl", m_UpdatesNotifyUrl);
+    writter.writeAttribute("lancacheserver",
+                           BoolToText(ui->cb_LanCacheServer->isChecked()));
+    writter.writeAttribute("lancacheport", QString::number(m_LanCachePort));
+    writter.writeAttribute("lancachepeer", m_LanCachePeer);
+    writter.writeAttribute("snapshotsretention",
+                           QString::number(CInstallSnapshot::Retention()));
+    writter.writeAttribute(
+        "packagecachemb",
+        QString::number(CPackageCache::Instance().Budget() / (1024 * 1024)));
     writter.writeAttribute("changeloglanguage",
                            ui->cb_ChangelogLanguage->currentText());
     writter.writeAttribute("noclientwarnings",
@@ -647,6 +752,34 @@ void OrionLauncherWindow::LoadServerList() {
             ui->cb_CheckUpdates->setChecked(
                 RawStringToBool(attributes.value("checkupdates").toString()));
 
+          if (attributes.hasAttribute("predownloadupdates"))
+            ui->cb_PredownloadUpdates->setChecked(RawStringToBool(
+                attributes.value("predownloadupdates").toString()));
+
+          if (attributes.hasAttribute("updatesnotifyurl"))
+            m_UpdatesNotifyUrl =
+                attributes.value("updatesnotifyurl").toString().trimmed();
+
+          if (attributes.hasAttribute("lancacheserver"))
+            ui->cb_LanCacheServer->setChecked(
+                RawStringToBool(attributes.value("lancacheserver").toString()));
+
+          if (attributes.hasAttribute("lancacheport") &&
+              attributes.value("lancacheport").toUShort())
+            m_LanCachePort = attributes.value("lancacheport").toUShort();
+
+          if (attributes.hasAttribute("lancachepeer"))
+            m_LanCachePeer =
+                attributes.value("lancachepeer").toString().trimmed();
+
+          if (attributes.hasAttribute("snapshotsretention"))
+            CInstallSnapshot::SetRetention(
+                attributes.value("snapshotsretention").toInt());
+
+          if (attributes.hasAttribute("packagecachemb"))
+            CPackageCache::Instance().SetBudget(
+                attributes.value("packagecachemb").toLongLong() * 1024 * 1024);
+
           if (attributes.hasAttribute("changeloglanguage"))
             ui->cb_ChangelogLanguage->setCurrentText(
                 attributes.value("changeloglanguage").toString());
@@ -1043,8 +1176,30 @@ void OrionLauncherWindow::on_cb_OrionPath_currentIndexChanged(int index) {
   Q_UNUSED(index);
 
   if (!m_Loading) {
-    if (ui->cb_CheckUpdates->isChecked())
-      on_pb_CheckUpdates_clicked();
+    // A check of the previous install is obsolete, start over for this one
+    bool restart = m_CheckOperation.IsRunning();
+
+    if (restart) {
+      m_CheckOperation.Cancel();
+
+      ui->pb_CheckUpdates->setEnabled(true);
+      ui->pb_VerifyInstallation->setEnabled(true);
+    }
+
+    m_LastKnownOperation.Cancel();
+
+    if (restart || ui->cb_CheckUpdates->isChecked())
+      StartUpdatesCheck(false, true);
+    else {
+      // Without a check the last known result is shown on its own
+      m_LastKnownOperation = NewOperation(CHECK_TIMEOUT);
+
+      m_Operations.Add(
+          m_LastKnownOperation,
+          QtConcurrent::run(
+              &CUpdateManager<OrionLauncherWindow>::ShowLastKnownUpdates, this,
+              ui->cb_OrionPath->currentText(), m_LastKnownOperation));
+    }
 
     slot_OnCheckClientCuoTimer();
   }
@@ -1052,28 +1207,20 @@ void OrionLauncherWindow::on_cb_OrionPath_currentIndexChanged(int index) {
 //----------------------------------------------------------------------------------
 void OrionLauncherWindow::slot_UpdatesListReceived(QList<CUpdateInfo> list) {
   ui->lw_AvailableUpdates->clear();
-  QString directoryPath = ui->cb_OrionPath->currentText();
-
-  for (const CUpdateInfo &info : list) {
-    QString crc32 = "";
-    QString version = "";
 
-    bool wantUpdate = !CUpdateManager<OrionLauncherWindow>::GetFileInfo(
-        (info.UODir == "yes" ? directoryPath : qApp->applicationDirPath()) +
-            "/" + info.Name,
-        version, crc32);
+  QString signature = ui->cb_OrionPath->currentText();
 
-    if (info.Version.length() &&
-        CUpdateManager<OrionLauncherWindow>::TestVersions(version,
-                                                          info.Version))
-      wantUpdate = true;
+  for (const CUpdateInfo &info : list) {
+    ui->lw_AvailableUpdates->addItem(new CUpdateInfoListWidgetItem(info));
+    signature += "\n" + info.Name + " " + info.Version + " " + info.Hash;
+  }
 
-    if (info.Hash.length() && info.Hash != crc32)
-      wantUpdate = true;
+  if (signature == m_LastUpdatesSignature)
+    m_PollSchedule.Backoff();
+  else
+    m_PollSchedule.Reset();
 
-    if (wantUpdate)
-      ui->lw_AvailableUpdates->addItem(new CUpdateInfoListWidgetItem(info));
-  }
+  m_LastUpdatesSignature = signature;
 
   if (ui->lw_AvailableUpdates->count())
     ui->tw_Main->setCurrentIndex(2);
@@ -1089,10 +1236,32 @@ void OrionLauncherWindow::slot_UpdatesListReceived(QList<CUpdateInfo> list) {
 void OrionLauncherWindow::slot_BackupsListReceived(QList<CBackupInfo> list) {
   ui->lw_Backups->clear();
 
+  for (const CSnapshotInfo &snapshot :
+       CInstallSnapshot::List(ui->cb_OrionPath->currentText())) {
+    CBackupInfo info;
+    info.Name = snapshot.Name();
+    info.Snapshot = snapshot.Id;
+
+    ui->lw_Backups->addItem(new CBackupInfoListWidgetItem(info));
+  }
+
   for (const CBackupInfo &info : list)
     ui->lw_Backups->addItem(new CBackupInfoListWidgetItem(info));
 }
 //----------------------------------------------------------------------------------
+void OrionLauncherWindow::slot_LastKnownUpdatesReceived(
+    QList<CUpdateInfo> list, QList<CBackupInfo> backups) {
+  ui->lw_AvailableUpdates->clear();
+
+  for (const CUpdateInfo &info : list)
+    ui->lw_AvailableUpdates->addItem(new CUpdateInfoListWidgetItem(info));
+
+  slot_BackupsListReceived(backups);
+
+  if (ui->lw_AvailableUpdates->count())
+    ui->tw_Main->setCurrentIndex(2);
+}
+//----------------------------------------------------------------------------------
 void OrionLauncherWindow::slot_FileReceived(QByteArray array, QString name) {
   Q_UNUSED(array);
   Q_UNUSED(name);
@@ -1114,17 +1283,9 @@ void OrionLauncherWindow::slot_FileReceivedNotification(QString name) {
     ui->pb_UpdateProgress->setValue(100);
     m_FilesToUpdateCount = 0;
 
-    if (m_LauncherFoundInUpdates &&
-        QFile::exists(qApp->applicationDirPath() + "/olupd.exe")) {
-      SaveServerList();
-      SaveProxyList();
-
-      RunProgram(qApp->applicationDirPath() +
-                     "/olupd.exe /OrionLauncher_Update.zip",
-                 qApp->applicationDirPath());
-
-      exit(0);
-    } else
+    if (m_LauncherFoundInUpdates && CSelfUpdate::Swapped())
+      RestartLauncher();
+    else
       on_pb_CheckUpdates_clicked();
   } else {
     ui->pb_UpdateProgress->setValue(
@@ -1133,95 +1294,378 @@ void OrionLauncherWindow::slot_FileReceivedNotification(QString name) {
   }
 }
 //----------------------------------------------------------------------------------
-void OrionLauncherWindow::on_pb_CheckUpdates_clicked() {
+void OrionLauncherWindow::slot_InstallationVerified(QList<CUpdateInfo> list,
+                                                    QString summary) {
+  ui->lw_AvailableUpdates->clear();
+
+  for (const CUpdateInfo &info : list)
+    ui->lw_AvailableUpdates->addItem(new CUpdateInfoListWidgetItem(info));
+
+  ui->pb_CheckUpdates->setEnabled(true);
+  ui->pb_ApplyUpdates->setEnabled(true);
+  ui->pb_VerifyInstallation->setEnabled(true);
+  ui->lw_Backups->setEnabled(true);
+  ui->pb_RestoreSelectedVersion->setEnabled(true);
+  ui->pb_ShowChangelog->setEnabled(true);
+  ui->pb_UpdateProgress->setValue(100);
+
+  if (!summary.length()) {
+    QMessageBox::critical(this, "Verify installation",
+                          "Failed to get the updates list from the server!");
+    return;
+  }
+
+  if (list.size())
+    summary += "\n\nPress 'Apply updates' to download the damaged files again.";
+
+  QMessageBox::information(this, "Verify installation",
+                           summary + "\n\nReport: " + QDir::currentPath() +
+                               "/VerifyReport.xml");
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::on_pb_VerifyInstallation_clicked() {
   if (!ui->pb_CheckUpdates->isEnabled())
     return;
 
   ui->pb_CheckUpdates->setEnabled(false);
   ui->pb_ApplyUpdates->setEnabled(false);
+  ui->pb_VerifyInstallation->setEnabled(false);
   ui->lw_Backups->setEnabled(false);
   ui->pb_RestoreSelectedVersion->setEnabled(false);
   ui->pb_ShowChangelog->setEnabled(false);
   ui->pb_UpdateProgress->setValue(0);
 
   ui->lw_AvailableUpdates->clear();
-  ui->lw_Backups->clear();
 
-  QtConcurrent::run(&CUpdateManager<OrionLauncherWindow>::CheckUpdates,
-                    QStringList() << "www.orionuo.com"
-                                  << "/Downloads/"
-                                  << "OrionUpdate.html",
-                    this);
+  COperation operation = NewOperation(VERIFY_TIMEOUT);
+
+  m_CheckOperation = m_Operations.Add(
+      operation,
+      QtConcurrent::run(
+          &CUpdateManager<OrionLauncherWindow>::VerifyInstallation,
+          QStringList() << "www.orionuo.com"
+                        << "/Downloads/"
+                        << "OrionUpdate.html",
+          this, ui->cb_OrionPath->currentText(), operation));
 }
 //----------------------------------------------------------------------------------
-void OrionLauncherWindow::on_pb_ApplyUpdates_clicked() {
+void OrionLauncherWindow::on_pb_CheckUpdates_clicked() {
+  StartUpdatesCheck(false, false);
+}
+//----------------------------------------------------------------------------------
+QStringList OrionLauncherWindow::InstallDirectories() {
+  QStringList directories;
+  QSet<QString> known;
+
+  for (int i = 0; i < ui->cb_OrionPath->count(); i++) {
+    QString directory = QDir::cleanPath(ui->cb_OrionPath->itemText(i));
+
+    if (QDir(directory).exists() && !known.contains(directory.toLower())) {
+      known.insert(directory.toLower());
+      directories.push_back(directory);
+    }
+  }
+
+  return directories;
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::on_pb_UpdateAllInstalls_clicked() {
   if (!ui->pb_CheckUpdates->isEnabled())
     return;
 
-  if (ui->lw_AvailableUpdates->count() < 1) {
-    ui->pb_UpdateProgress->setValue(100);
+  QStringList directories = InstallDirectories();
+
+  if (directories.isEmpty() ||
+      QMessageBox::question(
+          this, "Updates notification",
+          QString("Update %1 client install(s)?\n\nClose all OrionUO windows "
+                  "and press 'Yes'.\nPress 'No' for cancel.")
+              .arg(directories.size())) != QMessageBox::Yes)
     return;
-  }
 
+  ui->pb_CheckUpdates->setEnabled(false);
+  ui->pb_ApplyUpdates->setEnabled(false);
+  ui->pb_VerifyInstallation->setEnabled(false);
+  ui->lw_Backups->setEnabled(false);
+  ui->pb_RestoreSelectedVersion->setEnabled(false);
+  ui->pb_ShowChangelog->setEnabled(false);
   ui->pb_UpdateProgress->setValue(0);
 
-  if (QMessageBox::question(this, "Updates notification",
-                            "Close all OrionUO windows and press 'Yes'.\nPress "
-                            "'No' for cancel.") != QMessageBox::Yes)
+  COperation operation = NewOperation(0);
+
+  m_Operations.Add(
+      operation,
+      QtConcurrent::run(
+          &CUpdateManager<OrionLauncherWindow>::UpdateAllInstalls,
+          QStringList() << "www.orionuo.com"
+                        << "/Downloads/"
+                        << "OrionUpdate.html",
+          this, directories, operation));
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::slot_InstallsUpdated(
+    QList<CInstallUpdateResult> results) {
+  ui->pb_CheckUpdates->setEnabled(true);
+  ui->pb_ApplyUpdates->setEnabled(true);
+  ui->pb_VerifyInstallation->setEnabled(true);
+  ui->lw_Backups->setEnabled(true);
+  ui->pb_RestoreSelectedVersion->setEnabled(true);
+  ui->pb_ShowChangelog->setEnabled(true);
+  ui->pb_UpdateProgress->setValue(100);
+
+  if (results.isEmpty()) {
+    QMessageBox::critical(this, "Update all installs",
+                          "Failed to get the updates list from the server!");
+    return;
+  }
+
+  QStringList lines;
+
+  for (const CInstallUpdateResult &result : results)
+    lines.push_back(result.Summary());
+
+  QMessageBox::information(this, "Update all installs", lines.join("\n"));
+
+  on_pb_CheckUpdates_clicked();
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::on_pb_DeduplicateInstalls_clicked() {
+  if (!ui->pb_CheckUpdates->isEnabled())
+    return;
+
+  QStringList directories = InstallDirectories();
+
+  if (directories.size() < 2 ||
+      QMessageBox::question(
+          this, "Deduplicate",
+          QString("Replace identical files of %1 client install(s) with links "
+                  "to a single copy?\n\nClose all OrionUO windows and press "
+                  "'Yes'.\nPress 'No' for cancel.")
+              .arg(directories.size())) != QMessageBox::Yes)
     return;
 
+  ui->pb_CheckUpdates->setEnabled(false);
+  ui->pb_ApplyUpdates->setEnabled(false);
+  ui->pb_VerifyInstallation->setEnabled(false);
+
+  COperation operation = NewOperation(0);
+
+  m_Operations.Add(
+      operation,
+      QtConcurrent::run(
+          CBackgroundPriority::Pool(),
+          &CUpdateManager<OrionLauncherWindow>::DeduplicateInstalls, this,
+          directories, operation));
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::slot_InstallsDeduplicated(QString summary) {
+  ui->pb_CheckUpdates->setEnabled(true);
+  ui->pb_ApplyUpdates->setEnabled(true);
+  ui->pb_VerifyInstallation->setEnabled(true);
+
+  QMessageBox::information(this, "Deduplicate", summary);
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::StartUpdatesCheck(const bool &background,
+                                            const bool &useCache) {
+  if (!ui->pb_CheckUpdates->isEnabled())
+    return;
+
+  // The check shows the last known result itself, a late one must not
+  // overwrite the server answer
+  m_LastKnownOperation.Cancel();
+
   ui->pb_CheckUpdates->setEnabled(false);
   ui->pb_ApplyUpdates->setEnabled(false);
   ui->lw_Backups->setEnabled(false);
   ui->pb_RestoreSelectedVersion->setEnabled(false);
   ui->pb_ShowChangelog->setEnabled(false);
+  ui->pb_UpdateProgress->setValue(0);
 
-  QString directoryPath = ui->cb_OrionPath->currentText();
-  m_LauncherFoundInUpdates = false;
-  m_FilesToUpdateCount = 0;
+  ui->lw_AvailableUpdates->clear();
+  ui->lw_Backups->clear();
 
-  QList<CUpdateInfoListWidgetItem *> updateList;
+  QStringList params = QStringList() << "www.orionuo.com"
+                                     << "/Downloads/"
+                                     << "OrionUpdate.html"
+                                     << "OrionUpdateTree.xml";
+
+  COperation operation =
+      NewOperation(background ? BACKGROUND_CHECK_TIMEOUT : CHECK_TIMEOUT);
+  QString directory = ui->cb_OrionPath->currentText();
+  bool predownload = ui->cb_PredownloadUpdates->isChecked();
+
+  // QtConcurrent::run binds at most five arguments
+  if (background)
+    m_CheckOperation = m_Operations.Add(
+        operation, QtConcurrent::run(CBackgroundPriority::Pool(), [=]() {
+          CUpdateManager<OrionLauncherWindow>::CheckUpdatesInBackground(
+              params, this, directory, useCache, predownload, operation);
+        }));
+  else
+    m_CheckOperation = m_Operations.Add(
+        operation,
+        QtConcurrent::run(
+            &CUpdateManager<OrionLauncherWindow>::CheckUpdatesTree, params,
+            this, directory, useCache, operation));
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::on_pb_ApplyUpdates_clicked() {
+  if (!ui->pb_CheckUpdates->isEnabled())
+    return;
+
+  if (ui->lw_AvailableUpdates->count() < 1) {
+    ui->pb_UpdateProgress->setValue(100);
+    return;
+  }
+
+  ui->pb_UpdateProgress->setValue(0);
+
+  QList<CUpdateInfo> updateList;
 
   for (int i = 0; i < ui->lw_AvailableUpdates->count(); i++) {
     CUpdateInfoListWidgetItem *item =
         (CUpdateInfoListWidgetItem *)ui->lw_AvailableUpdates->item(i);
 
-    if (item == nullptr)
-      continue;
-
-    m_FilesToUpdateCount++;
-
-    updateList.push_back(item);
+    if (item != nullptr)
+      updateList.push_back(item->m_Info);
   }
 
-  if (m_FilesToUpdateCount) {
-    for (CUpdateInfoListWidgetItem *item : updateList) {
-      bool removeFile = true;
-      QString path = directoryPath;
-
-      if (item->m_Info.UODir != "yes") {
-        if (item->text() == "OrionLauncher.exe") {
-          removeFile = false;
-          m_LauncherFoundInUpdates = true;
-        }
+  ui->pb_CheckUpdates->setEnabled(false);
+  ui->pb_ApplyUpdates->setEnabled(false);
+  ui->lw_Backups->setEnabled(false);
+  ui->pb_RestoreSelectedVersion->setEnabled(false);
+  ui->pb_ShowChangelog->setEnabled(false);
 
-        path = qApp->applicationDirPath();
-      }
+  COperation operation = NewOperation(PLAN_TIMEOUT);
+  QString directory = ui->cb_OrionPath->currentText();
+  QString launcherDirectory = qApp->applicationDirPath();
 
-      QtConcurrent::run(
-          &CUpdateManager<OrionLauncherWindow>::DownloadFile,
-          QStringList() << "www.orionuo.com"
-                        << "/Downloads/" << item->m_Info.ZipFileName,
-          this, QString(path + "/" + item->m_Info.ZipFileName), removeFile);
-    }
-  } else {
+  m_Operations.Add(operation, QtConcurrent::run([=]() {
+    CUpdateManager<OrionLauncherWindow>::PlanUpdates(
+        QStringList() << "www.orionuo.com"
+                      << "/Downloads/",
+        this, updateList, directory, launcherDirectory, operation);
+  }));
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::slot_UpdatePlanReady(CUpdatePlan plan) {
+  if (plan.Actions.isEmpty() ||
+      QMessageBox::question(this, "Updates notification",
+                            "Download: " + plan.Summary() +
+                                ".\n\nClose all OrionUO windows and press "
+                                "'Yes'.\nPress 'No' for cancel.") !=
+          QMessageBox::Yes) {
     ui->pb_CheckUpdates->setEnabled(true);
     ui->pb_ApplyUpdates->setEnabled(true);
     ui->lw_Backups->setEnabled(true);
     ui->pb_RestoreSelectedVersion->setEnabled(true);
     ui->pb_ShowChangelog->setEnabled(true);
     ui->pb_UpdateProgress->setValue(100);
+    return;
   }
+
+  m_LauncherFoundInUpdates = plan.LauncherUpdate;
+
+  COperation operation = NewOperation(0);
+
+  m_Operations.Add(
+      operation,
+      QtConcurrent::run(&CUpdateManager<OrionLauncherWindow>::ExecutePlan,
+                        QStringList() << "www.orionuo.com"
+                                      << "/Downloads/",
+                        this, plan, operation));
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::slot_UpdatePlanExecuted(QList<CUpdateInfo> failed) {
+  ui->pb_CheckUpdates->setEnabled(true);
+  ui->pb_ApplyUpdates->setEnabled(true);
+  ui->lw_Backups->setEnabled(true);
+  ui->pb_RestoreSelectedVersion->setEnabled(true);
+  ui->pb_ShowChangelog->setEnabled(true);
+  ui->pb_UpdateProgress->setValue(100);
+
+  if (failed.size())
+    QMessageBox::warning(this, "Updates notification",
+                         QString("%1 file(s) failed verification after the "
+                                 "update, check them again.")
+                             .arg(failed.size()));
+
+  if (m_LauncherFoundInUpdates && CSelfUpdate::Swapped())
+    RestartLauncher();
+  else
+    on_pb_CheckUpdates_clicked();
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::RestartLauncher() {
+  SaveServerList();
+  SaveProxyList();
+
+  // The new process must not race this one for connections and files
+  m_Operations.CancelAll();
+
+  if (m_LanCacheServer != nullptr) {
+    delete m_LanCacheServer;
+    m_LanCacheServer = nullptr;
+  }
+
+  if (CSelfUpdate::Restart(QStringList() << QString("--tab=%1").arg(
+                               ui->tw_Main->currentIndex())))
+    exit(0);
+
+  QMessageBox::warning(this, "Updates notification",
+                       "The launcher was updated, restart it to finish.");
+
+  UpdateLanCacheServer();
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::UpdateLanCacheServer() {
+  if (ui->cb_LanCacheServer->isChecked() == (m_LanCacheServer != nullptr))
+    return;
+
+  if (m_LanCacheServer != nullptr) {
+    delete m_LanCacheServer;
+    m_LanCacheServer = nullptr;
+  } else {
+    m_LanCacheServer = new CLanCacheServer(m_LanCachePort);
+    m_LanCacheServer->start(QThread::LowPriority);
+  }
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::on_cb_LanCacheServer_clicked() {
+  UpdateLanCacheServer();
+}
+//----------------------------------------------------------------------------------
+COperation OrionLauncherWindow::NewOperation(const qint64 &timeout) {
+  if (!m_ProgressTimer.isActive())
+    m_ProgressTimer.start(PROGRESS_INTERVAL);
+
+  return COperation(timeout, m_Progress);
+}
+//----------------------------------------------------------------------------------
+void OrionLauncherWindow::slot_OnProgressTimer() {
+  // Everything a finished operation published is already in the queue
+  bool running = m_Operations.IsRunning();
+
+  QHash<quint32, CProgressEvent> latest;
+
+  m_Progress->Drain(latest);
+
+  // The bar follows the newest operation that reports a percentage, so one
+  // that has finished does not hold it at 100 once another has started
+  for (const CProgressEvent &event : latest) {
+    if (event.Percent < 0 || event.Operation < m_ProgressOperation)
+      continue;
+
+    if (event.Operation > m_ProgressOperation) {
+      m_ProgressOperation = event.Operation;
+      ui->pb_UpdateProgress->setValue(event.Percent);
+    } else if (event.Percent > ui->pb_UpdateProgress->value())
+      ui->pb_UpdateProgress->setValue(event.Percent);
+  }
+
+  if (!running)
+    m_ProgressTimer.stop();
 }
 //----------------------------------------------------------------------------------
 void OrionLauncherWindow::on_pb_ConfigureClientVersion_clicked() {
@@ -1241,14 +1685,28 @@ void OrionLauncherWindow::on_pb_RestoreSelectedVersion_clicked() {
 
   ui->pb_UpdateProgress->setValue(0);
 
-  QtConcurrent::run(&CUpdateManager<OrionLauncherWindow>::DownloadFile,
-                    QStringList()
-                        << "www.orionuo.com"
-                        << "/Downloads/" << item->m_Backup.ZipFileName,
-                    this,
-                    QString(ui->cb_OrionPath->currentText() + "/" +
-                            item->m_Backup.ZipFileName),
-                    true);
+  COperation operation = NewOperation(0);
+
+  if (item->m_Backup.Snapshot.length()) {
+    m_Operations.Add(
+        operation,
+        QtConcurrent::run(
+            &CUpdateManager<OrionLauncherWindow>::RestoreSnapshot, this,
+            ui->cb_OrionPath->currentText(), item->m_Backup.Snapshot,
+            operation));
+    return;
+  }
+
+  m_Operations.Add(
+      operation,
+      QtConcurrent::run(&CUpdateManager<OrionLauncherWindow>::DownloadFile,
+                        QStringList()
+                            << "www.orionuo.com"
+                            << "/Downloads/" << item->m_Backup.ZipFileName,
+                        this,
+                        QString(ui->cb_OrionPath->currentText() + "/" +
+                                item->m_Backup.ZipFileName),
+                        true, operation));
 
   QMessageBox::information(
       this, "Waiting for data...",
@@ -1265,15 +1723,11 @@ void OrionLauncherWindow::on_pb_ShowChangelog_clicked() {
   else
     m_ChangelogForm->show();
 
-  emit m_ChangelogForm->signal_ChangelogReceived("Loading...");
-
-  QtConcurrent::run(&CUpdateManager<ChangelogForm>::GetChangelog,
-                    QStringList()
-                        << "www.orionuo.com"
-                        << "/Downloads/"
-                        << ("OrionChangelog" +
-                            ui->cb_ChangelogLanguage->currentText() + ".html"),
-                    m_ChangelogForm);
+  m_ChangelogForm->ShowChangelog(
+      QStringList() << "www.orionuo.com"
+                    << "/Downloads/"
+                    << ("OrionChangelog" +
+                        ui->cb_ChangelogLanguage->currentText() + ".html"));
 }
 //----------------------------------------------------------------------------------
 void OrionLauncherWindow::on_lw_Backups_doubleClicked(
@@ -94,17 +94,34 @@ private slots:
 
 	void slot_UpdatesListReceived(QList<CUpdateInfo> list);
 	void slot_BackupsListReceived(QList<CBackupInfo> list);
+	void slot_LastKnownUpdatesReceived(QList<CUpdateInfo> list, QList<CBackupInfo> backups);
 	void slot_FileReceived(QByteArray array, QString name);
 	void slot_FileReceivedNotification(QString name);
+	void slot_InstallationVerified(QList<CUpdateInfo> list, QString summary);
+	void slot_UpdatePlanReady(CUpdatePlan plan);
+	void slot_UpdatePlanExecuted(QList<CUpdateInfo> failed);
+	void slot_OnProgressTimer();
+	void slot_InstallsUpdated(QList<CInstallUpdateResult> results);
+	void slot_InstallsDeduplicated(QString summary);
 
 	void on_pb_RestoreSelectedVersion_clicked();
 
 	void on_pb_ShowChangelog_clicked();
 
+	void on_pb_VerifyInstallation_clicked();
+
+	void on_pb_UpdateAllInstalls_clicked();
+
+	void on_pb_DeduplicateInstalls_clicked();
+
+	void on_cb_LanCacheServer_clicked();
+
 	void on_lw_Backups_doubleClicked(const QModelIndex &index);
 
 	void slot_OnUpdatesTimer();
 
+	void slot_UpdatesNotification();
+
 	void slot_OnCheckClientCuoTimer();
 
 	void on_lw_OrionFeaturesOptions_clicked(const QModelIndex &index);
@@ -118,11 +135,17 @@ private slots:
 signals:
 	void signal_UpdatesListReceived(QList<CUpdateInfo>);
 	void signal_BackupsListReceived(QList<CBackupInfo>);
+	void signal_LastKnownUpdatesReceived(QList<CUpdateInfo>, QList<CBackupInfo>);
 	void signal_ChangelogReceived(QString);
 	void signal_FileReceived(QByteArray, QString);
 	void signal_FileReceivedNotification(QString);
-	void signal_AutoUpdateProgress(int);
 	void signal_AutoUpdateNotification();
+	void signal_InstallationVerified(QList<CUpdateInfo>, QString);
+	void signal_UpdatePlanReady(CUpdatePlan);
+	void signal_UpdatePlanExecuted(QList<CUpdateInfo>);
+	void signal_UpdatesNotification();
+	void signal_InstallsUpdated(QList<CInstallUpdateResult>);
+	void signal_InstallsDeduplicated(QString);
 
 private:
 	Ui::OrionLauncherWindow *ui;
@@ -158,9 +181,43 @@ private:
 
 	void UpdateOrionFecturesCode();
 
+	void StartUpdatesCheck(const bool &background, const bool &useCache);
+
+	QStringList InstallDirectories();
+
+	void RestartLauncher();
+
+	void UpdateLanCacheServer();
+
+	COperation NewOperation(const qint64 &timeout);
+
 	QTimer m_UpdatesTimer;
 
+	CPollSchedule m_PollSchedule;
+
+	QString m_UpdatesNotifyUrl{ "" };
+
+	QString m_LastUpdatesSignature{ "" };
+
+	CLanCacheServer *m_LanCacheServer{ nullptr };
+
+	quint16 m_LanCachePort{ CLanCache::DEFAULT_PORT };
+
+	QString m_LanCachePeer{ "" };
+
 	QTimer m_CheckClientCuoTimer;
+
+	COperationList m_Operations;
+
+	QSharedPointer<CProgressQueue> m_Progress{ new CProgressQueue() };
+
+	QTimer m_ProgressTimer;
+
+	quint32 m_ProgressOperation{ 0 };
+
+	COperation m_CheckOperation;
+
+	COperation m_LastKnownOperation;
 };
 //----------------------------------------------------------------------------------
 extern OrionLauncherWindow *g_OrionLauncherWindow;
@@ -0,0 +1,62 @@
+/**
+@file UpdateInfoListItem.h
+
+@brief Элементы списков лаунчера с информацией о обновлении и резервной версии
+
+@author Мустакимов Т.Р.
+**/
+//----------------------------------------------------------------------------------
+#ifndef UPDATEINFOLISTITEM_H
+#define UPDATEINFOLISTITEM_H
+//----------------------------------------------------------------------------------
+#include <QListWidgetItem>
+#include "UpdateManager/updateinfo.hpp"
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CUpdateInfoListWidgetItem class
+ * Элемент QListWidget с информацией о обновлении
+ */
+class CUpdateInfoListWidgetItem : public QListWidgetItem
+{
+public:
+	CUpdateInfoListWidgetItem(const CUpdateInfo &info)
+	: QListWidgetItem(), m_Info(info)
+	{
+		//! Отображаемый текст - имя файла
+		setText(info.Name);
+
+		//! Выбран галочкой в списке
+		//setCheckState(Qt::Checked);
+	}
+
+	virtual ~CUpdateInfoListWidgetItem() {}
+
+	//! Информация о обновлении
+	CUpdateInfo m_Info;
+};
+//----------------------------------------------------------------------------------
+/**
+ * @brief The CBackupInfoListWidgetItem class
+ * Элемент QListWidget с информацией о резервной версии
+ */
+class CBackupInfoListWidgetItem : public QListWidgetItem
+{
+public:
+	CBackupInfoListWidgetItem(const CBackupInfo &backup)
+	: QListWidgetItem(), m_Backup(backup)
+	{
+		//! Отображаемый текст - имя файла
+		setText(backup.Name);
+
+		//! Выбран галочкой в списке
+		//setCheckState(Qt::Checked);
+	}
+
+	virtual ~CBackupInfoListWidgetItem() {}
+
+	//! Информация о обновлении
+	CBackupInfo m_Backup;
+};
+//----------------------------------------------------------------------------------
+#endif // UPDATEINFOLISTITEM_H
+//----------------------------------------------------------------------------------